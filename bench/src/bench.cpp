@@ -0,0 +1,557 @@
+/*
+ * Microbenchmarks for the solver hot paths.
+ *
+ * Usage: despot_bench [--model <name>] [--bench <name>] [--repeat <n>]
+ *                     [--scale <n>] [--seed <n>]
+ *
+ * Every workload is re-seeded before each repetition and performs a fixed
+ * amount of work (number of expansions, trials, rollouts, ...) instead of
+ * running for a fixed time, so that two builds do exactly the same
+ * computation. One JSON object per (model, bench) pair is written to stdout;
+ * a human readable table is written to stderr. The "checksum" field is a
+ * value computed by the workload and should not change between builds unless
+ * the search itself changes. Slow models (chain) only run when selected with
+ * --model.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <despot/core/builtin_upper_bounds.h>
+#include <despot/core/pomdp_world.h>
+#include <despot/interface/default_policy.h>
+#include <despot/random_streams.h>
+#include <despot/solver/despot.h>
+#include <despot/solver/pomcp.h>
+#include <despot/util/seeds.h>
+#include <despot/util/util.h>
+
+#include "tiger.h"
+#include "rock_sample/rock_sample.h"
+#include "tag/tag.h"
+#include "laser_tag/laser_tag.h"
+#include "pocman.h"
+#include "chain.h"
+
+using namespace std;
+using namespace despot;
+
+/* =============================================================================
+ * DESPOTProbe class
+ * =============================================================================*/
+
+/**
+ * Exposes the protected building blocks of DESPOT to the benchmarks. Never
+ * instantiated.
+ */
+class DESPOTProbe: public DESPOT {
+public:
+	using DESPOT::InitBounds;
+	using DESPOT::Expand;
+	using DESPOT::Trial;
+	using DESPOT::Backup;
+};
+
+/* =============================================================================
+ * Benchmark workloads
+ * =============================================================================*/
+
+struct BenchModel {
+	string name;
+	DSPOMDP* model;
+	int num_scenarios;
+	ScenarioLowerBound* lower_bound;
+	ScenarioUpperBound* upper_bound;
+	int lookahead_scenarios;
+	int lookahead_depth;
+};
+
+struct Measurement {
+	long ops;
+	double seconds;
+	double checksum;
+};
+
+// Returns false if the workload does not apply to the model
+typedef bool (*BenchFunction)(const BenchModel& m, int scale,
+	Measurement& result);
+
+static void Reseed(unsigned seed) {
+	Seeds::root_seed(seed);
+	Random::RANDOM = Random(Seeds::Next());
+}
+
+static VNode* CreateRoot(const BenchModel& m, Belief* belief,
+	RandomStreams& streams, History& history) {
+	vector<State*> particles = belief->Sample(m.num_scenarios);
+	for (int i = 0; i < particles.size(); i++)
+		particles[i]->scenario_id = i;
+
+	VNode* root = new VNode(particles);
+	DESPOTProbe::InitBounds(root, m.lower_bound, m.upper_bound, streams,
+		history);
+	return root;
+}
+
+static void DeleteTree(const BenchModel& m, VNode* root) {
+	root->Free(*m.model);
+	delete root;
+}
+
+/**
+ * Expansion of fresh roots: stepping all particles for every action and
+ * initializing the bounds of the children.
+ */
+static bool BenchExpand(const BenchModel& m, int scale, Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	RandomStreams streams(m.num_scenarios, Globals::config.search_depth);
+	History history;
+
+	result.ops = 10 * scale;
+	result.seconds = 0;
+	result.checksum = 0;
+	for (int i = 0; i < result.ops; i++) {
+		VNode* root = CreateRoot(m, belief, streams, history);
+
+		double start = get_time_second();
+		DESPOTProbe::Expand(root, m.lower_bound, m.upper_bound, m.model,
+			streams, history);
+		result.seconds += get_time_second() - start;
+
+		DESPOTProbe::Backup(root);
+		result.checksum += root->upper_bound();
+		DeleteTree(m, root);
+	}
+
+	delete belief;
+	return true;
+}
+
+/**
+ * Repeated trials with backup on a single tree, as done by
+ * DESPOT::ConstructTree.
+ */
+static bool BenchTrial(const BenchModel& m, int scale, Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	RandomStreams streams(m.num_scenarios, Globals::config.search_depth);
+	History history;
+	VNode* root = CreateRoot(m, belief, streams, history);
+
+	// Stops early once the root gap is closed, as ConstructTree does
+	int num_trials = 100 * scale;
+	double start = get_time_second();
+	for (result.ops = 0; result.ops < num_trials; result.ops++) {
+		VNode* cur = DESPOTProbe::Trial(root, streams, m.lower_bound,
+			m.upper_bound, m.model, history);
+		DESPOTProbe::Backup(cur);
+		if (root->upper_bound() - root->lower_bound() <= 1e-6) {
+			result.ops++;
+			break;
+		}
+	}
+	result.seconds = get_time_second() - start;
+	result.checksum = root->lower_bound() + root->upper_bound();
+
+	DeleteTree(m, root);
+	delete belief;
+	return true;
+}
+
+/**
+ * Default policy rollouts from the root particles.
+ */
+static bool BenchRollout(const BenchModel& m, int scale, Measurement& result) {
+	const DefaultPolicy* policy =
+		dynamic_cast<const DefaultPolicy*>(m.lower_bound);
+	ScenarioLowerBound* random = NULL;
+	if (policy == NULL) {
+		random = m.model->CreateScenarioLowerBound("RANDOM");
+		policy = dynamic_cast<const DefaultPolicy*>(random);
+		if (policy == NULL) {
+			delete random;
+			return false;
+		}
+	}
+
+	Belief* belief = m.model->InitialBelief(NULL);
+	RandomStreams streams(m.num_scenarios, Globals::config.search_depth);
+	History history;
+	vector<State*> particles = belief->Sample(m.num_scenarios);
+	for (int i = 0; i < particles.size(); i++)
+		particles[i]->scenario_id = i;
+
+	result.ops = 50 * scale;
+	result.checksum = 0;
+	double start = get_time_second();
+	for (int i = 0; i < result.ops; i++) {
+		streams.position(0);
+		result.checksum += policy->Value(particles, streams, history).value;
+	}
+	result.seconds = get_time_second() - start;
+
+	for (int i = 0; i < particles.size(); i++)
+		m.model->Free(particles[i]);
+	delete belief;
+	delete random;
+	return true;
+}
+
+/**
+ * Belief updates along a trajectory of random actions from a sampled true
+ * state.
+ */
+static bool BenchBeliefUpdate(const BenchModel& m, int scale,
+	Measurement& result) {
+	// Like POMDPWorld, the true states are never freed, since some models
+	// create them with new instead of Allocate
+	State* state = m.model->CreateStartState();
+	Belief* belief = m.model->InitialBelief(state);
+
+	result.ops = 10 * scale;
+	result.seconds = 0;
+	result.checksum = 0;
+	for (int i = 0; i < result.ops; i++) {
+		ACT_TYPE action = Random::RANDOM.NextInt(m.model->NumActions());
+		double reward;
+		OBS_TYPE obs;
+		bool terminal = m.model->Step(*state, Random::RANDOM.NextDouble(),
+			action, reward, obs);
+		result.checksum += reward;
+
+		double start = get_time_second();
+		belief->Update(action, obs);
+		result.seconds += get_time_second() - start;
+
+		if (terminal) {
+			delete belief;
+			state = m.model->CreateStartState();
+			belief = m.model->InitialBelief(state);
+		}
+	}
+
+	delete belief;
+	return true;
+}
+
+/**
+ * Sampling of the root particles from the initial belief, as done at the
+ * start of every search.
+ */
+static bool BenchSample(const BenchModel& m, int scale, Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	RandomStreams streams(m.num_scenarios, Globals::config.search_depth);
+	History history;
+
+	result.ops = 10 * scale;
+	result.seconds = 0;
+	result.checksum = 0;
+	for (int i = 0; i < result.ops; i++) {
+		double start = get_time_second();
+		vector<State*> particles = belief->Sample(m.num_scenarios);
+		result.seconds += get_time_second() - start;
+
+		for (int j = 0; j < particles.size(); j++)
+			particles[j]->scenario_id = j;
+		result.checksum += m.upper_bound->Value(particles, streams, history);
+		for (int j = 0; j < particles.size(); j++)
+			m.model->Free(particles[j]);
+	}
+
+	delete belief;
+	return true;
+}
+
+/**
+ * Copies of the particles of the initial belief into the model's memory pool
+ * and back, as done for every expansion and belief update.
+ */
+static bool BenchCopy(const BenchModel& m, int scale, Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	vector<State*> particles = belief->Sample(m.num_scenarios);
+	vector<State*> copies(particles.size());
+
+	int rounds = 200 * scale;
+	result.ops = (long) rounds * particles.size();
+	result.checksum = 0;
+	double start = get_time_second();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < particles.size(); i++)
+			copies[i] = m.model->Copy(particles[i]);
+		result.checksum += copies[r % copies.size()]->weight;
+		for (int i = 0; i < copies.size(); i++)
+			m.model->Free(copies[i]);
+	}
+	result.seconds = get_time_second() - start;
+
+	for (int i = 0; i < particles.size(); i++)
+		m.model->Free(particles[i]);
+	delete belief;
+	return true;
+}
+
+/**
+ * POMCP simulations on a single tree, as done by POMCP::Search.
+ */
+static bool BenchSimulate(const BenchModel& m, int scale, Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	POMCPPrior* prior = m.model->CreatePOMCPPrior();
+
+	State* state = belief->Sample(1)[0];
+	VNode* root = POMCP::CreateVNode(0, state, prior, m.model);
+	m.model->Free(state);
+
+	result.ops = 2000 * scale;
+	double start = get_time_second();
+	for (int done = 0; done < result.ops;) {
+		vector<State*> particles = belief->Sample(
+			min(1000, (int) result.ops - done));
+		for (int i = 0; i < particles.size(); i++, done++)
+			POMCP::Simulate(particles[i], root, m.model, prior);
+		for (int i = 0; i < particles.size(); i++)
+			m.model->Free(particles[i]);
+	}
+	result.seconds = get_time_second() - start;
+	result.checksum = root->value();
+
+	delete root;
+	delete prior;
+	delete belief;
+	return true;
+}
+
+static void CollectVNodes(VNode* vnode, vector<VNode*>& vnodes) {
+	vnodes.push_back(vnode);
+	for (ACT_TYPE action = 0; action < vnode->children().size(); action++) {
+		ObsChildren& children = vnode->Child(action)->children();
+		for (ObsChildren::iterator it = children.begin(); it != children.end();
+			it++)
+			CollectVNodes(it->second, vnodes);
+	}
+}
+
+/**
+ * UCB action selection alone, over all nodes of a tree grown by POMCP
+ * simulations. Together with POMCP::Simulate, whose rate is the number of
+ * simulations per second, this shows the share of the exploration bonus.
+ */
+static bool BenchUpperBoundAction(const BenchModel& m, int scale,
+	Measurement& result) {
+	Belief* belief = m.model->InitialBelief(NULL);
+	POMCPPrior* prior = m.model->CreatePOMCPPrior();
+
+	State* state = belief->Sample(1)[0];
+	VNode* root = POMCP::CreateVNode(0, state, prior, m.model);
+	m.model->Free(state);
+
+	vector<State*> particles = belief->Sample(1000);
+	for (int i = 0; i < particles.size(); i++) {
+		POMCP::Simulate(particles[i], root, m.model, prior);
+		m.model->Free(particles[i]);
+	}
+
+	vector<VNode*> vnodes;
+	CollectVNodes(root, vnodes);
+
+	double explore_constant = prior->exploration_constant();
+	long sum = 0;
+	int rounds = max(1, 200000 * scale / (int) vnodes.size());
+	result.ops = (long) rounds * vnodes.size();
+	double start = get_time_second();
+	for (int r = 0; r < rounds; r++)
+		for (int i = 0; i < vnodes.size(); i++)
+			sum += POMCP::UpperBoundAction(vnodes[i], explore_constant);
+	result.seconds = get_time_second() - start;
+	result.checksum = sum;
+
+	delete root;
+	delete prior;
+	delete belief;
+	return true;
+}
+
+/**
+ * Initialization of the lookahead upper bound, which solves a small
+ * scenario-tree MDP over all states.
+ */
+static bool BenchLookahead(const BenchModel& m, int scale,
+	Measurement& result) {
+	const StateIndexer* indexer = dynamic_cast<const StateIndexer*>(m.model);
+	if (indexer == NULL || m.lookahead_scenarios == 0)
+		return false;
+
+	// LookaheadUpperBound does not own its base bound
+	ParticleUpperBound* base = m.model->CreateParticleUpperBound();
+	LookaheadUpperBound bound(m.model, *indexer, base);
+	RandomStreams streams(m.lookahead_scenarios, m.lookahead_depth);
+
+	result.ops = scale;
+	double start = get_time_second();
+	for (int i = 0; i < result.ops; i++)
+		bound.Init(streams);
+	result.seconds = get_time_second() - start;
+
+	vector<State*> particles(1, m.model->Copy(indexer->GetState(0)));
+	// States from the indexer's table may not have their weight set
+	particles[0]->scenario_id = 0;
+	particles[0]->weight = 1.0;
+	History history;
+	result.checksum = bound.Value(particles, streams, history);
+	m.model->Free(particles[0]);
+	delete base;
+	return true;
+}
+
+struct Bench {
+	const char* name;
+	BenchFunction function;
+};
+
+static const Bench BENCHES[] = {
+	{ "DESPOT::Expand", BenchExpand },
+	{ "DESPOT::Trial", BenchTrial },
+	{ "DefaultPolicy::Value", BenchRollout },
+	{ "Belief::Update", BenchBeliefUpdate },
+	{ "Belief::Sample", BenchSample },
+	{ "DSPOMDP::Copy", BenchCopy },
+	{ "POMCP::Simulate", BenchSimulate },
+	{ "POMCP::UpperBoundAction", BenchUpperBoundAction },
+	{ "LookaheadUpperBound::Init", BenchLookahead }
+};
+
+static BenchModel CreateBenchModel(const string& name) {
+	BenchModel m;
+	m.name = name;
+	m.num_scenarios = 500;
+	m.lookahead_scenarios = 0;
+	m.lookahead_depth = 0;
+
+	if (name == "tiger") {
+		m.model = new Tiger();
+	} else if (name == "rock_sample") {
+		// No lookahead bound: RockSample does not build its state table
+		m.model = new RockSample(7, 8);
+	} else if (name == "tag") {
+		m.model = new Tag();
+		m.lookahead_scenarios = 100;
+		m.lookahead_depth = 20;
+	} else if (name == "laser_tag") {
+		m.model = new LaserTag();
+		m.lookahead_scenarios = 20;
+		m.lookahead_depth = 20;
+	} else if (name == "pocman") {
+		m.model = new FullPocman();
+		m.num_scenarios = 100;
+	} else if (name == "chain") {
+		// The default policy solves the mean MDP at every step of a rollout
+		m.model = new Chain();
+		m.num_scenarios = 100;
+	} else {
+		m.model = NULL;
+		return m;
+	}
+
+	m.lower_bound = m.model->CreateScenarioLowerBound("DEFAULT");
+	m.upper_bound = m.model->CreateScenarioUpperBound("DEFAULT");
+	return m;
+}
+
+static const char* MODELS[] = { "tiger", "rock_sample", "tag", "laser_tag",
+	"pocman", "chain" };
+
+// Models whose workloads take minutes, only run when selected with --model
+static const char* SLOW_MODELS[] = { "chain" };
+
+static bool IsSlowModel(const string& name) {
+	for (int i = 0; i < sizeof(SLOW_MODELS) / sizeof(SLOW_MODELS[0]); i++)
+		if (name == SLOW_MODELS[i])
+			return true;
+	return false;
+}
+
+static double Median(vector<double> samples) {
+	sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+	string model_name = "", bench_name = "";
+	int repeat = 3, scale = 1;
+	unsigned seed = 42;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (i + 1 < argc && arg == "--model") {
+			model_name = argv[++i];
+		} else if (i + 1 < argc && arg == "--bench") {
+			bench_name = argv[++i];
+		} else if (i + 1 < argc && arg == "--repeat") {
+			repeat = max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "--scale") {
+			scale = max(1, atoi(argv[++i]));
+		} else if (i + 1 < argc && arg == "--seed") {
+			seed = atoi(argv[++i]);
+		} else {
+			cerr << "Usage: " << argv[0]
+				<< " [--model <name>] [--bench <name>] [--repeat <n>]"
+				<< " [--scale <n>] [--seed <n>]" << endl << "Models:";
+			for (int j = 0; j < sizeof(MODELS) / sizeof(MODELS[0]); j++)
+				cerr << " " << MODELS[j];
+			cerr << endl << "Benchmarks:";
+			for (int j = 0; j < sizeof(BENCHES) / sizeof(BENCHES[0]); j++)
+				cerr << " " << BENCHES[j].name;
+			cerr << endl;
+			return 1;
+		}
+	}
+
+	fprintf(stderr, "%-12s %-28s %8s %12s %12s %14s\n", "model", "bench",
+		"ops", "min (s)", "median (s)", "ops/s");
+	for (int i = 0; i < sizeof(MODELS) / sizeof(MODELS[0]); i++) {
+		if (model_name != "" && model_name != MODELS[i])
+			continue;
+		if (model_name == "" && IsSlowModel(MODELS[i]))
+			continue;
+
+		Reseed(seed);
+		BenchModel m = CreateBenchModel(MODELS[i]);
+		Globals::config.num_scenarios = m.num_scenarios;
+
+		for (int j = 0; j < sizeof(BENCHES) / sizeof(BENCHES[0]); j++) {
+			if (bench_name != "" && bench_name != BENCHES[j].name)
+				continue;
+
+			vector<double> seconds;
+			Measurement result;
+			bool applicable = true;
+			for (int r = 0; r < repeat && applicable; r++) {
+				Reseed(seed);
+				applicable = BENCHES[j].function(m, scale, result);
+				seconds.push_back(result.seconds);
+			}
+			if (!applicable)
+				continue;
+
+			double best = *min_element(seconds.begin(), seconds.end());
+			double rate = best > 0 ? result.ops / best : 0;
+			printf("{\"model\":\"%s\",\"bench\":\"%s\",\"ops\":%ld,"
+				"\"repeat\":%d,\"seed\":%u,\"time_min\":%.9g,"
+				"\"time_median\":%.9g,\"ops_per_sec\":%.9g,\"checksum\":%.9g}\n",
+				m.name.c_str(), BENCHES[j].name, result.ops, repeat, seed, best,
+				Median(seconds), rate, result.checksum);
+			fflush(stdout);
+			fprintf(stderr, "%-12s %-28s %8ld %12.6f %12.6f %14.1f\n",
+				m.name.c_str(), BENCHES[j].name, result.ops, best,
+				Median(seconds), rate);
+		}
+
+		delete m.lower_bound;
+		delete m.upper_bound;
+		delete m.model;
+	}
+
+	return 0;
+}
@@ -243,6 +243,13 @@ Belief* Adventurer::InitialBelief(const State* start, string type) const {
 	return belief;
 }
 
+double Adventurer::GetMinReward() const {
+	double min_reward = -10; // Falling into a trap
+	for (int i = 0; i < goal_reward_.size(); i++)
+		min_reward = min(min_reward, goal_reward_[i]);
+	return min_reward;
+}
+
 ParticleUpperBound* Adventurer::CreateParticleUpperBound(string name) const {
 	if (name == "TRIVIAL" || name == "DEFAULT") {
 		return new TrivialParticleUpperBound(this);
@@ -329,6 +336,22 @@ ScenarioLowerBound* Adventurer::CreateScenarioLowerBound(string name,
 	}
 }
 
+uint64_t Adventurer::Hash(const State& state) const {
+	return state.state_id;
+}
+
+bool Adventurer::Equal(const State& s1, const State& s2) const {
+	return s1.state_id == s2.state_id;
+}
+
+// A state is given by its state_id, which is written for every state
+void Adventurer::WriteState(const State& state, CheckpointWriter& writer) const {
+}
+
+State* Adventurer::ReadState(CheckpointReader& reader) const {
+	return Allocate(-1, 0);
+}
+
 void Adventurer::PrintState(const State& s, ostream& out) const {
 	const AdventurerState& state = static_cast<const AdventurerState&>(s);
 
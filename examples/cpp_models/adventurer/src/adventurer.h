@@ -87,6 +87,7 @@ public:
 	inline double GetMaxReward() const {
 		return max_goal_reward_;
 	}
+	double GetMinReward() const;
 	ParticleUpperBound* CreateParticleUpperBound(std::string name = "DEFAULT") const;
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
@@ -97,6 +98,11 @@ public:
 	ScenarioLowerBound* CreateScenarioLowerBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	virtual void PrintObs(const State& state, OBS_TYPE obs, std::ostream& out = std::cout) const;
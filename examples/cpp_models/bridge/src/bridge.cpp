@@ -94,6 +94,25 @@ Belief* Bridge::InitialBelief(const State* start, string type) const {
 	return new ParticleBelief(particles, this);
 }
 
+uint64_t Bridge::Hash(const State& state) const {
+	return static_cast<const BridgeState&>(state).position;
+}
+
+bool Bridge::Equal(const State& s1, const State& s2) const {
+	return static_cast<const BridgeState&>(s1).position
+		== static_cast<const BridgeState&>(s2).position;
+}
+
+void Bridge::WriteState(const State& state, CheckpointWriter& writer) const {
+	writer.WriteValue(static_cast<const BridgeState&>(state).position);
+}
+
+State* Bridge::ReadState(CheckpointReader& reader) const {
+	BridgeState* state = static_cast<BridgeState*>(Allocate(-1, 0));
+	reader.ReadValue(state->position);
+	return state;
+}
+
 void Bridge::PrintState(const State& state, ostream& out) const {
 	out << state.text() << endl;
 }
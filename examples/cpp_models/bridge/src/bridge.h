@@ -50,6 +50,9 @@ public:
 	inline double GetMaxReward() const {
 		return 0;
 	}
+	inline double GetMinReward() const {
+		return -20 - (BRIDGELENGTH - 1);
+	}
 
 	inline ValuedAction GetBestAction() const {
 		return ValuedAction(LEFT, -1);
@@ -57,6 +60,11 @@ public:
 	ScenarioLowerBound* CreateScenarioLowerBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	void PrintObs(const State& state, OBS_TYPE obs, std::ostream& out = std::cout) const;
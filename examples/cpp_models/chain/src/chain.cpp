@@ -1,5 +1,7 @@
 #include "chain.h"
 
+#include <string.h>
+
 #include <despot/core/builtin_lower_bounds.h>
 #include <despot/core/builtin_policy.h>
 #include <despot/core/builtin_upper_bounds.h>
@@ -13,35 +15,35 @@ namespace despot {
  * =============================================================================*/
 
 ChainState::ChainState() :
+	num_mdp_states_(0),
+	num_mdp_actions_(0),
 	mdp_state(0) {
 }
 
 void ChainState::Init(int num_mdp_states, int num_mdp_actions) {
-	mdp_transitions_.resize(num_mdp_states);
-	for (int state = 0; state < num_mdp_states; state++) {
-		mdp_transitions_[state].resize(num_mdp_actions);
-		for (ACT_TYPE action = 0; action < num_mdp_actions; action++) {
-			mdp_transitions_[state][action].resize(num_mdp_states);
-			for (int s = 0; s < num_mdp_states; s++)
-				mdp_transitions_[state][action][s] = 0;
-		}
-	}
+	num_mdp_states_ = num_mdp_states;
+	num_mdp_actions_ = num_mdp_actions;
+	mdp_transitions_.assign(num_mdp_states * num_mdp_actions * num_mdp_states,
+		0);
 }
 
 void ChainState::SetTransition(int state, ACT_TYPE action, vector<double> row) {
-	for (int s = 0; s < row.size(); s++) {
-		mdp_transitions_[state][action][s] = row[s];
-	}
+	SetTransition(state, action, &row[0]);
+}
+
+void ChainState::SetTransition(int state, ACT_TYPE action, const double* row) {
+	double* transition = &mdp_transitions_[(state * num_mdp_actions_ + action)
+		* num_mdp_states_];
+	for (int s = 0; s < num_mdp_states_; s++)
+		transition[s] = row[s];
 }
 
 bool ChainState::IsValid() const {
-	int num_mdp_states = mdp_transitions_.size(), num_mdp_actions =
-		mdp_transitions_[0].size();
-	for (int state1 = 0; state1 < num_mdp_states; state1++)
-		for (ACT_TYPE action = 0; action < num_mdp_actions; action++) {
+	for (int state1 = 0; state1 < num_mdp_states_; state1++)
+		for (ACT_TYPE action = 0; action < num_mdp_actions_; action++) {
 			double sum = 0;
-			for (int state2 = 0; state2 < num_mdp_states; state2++)
-				sum += mdp_transitions_[state1][action][state2];
+			for (int state2 = 0; state2 < num_mdp_states_; state2++)
+				sum += GetTransition(state1, action, state2);
 			if (fabs(sum - 1.0) > 1e-4)
 				return false;
 		}
@@ -51,11 +53,11 @@ bool ChainState::IsValid() const {
 string ChainState::text() const {
 	ostringstream oss;
 	oss << mdp_state << endl;
-	for (int s1 = 0; s1 < mdp_transitions_.size(); s1++) {
-		for (int a = 0; a < mdp_transitions_[s1].size(); a++) {
+	for (int s1 = 0; s1 < num_mdp_states_; s1++) {
+		for (int a = 0; a < num_mdp_actions_; a++) {
 			oss << s1 << " " << a << " ->";
-			for (int s2 = 0; s2 < mdp_transitions_[s1][a].size(); s2++)
-				oss << " " << mdp_transitions_[s1][a][s2];
+			for (int s2 = 0; s2 < num_mdp_states_; s2++)
+				oss << " " << GetTransition(s1, a, s2);
 			oss << endl;
 		}
 	}
@@ -88,29 +90,53 @@ void FullChainBelief::Update(ACT_TYPE action, OBS_TYPE obs) {
 vector<State*> FullChainBelief::Sample(int num_particles) const {
 	int num_mdp_states = alpha_.size(), num_mdp_actions = alpha_[0].size();
 
-	vector<State*> samples;
+	vector<ChainState*> particles(num_particles);
 	for (int i = 0; i < num_particles; i++) {
-		ChainState* particle = static_cast<ChainState*>(model_->Allocate(-1,
+		particles[i] = static_cast<ChainState*>(model_->Allocate(-1,
 			1.0 / num_particles));
-		particle->Init(num_mdp_states, num_mdp_actions);
+		particles[i]->Init(num_mdp_states, num_mdp_actions);
+		particles[i]->mdp_state = cur_state_;
+	}
 
-		particle->mdp_state = cur_state_;
-		for (int state = 0; state < num_mdp_states; state++) {
-			for (ACT_TYPE action = 0; action < num_mdp_actions; action++) {
-				particle->SetTransition(state, action,
-					Dirichlet::Next(alpha_[state][action]));
-			}
+	// Rows of all particles are drawn at once for each state and action
+	vector<double> rows;
+	for (int state = 0; state < num_mdp_states; state++) {
+		for (ACT_TYPE action = 0; action < num_mdp_actions; action++) {
+			Dirichlet::Next(alpha_[state][action], num_particles, rows);
+			for (int i = 0; i < num_particles; i++)
+				particles[i]->SetTransition(state, action,
+					&rows[i * num_mdp_states]);
 		}
-
-		static_cast<const Chain*>(model_)->ComputeOptimalValue(*particle);
-		samples.push_back(particle);
 	}
-	return samples;
+
+	static_cast<const Chain*>(model_)->ComputeOptimalValues(particles);
+	return vector<State*>(particles.begin(), particles.end());
+}
+
+// The hyper-parameters are read into a belief of the same dimensions
+bool FullChainBelief::Save(CheckpointWriter& writer) const {
+	writer.WriteHistory(history_);
+	writer.WriteValue(cur_state_);
+	for (int s = 0; s < alpha_.size(); s++)
+		for (int a = 0; a < alpha_[s].size(); a++)
+			writer.Write(&alpha_[s][a][0], alpha_[s][a].size() * sizeof(double));
+	return writer.ok();
+}
+
+bool FullChainBelief::Restore(CheckpointReader& reader) {
+	vector<vector<vector<double> > > alpha = alpha_;
+	bool ok = reader.ReadHistory(history_) && reader.ReadValue(cur_state_);
+	for (int s = 0; s < alpha.size(); s++)
+		for (int a = 0; a < alpha[s].size(); a++)
+			ok = ok && reader.Read(&alpha[s][a][0],
+				alpha[s][a].size() * sizeof(double));
+	if (ok)
+		alpha_.swap(alpha);
+	return ok;
 }
 
 Belief* FullChainBelief::MakeCopy() const {
-	return new FullChainBelief(model_, alpha_.size(), alpha_[0].size(),
-		alpha_[0][0][0]);
+	return new FullChainBelief(*this);
 }
 
 string FullChainBelief::text() const {
@@ -183,8 +209,27 @@ vector<State*> SemiChainBelief::Sample(int num_particles) const {
 	return samples;
 }
 
+// The hyper-parameters are read into a belief of the same dimensions
+bool SemiChainBelief::Save(CheckpointWriter& writer) const {
+	writer.WriteHistory(history_);
+	writer.WriteValue(cur_state_);
+	for (int a = 0; a < alpha_.size(); a++)
+		writer.Write(&alpha_[a][0], alpha_[a].size() * sizeof(double));
+	return writer.ok();
+}
+
+bool SemiChainBelief::Restore(CheckpointReader& reader) {
+	vector<vector<double> > alpha = alpha_;
+	bool ok = reader.ReadHistory(history_) && reader.ReadValue(cur_state_);
+	for (int a = 0; a < alpha.size(); a++)
+		ok = ok && reader.Read(&alpha[a][0], alpha[a].size() * sizeof(double));
+	if (ok)
+		alpha_.swap(alpha);
+	return ok;
+}
+
 Belief* SemiChainBelief::MakeCopy() const {
-	return NULL; // TODO
+	return new SemiChainBelief(*this);
 }
 
 string SemiChainBelief::text() const {
@@ -242,8 +287,11 @@ State* Chain::DefaultStartState() const {
 bool Chain::Step(State& s, double random_num, ACT_TYPE action, double &reward,
 	OBS_TYPE &obs) const {
 	ChainState& state = static_cast<ChainState&>(s);
-	int next = Random::GetCategory(state.GetTransition(state.mdp_state, action),
-		random_num);
+	const double* probs = state.Transition(state.mdp_state, action);
+	int next = 0;
+	double sum = probs[0];
+	while (sum < random_num)
+		sum += probs[++next];
 	reward = Reward(state.mdp_state, action, next);
 	state.mdp_state = next;
 	obs = state.mdp_state;
@@ -540,6 +588,160 @@ void Chain::ComputeOptimalValue(ChainState& state) const {
 	state.policy = policy;
 }
 
+void Chain::ComputeOptimalValues(const vector<ChainState*>& states) const {
+	int P = states.size(), S = NUM_MDP_STATES, A = NumActions();
+	double discount = Globals::Discount();
+
+	// transitions[((s * A + a) * S + nexts) * P + p] = P_p(nexts | s, a)
+	vector<double> transitions(S * A * S * P), rewards(S * A * S);
+	for (int s = 0; s < S; s++)
+		for (ACT_TYPE a = 0; a < A; a++)
+			for (int nexts = 0; nexts < S; nexts++) {
+				int row = (s * A + a) * S + nexts;
+				rewards[row] = Reward(s, a, nexts);
+				for (int p = 0; p < P; p++)
+					transitions[row * P + p] = states[p]->GetTransition(s, a,
+						nexts);
+			}
+
+	// Values and actions by state, then lane. Lanes [0, n) hold the
+	// particles whose values have not converged yet, particle[lane] telling
+	// which; a converged particle is replaced by the one in the last lane, so
+	// the backups only run over unconverged particles.
+	vector<double> values(S * P, 0), next_values(S * P), v(P);
+	vector<ACT_TYPE> next_actions(S * P);
+	vector<int> particle(P);
+	for (int p = 0; p < P; p++)
+		particle[p] = p;
+
+	for (int n = P; n > 0;) {
+		for (int s = 0; s < S; s++) {
+			double* next_value = &next_values[s * P];
+			ACT_TYPE* next_action = &next_actions[s * P];
+			for (int p = 0; p < n; p++) {
+				next_value[p] = Globals::NEG_INFTY;
+				next_action[p] = -1;
+			}
+
+			for (ACT_TYPE a = 0; a < A; a++) {
+				for (int p = 0; p < n; p++)
+					v[p] = 0;
+				for (int nexts = 0; nexts < S; nexts++) {
+					int row = (s * A + a) * S + nexts;
+					const double* prob = &transitions[row * P];
+					const double* value = &values[nexts * P];
+					double reward = rewards[row];
+					for (int p = 0; p < n; p++)
+						v[p] += prob[p] * (reward + discount * value[p]);
+				}
+
+				for (int p = 0; p < n; p++) {
+					if (v[p] > next_value[p]) {
+						next_value[p] = v[p];
+						next_action[p] = a;
+					}
+				}
+			}
+		}
+
+		// Lanes are visited downwards, so the last lane is always up to date
+		// when it is moved into a converged one
+		for (int p = n - 1; p >= 0; p--) {
+			double diff = 0;
+			for (int s = 0; s < S; s++) {
+				diff += fabs(next_values[s * P + p] - values[s * P + p]);
+				values[s * P + p] = next_values[s * P + p];
+			}
+			if (diff >= 0.001)
+				continue;
+
+			vector<ValuedAction>& policy = states[particle[p]]->policy;
+			policy.resize(S);
+			for (int s = 0; s < S; s++)
+				policy[s] = ValuedAction(next_actions[s * P + p], values[s * P + p]);
+
+			n--;
+			particle[p] = particle[n];
+			for (int row = 0; row < S * A * S; row++)
+				transitions[row * P + p] = transitions[row * P + n];
+			for (int s = 0; s < S; s++)
+				values[s * P + p] = values[s * P + n];
+		}
+	}
+}
+
+uint64_t Chain::Hash(const State& s) const {
+	const ChainState& state = static_cast<const ChainState&>(s);
+	// Particles differ in their sampled transition models as well
+	uint64_t hash = state.mdp_state;
+	for (int s1 = 0; s1 < NUM_MDP_STATES; s1++)
+		for (ACT_TYPE a = 0; a < NumActions(); a++)
+			for (int s2 = 0; s2 < NUM_MDP_STATES; s2++) {
+				union {
+					double value;
+					uint64_t bits;
+				} p;
+				p.value = state.GetTransition(s1, a, s2);
+				hash = HashCombine(hash, p.bits);
+			}
+	return hash;
+}
+
+bool Chain::Equal(const State& s1, const State& s2) const {
+	const ChainState& state1 = static_cast<const ChainState&>(s1);
+	const ChainState& state2 = static_cast<const ChainState&>(s2);
+	if (state1.mdp_state != state2.mdp_state)
+		return false;
+
+	// The policy follows from the transitions, so it is not compared
+	for (int s = 0; s < NUM_MDP_STATES; s++)
+		for (ACT_TYPE a = 0; a < NumActions(); a++)
+			if (memcmp(state1.Transition(s, a), state2.Transition(s, a),
+				NUM_MDP_STATES * sizeof(double)) != 0)
+				return false;
+	return true;
+}
+
+/**
+ * The optimal policy is written along with the transitions, so that it is
+ * not recomputed for every particle read.
+ */
+void Chain::WriteState(const State& s, CheckpointWriter& writer) const {
+	const ChainState& state = static_cast<const ChainState&>(s);
+	writer.WriteValue(state.mdp_state);
+	for (int s1 = 0; s1 < NUM_MDP_STATES; s1++)
+		for (ACT_TYPE a = 0; a < NumActions(); a++)
+			writer.Write(state.Transition(s1, a), NUM_MDP_STATES * sizeof(double));
+
+	writer.WriteValue((int) state.policy.size());
+	for (int i = 0; i < state.policy.size(); i++) {
+		writer.WriteValue(state.policy[i].action);
+		writer.WriteValue(state.policy[i].value);
+	}
+}
+
+State* Chain::ReadState(CheckpointReader& reader) const {
+	ChainState* state = static_cast<ChainState*>(Allocate(-1, 0));
+	state->Init(NUM_MDP_STATES, NumActions());
+	reader.ReadValue(state->mdp_state);
+	vector<double> row(NUM_MDP_STATES);
+	for (int s1 = 0; s1 < NUM_MDP_STATES; s1++)
+		for (ACT_TYPE a = 0; a < NumActions(); a++) {
+			reader.Read(&row[0], NUM_MDP_STATES * sizeof(double));
+			state->SetTransition(s1, a, &row[0]);
+		}
+
+	int policy_size = 0;
+	reader.ReadValue(policy_size);
+	state->policy.assign(reader.ok() && policy_size > 0 ? policy_size : 0,
+		ValuedAction());
+	for (int i = 0; i < state->policy.size(); i++) {
+		reader.ReadValue(state->policy[i].action);
+		reader.ReadValue(state->policy[i].value);
+	}
+	return state;
+}
+
 void Chain::PrintState(const State& s, ostream& out) const {
 	const ChainState& state = static_cast<const ChainState&>(s);
 	out << state.mdp_state << endl;
@@ -12,7 +12,8 @@ namespace despot {
 
 class ChainState: public State {
 private:
-  std::vector<std::vector<std::vector<double> > > mdp_transitions_; //mdp_transitions_[s1][a][s2] = P(s2|s1,a)
+	int num_mdp_states_, num_mdp_actions_;
+	std::vector<double> mdp_transitions_; // P(s2|s1,a) at (s1 * num_mdp_actions_ + a) * num_mdp_states_ + s2
 
 public:
 	int mdp_state;
@@ -24,14 +25,22 @@ public:
 	bool IsValid() const;
 
 	void SetTransition(int state, ACT_TYPE action, std::vector<double> row);
+	void SetTransition(int state, ACT_TYPE action, const double* row);
 	void SetTransition(int state1, ACT_TYPE action, int state2, double value) {
-		mdp_transitions_[state1][action][state2] = value;
+		mdp_transitions_[(state1 * num_mdp_actions_ + action) * num_mdp_states_
+			+ state2] = value;
 	}
-	std::vector<double> GetTransition(int state, ACT_TYPE action) {
-		return mdp_transitions_[state][action];
+	std::vector<double> GetTransition(int state, ACT_TYPE action) const {
+		const double* row = Transition(state, action);
+		return std::vector<double>(row, row + num_mdp_states_);
 	}
-	inline double GetTransition(int state1, ACT_TYPE action, int state2) {
-		return mdp_transitions_[state1][action][state2];
+	inline double GetTransition(int state1, ACT_TYPE action, int state2) const {
+		return mdp_transitions_[(state1 * num_mdp_actions_ + action)
+			* num_mdp_states_ + state2];
+	}
+	inline const double* Transition(int state, ACT_TYPE action) const {
+		return &mdp_transitions_[(state * num_mdp_actions_ + action)
+			* num_mdp_states_];
 	}
 
 	void ComputeOptimalPolicy();
@@ -62,6 +71,9 @@ public:
 
 	Belief* MakeCopy() const;
 
+	bool Save(CheckpointWriter& writer) const;
+	bool Restore(CheckpointReader& reader);
+
 	std::string text() const;
 };
 
@@ -84,6 +96,9 @@ public:
 
 	Belief* MakeCopy() const;
 
+	bool Save(CheckpointWriter& writer) const;
+	bool Restore(CheckpointReader& reader);
+
 	std::string text() const;
 };
 
@@ -120,6 +135,9 @@ public:
 	inline double GetMaxReward() const {
 		return 10;
 	}
+	inline double GetMinReward() const {
+		return 0;
+	}
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
@@ -130,6 +148,18 @@ public:
 		std::string particle_bound_name = "DEFAULT") const;
 
 	void ComputeOptimalValue(ChainState& state) const;
+	/**
+	 * Value iteration on the transition models of all states at once, with
+	 * the models stored by particle innermost so that each backup is a loop
+	 * over particles. Every state gets the policy that ComputeOptimalValue
+	 * would give it.
+	 */
+	void ComputeOptimalValues(const std::vector<ChainState*>& states) const;
+
+	uint64_t Hash(const State& s) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
 
 	void PrintState(const State& s, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
@@ -293,6 +293,22 @@ ScenarioLowerBound* Navigation::CreateScenarioLowerBound(string name,
 	}
 }
 
+uint64_t Navigation::Hash(const State& state) const {
+	return state.state_id;
+}
+
+bool Navigation::Equal(const State& s1, const State& s2) const {
+	return s1.state_id == s2.state_id;
+}
+
+// A state is given by its state_id, which is written for every state
+void Navigation::WriteState(const State& state, CheckpointWriter& writer) const {
+}
+
+State* Navigation::ReadState(CheckpointReader& reader) const {
+	return Allocate(-1, 0);
+}
+
 void Navigation::PrintState(const State& s, ostream& out) const {
 	char buffer[20];
 	out << "Flag = " << (s.state_id % flag_size_) << endl;
@@ -76,6 +76,9 @@ public:
 	inline double GetMaxReward() const {
 		return 0;
 	}
+	inline double GetMinReward() const {
+		return -1;
+	}
 	ParticleUpperBound* CreateParticleUpperBound(std::string name = "DEFAULT") const;
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
@@ -86,6 +89,11 @@ public:
 	ScenarioLowerBound* CreateScenarioLowerBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	virtual void PrintObs(const State& state, OBS_TYPE obs, std::ostream& out = std::cout) const;
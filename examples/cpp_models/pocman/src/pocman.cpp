@@ -3,6 +3,10 @@
 #include <despot/core/builtin_lower_bounds.h>
 #include <despot/core/builtin_policy.h>
 #include <despot/core/builtin_upper_bounds.h>
+#include <despot/util/util.h>
+
+#include <pthread.h>
+
 using namespace std;
 
 namespace despot {
@@ -18,10 +22,47 @@ PocmanBelief::PocmanBelief(vector<State*> particles, const DSPOMDP* model,
 	pocman_(static_cast<const Pocman*>(model)) {
 }
 
+// Work of one thread in ParallelUpdate
+struct PocmanUpdateTask {
+	const PocmanBelief* belief;
+	const Pocman* pocman;
+	ACT_TYPE action;
+	OBS_TYPE obs;
+	Random random;
+	int* next_trial; // First trial not yet claimed by a thread
+	int max_trials;
+	int* num_accepted; // Number of slots claimed by accepted particles
+	State** slots;
+	int num_slots;
+	int trials; // Trials made by this thread
+	pthread_t thread;
+};
+
 void PocmanBelief::Update(ACT_TYPE action, OBS_TYPE obs) {
 	history_.Add(action, obs);
 
+	double start = get_time_second();
+	int num_threads = max(1, Globals::config.num_threads);
 	vector<State*> updated;
+	int trials = num_threads == 1 ? SerialUpdate(action, obs, updated)
+		: ParallelUpdate(action, obs, num_threads, updated);
+
+	for (int i = 0; i < particles_.size(); i++)
+		pocman_->Free(particles_[i]);
+
+	particles_ = updated;
+
+	for (int i = 0; i < particles_.size(); i++)
+		particles_[i]->weight = 1.0 / particles_.size();
+
+	logi << "[PocmanBelief::Update] Accepted " << particles_.size() << " / "
+		<< trials << " trials (rate " << (double) particles_.size() / trials
+		<< ") on " << num_threads << " threads in "
+		<< get_time_second() - start << "s" << endl;
+}
+
+int PocmanBelief::SerialUpdate(ACT_TYPE action, OBS_TYPE obs,
+	vector<State*>& updated) const {
 	double reward;
 	OBS_TYPE o;
 	int cur = 0, N = particles_.size(), trials = 0;
@@ -41,14 +82,91 @@ void PocmanBelief::Update(ACT_TYPE action, OBS_TYPE obs) {
 
 		trials++;
 	}
+	return trials;
+}
 
-	for (int i = 0; i < particles_.size(); i++)
-		pocman_->Free(particles_[i]);
+/**
+ * The memory pool is not thread-safe, so the slots for the new particles are
+ * allocated beforehand. Threads claim trials in chunks from a shared counter,
+ * step a copy of the old particle on their stack, and claim the next free
+ * slot with an atomic increment when it is accepted. Unused slots are freed
+ * afterwards.
+ */
+int PocmanBelief::ParallelUpdate(ACT_TYPE action, OBS_TYPE obs,
+	int num_threads, vector<State*>& updated) const {
+	vector<State*> slots(num_particles);
+	for (int i = 0; i < num_particles; i++)
+		slots[i] = pocman_->Allocate(-1, 0);
+
+	int next_trial = 0, num_accepted = 0;
+	vector<PocmanUpdateTask> tasks(num_threads);
+	for (int t = 0; t < num_threads; t++) {
+		PocmanUpdateTask& task = tasks[t];
+		task.belief = this;
+		task.pocman = pocman_;
+		task.action = action;
+		task.obs = obs;
+		task.random = Random(Random::RANDOM.NextUnsigned());
+		task.next_trial = &next_trial;
+		task.max_trials = 10 * num_particles;
+		task.num_accepted = &num_accepted;
+		task.slots = &slots[0];
+		task.num_slots = num_particles;
+		task.trials = 0;
+	}
 
-	particles_ = updated;
+	for (int t = 0; t < num_threads; t++)
+		pthread_create(&tasks[t].thread, NULL, RunTrials, &tasks[t]);
+	int trials = 0;
+	for (int t = 0; t < num_threads; t++) {
+		pthread_join(tasks[t].thread, NULL);
+		trials += tasks[t].trials;
+	}
 
-	for (int i = 0; i < particles_.size(); i++)
-		particles_[i]->weight = 1.0 / particles_.size();
+	num_accepted = min(num_accepted, num_particles);
+	updated.assign(slots.begin(), slots.begin() + num_accepted);
+	for (int i = num_accepted; i < num_particles; i++)
+		pocman_->Free(slots[i]);
+	return trials;
+}
+
+void* PocmanBelief::RunTrials(void* arg) {
+	static const int CHUNK_SIZE = 64;
+
+	PocmanUpdateTask* task = (PocmanUpdateTask*) arg;
+	const vector<State*>& particles = task->belief->particles_;
+	const History& history = task->belief->history_;
+	int N = particles.size();
+	volatile int* num_accepted = task->num_accepted;
+
+	PocmanState particle;
+	double reward;
+	OBS_TYPE o;
+	while (*num_accepted < task->num_slots) {
+		int begin = __sync_fetch_and_add(task->next_trial, CHUNK_SIZE);
+		int end = min(begin + CHUNK_SIZE, task->max_trials);
+		if (begin >= end)
+			break;
+
+		for (int trial = begin; trial < end && *num_accepted < task->num_slots;
+			trial++) {
+			particle = *static_cast<const PocmanState*>(particles[trial % N]);
+			bool terminal = task->pocman->Step(particle, task->random.NextDouble(),
+				task->action, reward, o);
+			task->trials++;
+
+			if ((!terminal && o == task->obs)
+				|| task->pocman->LocalMove(particle, history, task->obs,
+					task->random)) {
+				int slot = __sync_fetch_and_add(task->num_accepted, 1);
+				if (slot < task->num_slots) {
+					*static_cast<PocmanState*>(task->slots[slot]) = particle;
+					task->slots[slot]->SetAllocated();
+				}
+			}
+		}
+	}
+	return NULL;
 }
 
 /* ==============================================================================
@@ -66,8 +184,8 @@ public:
 	double Value(const State& state) const {
 		const PocmanState& pocstate = static_cast<const PocmanState&>(state);
 		return (pocman_->reward_eat_food_ + pocman_->reward_eat_ghost_)
-			* (1 - Globals::Discount(pocstate.num_food)) / (1 - Globals::Discount())
-			+ pocman_->reward_clear_level_ * Globals::Discount(pocstate.num_food);
+			* (1 - Globals::Discount(pocstate.NumFood())) / (1 - Globals::Discount())
+			+ pocman_->reward_clear_level_ * Globals::Discount(pocstate.NumFood());
 	}
 };
 
@@ -91,13 +209,14 @@ public:
 
 			int max_dist = 0;
 
-			for (int i = 0; i < state.food.size(); i++) {
-				if (state.food[i] != 1)
-					continue;
-				Coord food_pos = pocman_->maze_.GetCoord(i);
-				int dist = Coord::ManhattanDistance(state.pocman_pos, food_pos);
-				value += pocman_->reward_eat_food_ * Globals::Discount(dist);
-				max_dist = max(max_dist, dist);
+			for (int w = 0; w < PocmanState::FOOD_WORDS; w++) {
+				for (uint64_t bits = state.food[w]; bits != 0; bits &= bits - 1) {
+					int i = w * 64 + __builtin_ctzll(bits);
+					Coord food_pos = pocman_->maze_.GetCoord(i);
+					int dist = Coord::ManhattanDistance(state.pocman_pos, food_pos);
+					value += pocman_->reward_eat_food_ * Globals::Discount(dist);
+					max_dist = max(max_dist, dist);
+				}
 			}
 
 			// Clear level
@@ -441,10 +560,9 @@ bool Pocman::Step(State& state, double rand_num, ACT_TYPE action, double& reward
 	observation = MakeObservations(pocstate);
 
 	int pocIndex = maze_.Index(pocstate.pocman_pos);
-	if (pocstate.food[pocIndex]) {
-		pocstate.food[pocIndex] = false;
-		pocstate.num_food--;
-		if (pocstate.num_food == 0) {
+	if (pocstate.HasFood(pocIndex)) {
+		pocstate.SetFood(pocIndex, false);
+		if (pocstate.NumFood() == 0) {
 			reward += reward_clear_level_;
 			return true;
 		}
@@ -476,10 +594,10 @@ double Pocman::ObsProb(OBS_TYPE obs, const State& state, ACT_TYPE action) const
 }
 
 State* Pocman::CreateStartState(string tyep) const {
+	assert(num_ghosts_ <= PocmanState::MAX_GHOSTS);
+	assert(maze_.xsize() * maze_.ysize() <= PocmanState::MAX_CELLS);
+
 	PocmanState* startState = memory_pool_.Allocate();
-	startState->ghost_pos.resize(num_ghosts_);
-	startState->ghost_dir.resize(num_ghosts_);
-	startState->food.resize(maze_.xsize() * maze_.ysize());
 	NewLevel(*startState);
 	return startState;
 }
@@ -511,14 +629,15 @@ int Pocman::MakeObservations(const PocmanState& pocstate) const {
 	return observation;
 }
 
-bool Pocman::LocalMove(State& state, const History& history, int obs) const {
+bool Pocman::LocalMove(State& state, const History& history, int obs,
+	Random& random) const {
 	PocmanState& pocstate = static_cast<PocmanState&>(state);
 
-	int numGhosts = Random::RANDOM.NextInt(1, 3); // Change 1 or 2 ghosts at a time
+	int numGhosts = random.NextInt(1, 3); // Change 1 or 2 ghosts at a time
 	for (int i = 0; i < numGhosts; ++i) {
-		int g = Random::RANDOM.NextInt(num_ghosts_);
-		pocstate.ghost_pos[g] = Coord(Random::RANDOM.NextInt(maze_.xsize()),
-			Random::RANDOM.NextInt(maze_.ysize()));
+		int g = random.NextInt(num_ghosts_);
+		pocstate.ghost_pos[g] = Coord(random.NextInt(maze_.xsize()),
+			random.NextInt(maze_.ysize()));
 		if (!Passable(pocstate.ghost_pos[g])
 			|| pocstate.ghost_pos[g] == pocstate.pocman_pos)
 			return false;
@@ -530,8 +649,8 @@ bool Pocman::LocalMove(State& state, const History& history, int obs) const {
 			Coord pos = pocstate.pocman_pos + smellPos;
 			if (smellPos != Coord(0, 0) && maze_.Inside(pos)
 				&& CheckFlag(maze_(pos), E_SEED)) {
-				double v = Random::RANDOM.NextDouble();
-				pocstate.food[maze_.Index(pos)] = v < (food_prob_ * 0.5);
+				double v = random.NextDouble();
+				pocstate.SetFood(maze_.Index(pos), v < (food_prob_ * 0.5));
 			}
 		}
 	}
@@ -629,7 +748,8 @@ void Pocman::NewLevel(PocmanState& pocstate) const {
 		pocstate.ghost_dir[g] = -1;
 	}
 
-	pocstate.num_food = 0;
+	for (int w = 0; w < PocmanState::FOOD_WORDS; w++)
+		pocstate.food[w] = 0;
 	for (int x = 0; x < maze_.xsize(); x++) {
 		for (int y = 0; y < maze_.ysize(); y++) {
 			int pocIndex = maze_.Index(x, y);
@@ -637,10 +757,7 @@ void Pocman::NewLevel(PocmanState& pocstate) const {
 			if (CheckFlag(maze_(x, y), E_SEED)
 				&& (CheckFlag(maze_(x, y), E_POWER)
 					|| Random::RANDOM.NextDouble() < food_prob_)) {
-				pocstate.food[pocIndex] = 1;
-				pocstate.num_food++;
-			} else {
-				pocstate.food[pocIndex] = 0;
+				pocstate.SetFood(pocIndex, true);
 			}
 		}
 	}
@@ -672,7 +789,7 @@ bool Pocman::SmellFood(const PocmanState& pocstate) const {
 	for (smellPos.x = -smell_range_; smellPos.x <= smell_range_; smellPos.x++)
 		for (smellPos.y = -smell_range_; smellPos.y <= smell_range_; smellPos.y++)
 			if (maze_.Inside(pocstate.pocman_pos + smellPos)
-				&& pocstate.food[maze_.Index(pocstate.pocman_pos + smellPos)])
+				&& pocstate.HasFood(maze_.Index(pocstate.pocman_pos + smellPos)))
 				return true;
 	return false;
 }
@@ -735,6 +852,61 @@ POMCPPrior* Pocman::CreatePOMCPPrior(string name) const {
 	}
 }
 
+/**
+ * Only the first num_ghosts_ ghosts are part of the state; the food bits of
+ * cells outside the maze are always cleared.
+ */
+uint64_t Pocman::Hash(const State& state) const {
+	const PocmanState& pocstate = static_cast<const PocmanState&>(state);
+	uint64_t hash = HashCombine(pocstate.pocman_pos.x, pocstate.pocman_pos.y);
+	for (int g = 0; g < num_ghosts_; g++) {
+		hash = HashCombine(hash, pocstate.ghost_pos[g].x);
+		hash = HashCombine(hash, pocstate.ghost_pos[g].y);
+		hash = HashCombine(hash, pocstate.ghost_dir[g]);
+	}
+	for (int w = 0; w < PocmanState::FOOD_WORDS; w++)
+		hash = HashCombine(hash, pocstate.food[w]);
+	return HashCombine(hash, pocstate.power_steps);
+}
+
+bool Pocman::Equal(const State& s1, const State& s2) const {
+	const PocmanState& state1 = static_cast<const PocmanState&>(s1);
+	const PocmanState& state2 = static_cast<const PocmanState&>(s2);
+	if (state1.pocman_pos != state2.pocman_pos
+		|| state1.power_steps != state2.power_steps)
+		return false;
+
+	for (int g = 0; g < num_ghosts_; g++) {
+		if (state1.ghost_pos[g] != state2.ghost_pos[g]
+			|| state1.ghost_dir[g] != state2.ghost_dir[g])
+			return false;
+	}
+	for (int w = 0; w < PocmanState::FOOD_WORDS; w++) {
+		if (state1.food[w] != state2.food[w])
+			return false;
+	}
+	return true;
+}
+
+void Pocman::WriteState(const State& state, CheckpointWriter& writer) const {
+	const PocmanState& pocstate = static_cast<const PocmanState&>(state);
+	writer.WriteValue(pocstate.pocman_pos);
+	writer.Write(pocstate.ghost_pos, num_ghosts_ * sizeof(Coord));
+	writer.Write(pocstate.ghost_dir, num_ghosts_ * sizeof(int));
+	writer.Write(pocstate.food, sizeof(pocstate.food));
+	writer.WriteValue(pocstate.power_steps);
+}
+
+State* Pocman::ReadState(CheckpointReader& reader) const {
+	PocmanState* pocstate = static_cast<PocmanState*>(Allocate(-1, 0));
+	reader.ReadValue(pocstate->pocman_pos);
+	reader.Read(pocstate->ghost_pos, num_ghosts_ * sizeof(Coord));
+	reader.Read(pocstate->ghost_dir, num_ghosts_ * sizeof(int));
+	reader.Read(pocstate->food, sizeof(pocstate->food));
+	reader.ReadValue(pocstate->power_steps);
+	return pocstate;
+}
+
 void Pocman::PrintState(const State& state, ostream& ostr) const {
 	const PocmanState& pocstate = static_cast<const PocmanState&>(state);
 	ostr << endl;
@@ -752,7 +924,7 @@ void Pocman::PrintState(const State& state, ostream& ostr) const {
 			char c = ' ';
 			if (!Passable(pos))
 				c = 'X';
-			if (pocstate.food[index])
+			if (pocstate.HasFood(index))
 				c = CheckFlag(maze_(x, y), E_POWER) ? '+' : '.';
 			for (int g = 0; g < num_ghosts_; g++)
 				if (pos == pocstate.ghost_pos[g])
@@ -870,6 +1042,7 @@ State* Pocman::Allocate(int state_id, double weight) const {
 }
 
 State* Pocman::Copy(const State* particle) const {
+	// A flat copy, as PocmanState holds no heap memory
 	PocmanState* state = memory_pool_.Allocate();
 	*state = *static_cast<const PocmanState*>(particle);
 	state->SetAllocated();
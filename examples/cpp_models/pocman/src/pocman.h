@@ -10,17 +10,44 @@
 namespace despot {
 
 /* ==============================================================================
- * AdventurerState class
+ * PocmanState class
  * ==============================================================================*/
 
+/**
+ * Pocman state with fixed capacity, sized for the largest maze, so that it
+ * holds no heap memory and is copied as one flat block.
+ */
 class PocmanState: public State {
 public:
+	enum {
+		MAX_GHOSTS = 4,
+		MAX_CELLS = 17 * 19,
+		FOOD_WORDS = (MAX_CELLS + 63) / 64
+	};
+
 	Coord pocman_pos;
-	std::vector<Coord> ghost_pos;
-	std::vector<int> ghost_dir;
-	std::vector<bool> food; // bit vector
-	int num_food;
+	Coord ghost_pos[MAX_GHOSTS];
+	int ghost_dir[MAX_GHOSTS];
+	uint64_t food[FOOD_WORDS]; // bit vector over the maze cells
 	int power_steps;
+
+	inline bool HasFood(int index) const {
+		return (food[index >> 6] >> (index & 63)) & 1;
+	}
+
+	inline void SetFood(int index, bool value) {
+		if (value)
+			food[index >> 6] |= (uint64_t) 1 << (index & 63);
+		else
+			food[index >> 6] &= ~((uint64_t) 1 << (index & 63));
+	}
+
+	inline int NumFood() const {
+		int num_food = 0;
+		for (int w = 0; w < FOOD_WORDS; w++)
+			num_food += __builtin_popcountll(food[w]);
+		return num_food;
+	}
 };
 
 /* ==============================================================================
@@ -31,11 +58,27 @@ class Pocman;
 class PocmanBelief: public ParticleBelief {
 protected:
 	const Pocman* pocman_;
+
+	int SerialUpdate(ACT_TYPE action, OBS_TYPE obs,
+		std::vector<State*>& updated) const;
+	int ParallelUpdate(ACT_TYPE action, OBS_TYPE obs, int num_threads,
+		std::vector<State*>& updated) const;
+	static void* RunTrials(void* task);
+
 public:
 	static int num_particles;
 
 	PocmanBelief(std::vector<State*> particles, const DSPOMDP* model, Belief* prior =
 		NULL);
+
+	/**
+	 * Rejection sampling of the new particles: a copy of each old particle in
+	 * turn is stepped, and kept if it produces the observation or a local
+	 * move makes it consistent, until num_particles are kept or 10 times as
+	 * many trials are made. With Globals::config.num_threads above 1, the
+	 * trials are split across threads, each with its own random number
+	 * generator, and accepted particles are appended to a preallocated array.
+	 */
 	void Update(ACT_TYPE action, OBS_TYPE obs);
 };
 
@@ -61,6 +104,9 @@ public:
 	inline double GetMaxReward() const {
 		return reward_clear_level_;
 	}
+	inline double GetMinReward() const {
+		return reward_default_ + reward_hit_wall_ + reward_die_;
+	}
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
@@ -73,6 +119,11 @@ public:
 
 	POMCPPrior* CreatePOMCPPrior(std::string name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	virtual void PrintState(const State& state, std::ostream& out = std::cout) const;
 	virtual void PrintObs(const State& state, OBS_TYPE observation,
 		std::ostream& out = std::cout) const;
@@ -84,7 +135,8 @@ public:
 	virtual void Free(State* particle) const;
 	int NumActiveParticles() const;
 
-	bool LocalMove(State& state, const History& history, int obs) const;
+	bool LocalMove(State& state, const History& history, int obs,
+		Random& random = Random::RANDOM) const;
 
 public:
 	Pocman(int xsize, int ysize);
@@ -223,6 +223,22 @@ ScenarioLowerBound* RegDemo::CreateScenarioLowerBound(string name,
 	}
 }
 
+uint64_t RegDemo::Hash(const State& state) const {
+	return state.state_id;
+}
+
+bool RegDemo::Equal(const State& s1, const State& s2) const {
+	return s1.state_id == s2.state_id;
+}
+
+// A state is given by its state_id, which is written for every state
+void RegDemo::WriteState(const State& state, CheckpointWriter& writer) const {
+}
+
+State* RegDemo::ReadState(CheckpointReader& reader) const {
+	return Allocate(-1, 0);
+}
+
 void RegDemo::PrintState(const State& s, ostream& out) const {
 	char buffer[20];
 	for (int x = 0; x < size_; x++) {
@@ -799,6 +799,22 @@ POMCPPrior* BaseRockSample::CreatePOMCPPrior(string name) const {
 	}
 }
 
+uint64_t BaseRockSample::Hash(const State& state) const {
+	return state.state_id;
+}
+
+bool BaseRockSample::Equal(const State& s1, const State& s2) const {
+	return s1.state_id == s2.state_id;
+}
+
+// A state is given by its state_id, which is written for every state
+void BaseRockSample::WriteState(const State& state, CheckpointWriter& writer) const {
+}
+
+State* BaseRockSample::ReadState(CheckpointReader& reader) const {
+	return Allocate(-1, 0);
+}
+
 void BaseRockSample::PrintState(const State& state, ostream& out) const {
 	out << endl;
 	for (int x = 0; x < size_ + 2; x++)
@@ -102,6 +102,9 @@ public:
 	inline double GetMaxReward() const {
 		return 10;
 	}
+	inline double GetMinReward() const {
+		return -100;
+	}
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 	BeliefUpperBound* CreateBeliefUpperBound(std::string name = "DEFAULT") const;
@@ -115,6 +118,11 @@ public:
 
 	POMCPPrior* CreatePOMCPPrior(std::string name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	virtual void PrintObs(const State& state, OBS_TYPE observation, std::ostream& out = std::cout) const = 0;
@@ -163,6 +163,10 @@ double SimpleRockSample::GetMaxReward() const {
 	return 10;
 }
 
+double SimpleRockSample::GetMinReward() const {
+	return -100;
+}
+
 class SimpleRockSampleParticleUpperBound: public ParticleUpperBound {
 protected:
 	// upper_bounds_[pos][status]:
@@ -213,6 +217,7 @@ public:
 	};
 	SimpleRockSampleEastPolicy(const DSPOMDP* model, ParticleLowerBound* bound) :
 		DefaultPolicy(model, bound) {
+		partition(false); // Always moves east, whatever the history
 	}
 
 	ACT_TYPE Action(const vector<State*>& particles, RandomStreams& streams,
@@ -266,6 +271,32 @@ int SimpleRockSample::NumActiveParticles() const {
  * Display
  * =======*/
 
+uint64_t SimpleRockSample::Hash(const State& state) const {
+	const SimpleState& simple_state = static_cast<const SimpleState&>(state);
+	return simple_state.rover_position * 2 + simple_state.rock_status;
+}
+
+bool SimpleRockSample::Equal(const State& s1, const State& s2) const {
+	const SimpleState& state1 = static_cast<const SimpleState&>(s1);
+	const SimpleState& state2 = static_cast<const SimpleState&>(s2);
+	return state1.rover_position == state2.rover_position
+		&& state1.rock_status == state2.rock_status;
+}
+
+void SimpleRockSample::WriteState(const State& state,
+	CheckpointWriter& writer) const {
+	const SimpleState& simple_state = static_cast<const SimpleState&>(state);
+	writer.WriteValue(simple_state.rover_position);
+	writer.WriteValue(simple_state.rock_status);
+}
+
+State* SimpleRockSample::ReadState(CheckpointReader& reader) const {
+	SimpleState* state = static_cast<SimpleState*>(Allocate(-1, 0));
+	reader.ReadValue(state->rover_position);
+	reader.ReadValue(state->rock_status);
+	return state;
+}
+
 void SimpleRockSample::PrintState(const State& state, ostream& out) const {
 	const SimpleState& simple_state = static_cast<const SimpleState&>(state);
 
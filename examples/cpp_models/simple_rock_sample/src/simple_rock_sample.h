@@ -68,6 +68,7 @@ public:
 
 	/* Bound-related functions.*/
 	double GetMaxReward() const;
+	double GetMinReward() const;
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 	ValuedAction GetBestAction() const;
@@ -81,6 +82,11 @@ public:
 	int NumActiveParticles() const;
 
 	/* Display.*/
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	void PrintObs(const State& state, OBS_TYPE observation,
@@ -4,6 +4,7 @@
 #include <despot/util/coord.h>
 #include <despot/util/floor.h>
 #include <despot/solver/pomcp.h>
+#include <despot/core/alpha_vectors.h>
 
 using namespace std;
 
@@ -319,7 +320,7 @@ protected:
 public:
 	TagManhattanUpperBound(const BaseTag* model) :
 		tag_model_(model) {
-		Floor floor = tag_model_->floor_;
+		const Floor& floor = tag_model_->floor_;
 		value_.resize(tag_model_->NumStates());
 		for (int s = 0; s < tag_model_->NumStates(); s++) {
 			Coord rob = floor.GetCell(tag_model_->rob_[s]), opp = floor.GetCell(
@@ -362,7 +363,7 @@ protected:
 public:
 	TagSPParticleUpperBound(const BaseTag* model) :
 		tag_model_(model) {
-		Floor floor = tag_model_->floor_;
+		const Floor& floor = tag_model_->floor_;
 		value_.resize(tag_model_->NumStates());
 		for (int s = 0; s < tag_model_->NumStates(); s++) {
 			int rob = tag_model_->rob_[s], opp = tag_model_->opp_[s];
@@ -396,12 +397,15 @@ public:
 	}
 
 	ValuedAction Value(const Belief* belief) const {
+		vector<double> values;
+		tag_model_->ComputeActionValues(
+			static_cast<const ParticleBelief*>(belief)->particles(), *tag_model_,
+			values);
+
 		double bestValue = Globals::NEG_INFTY;
 		int bestAction = -1;
-		for (ACT_TYPE action = 0; action < tag_model_->NumActions(); action++) {
-			double value = tag_model_->ComputeActionValue(
-				static_cast<const ParticleBelief*>(belief), *tag_model_,
-				action);
+		for (ACT_TYPE action = 0; action < values.size(); action++) {
+			double value = values[action];
 			if (value > bestValue) {
 				bestValue = value;
 				bestAction = action;
@@ -450,7 +454,7 @@ void BaseTag::ReadConfig(istream& is) {
 				}
 			}
 
-			floor_.ComputeDistances();
+			floor_.ComputeDistances(Globals::config.num_threads);
 		} else if (key == "width-height-obstacles") {
 			int h, w, o;
 			is >> h >> w >> o;
@@ -651,10 +655,12 @@ ParticleUpperBound* BaseTag::CreateParticleUpperBound(string name) const {
 		return new TagSPParticleUpperBound(this);
 	} else if (name == "MANHATTAN") {
 		return new TagManhattanUpperBound(this);
+	} else if (name == "ALPHA") {
+		return new AlphaVectorUpperBound(this, *this);
 	} else {
 		if (name != "print")
 			cerr << "Unsupported particle lower bound: " << name << endl;
-		cerr << "Supported types: TRIVIAL, MDP, SP, MANHATTAN (default to SP)" << endl;
+		cerr << "Supported types: TRIVIAL, MDP, SP, MANHATTAN, ALPHA (default to SP)" << endl;
 		exit(1);
 		return NULL;
 	}
@@ -663,7 +669,7 @@ ParticleUpperBound* BaseTag::CreateParticleUpperBound(string name) const {
 ScenarioUpperBound* BaseTag::CreateScenarioUpperBound(string name,
 	string particle_bound_name) const {
 	if (name == "TRIVIAL" || name == "DEFAULT" || name == "MDP" ||
-			name == "SP" || name == "MANHATTAN") {
+			name == "SP" || name == "MANHATTAN" || name == "ALPHA") {
 		return CreateParticleUpperBound(name);
 	} else if (name == "LOOKAHEAD") {
 		return new LookaheadUpperBound(this, *this,
@@ -671,7 +677,7 @@ ScenarioUpperBound* BaseTag::CreateScenarioUpperBound(string name,
 	} else {
 		if (name != "print")
 			cerr << "Unsupported upper bound: " << name << endl;
-		cerr << "Supported types: TRIVIAL, MDP, SP, MANHATTAN, LOOKAHEAD (default to SP)" << endl;
+		cerr << "Supported types: TRIVIAL, MDP, SP, MANHATTAN, ALPHA, LOOKAHEAD (default to SP)" << endl;
 		cerr << "With base upper bound: LOOKAHEAD" << endl;
 		exit(1);
 		return NULL;
@@ -685,10 +691,26 @@ BeliefUpperBound* BaseTag::CreateBeliefUpperBound(string name) const {
 		return new MDPUpperBound(this, *this);
 	} else if (name == "MANHATTAN") {
 		return new TagManhattanUpperBound(this);
+	} else if (name == "ALPHA") {
+		return new AlphaVectorUpperBound(this, *this);
 	} else {
 		if (name != "print")
 			cerr << "Unsupported belief upper bound: " << name << endl;
-		cerr << "Supported types: TRIVIAL, MDP, MANHATTAN (default to MDP)" << endl;
+		cerr << "Supported types: TRIVIAL, MDP, MANHATTAN, ALPHA (default to MDP)" << endl;
+		exit(1);
+		return NULL;
+	}
+}
+
+ParticleLowerBound* BaseTag::CreateParticleLowerBound(string name) const {
+	if (name == "TRIVIAL" || name == "DEFAULT") {
+		return new TrivialParticleLowerBound(this);
+	} else if (name == "ALPHA") {
+		return new AlphaVectorLowerBound(this, this, *this);
+	} else {
+		if (name != "print")
+			cerr << "Unsupported particle lower bound: " << name << endl;
+		cerr << "Supported types: TRIVIAL, ALPHA (default to TRIVIAL)" << endl;
 		exit(1);
 		return NULL;
 	}
@@ -702,6 +724,8 @@ ScenarioLowerBound* BaseTag::CreateScenarioLowerBound(string name, string
 	const MMAPInferencer* mmap_inferencer = this;
 	if (name == "TRIVIAL") {
 		return new TrivialParticleLowerBound(model);
+	} else if (name == "ALPHA") {
+		return CreateParticleLowerBound(name);
 	} else if (name == "RANDOM") {
 		return new RandomPolicy(model,
 			CreateParticleLowerBound(particle_bound_name));
@@ -740,7 +764,7 @@ ScenarioLowerBound* BaseTag::CreateScenarioLowerBound(string name, string
 	} else {
 		if (name != "print")
 			cerr << "Unsupported lower bound: " << name << endl;
-		cerr << "Supported types: TRIVIAL, RANDOM, SHR, MODE-MDP, MODE-SP, MAJORITY-MDP, MAJORITY-SP (default to MODE-MDP)" << endl;
+		cerr << "Supported types: TRIVIAL, ALPHA, RANDOM, SHR, MODE-MDP, MODE-SP, MAJORITY-MDP, MAJORITY-SP (default to MODE-MDP)" << endl;
 		cerr << "With base lower bound: except TRIVIAL" << endl;
 		exit(1);
 		return NULL;
@@ -771,6 +795,22 @@ POMCPPrior* BaseTag::CreatePOMCPPrior(string name) const {
 	}
 }
 
+uint64_t BaseTag::Hash(const State& state) const {
+	return state.state_id;
+}
+
+bool BaseTag::Equal(const State& s1, const State& s2) const {
+	return s1.state_id == s2.state_id;
+}
+
+// A state is given by its state_id, which is written for every state
+void BaseTag::WriteState(const State& state, CheckpointWriter& writer) const {
+}
+
+State* BaseTag::ReadState(CheckpointReader& reader) const {
+	return Allocate(-1, 0);
+}
+
 void BaseTag::PrintState(const State& s, ostream& out) const {
 	const TagState& state = static_cast<const TagState&>(s);
 
@@ -982,6 +1022,60 @@ Belief* BaseTag::Tau(const Belief* belief, ACT_TYPE action, OBS_TYPE obs) const
 	return new ParticleBelief(new_particles, this, NULL, false);
 }
 
+/**
+ * Computes the predicted distribution over next states once and weights it
+ * by the observation probabilities of each observation, instead of repeating
+ * the prediction in Tau for every observation.
+ */
+void BaseTag::Successors(const Belief* belief, ACT_TYPE action,
+	map<OBS_TYPE, double>& obss, map<OBS_TYPE, Belief*>& successors) const {
+	static vector<double> probs = vector<double>(NumStates());
+	static vector<int> reached;
+
+	const vector<State*>& particles =
+		static_cast<const ParticleBelief*>(belief)->particles();
+
+	for (int i = 0; i < particles.size(); i++) {
+		TagState* state = static_cast<TagState*>(particles[i]);
+		const vector<State>& distribution = transition_probabilities_[GetIndex(
+			state)][action];
+		for (int j = 0; j < distribution.size(); j++) {
+			const State& next = distribution[j];
+			if (probs[next.state_id] == 0)
+				reached.push_back(next.state_id);
+			probs[next.state_id] += state->weight * next.weight;
+		}
+	}
+	sort(reached.begin(), reached.end());
+
+	Observe(belief, action, obss);
+	for (map<OBS_TYPE, double>::iterator it = obss.begin(); it != obss.end();
+		it++) {
+		OBS_TYPE obs = it->first;
+
+		double sum = 0;
+		vector<State*> new_particles;
+		for (int i = 0; i < reached.size(); i++) {
+			int s = reached[i];
+			double p = probs[s] * ObsProb(obs, *(states_[s]), action);
+			if (p > 0) {
+				State* new_particle = Copy(states_[s]);
+				new_particle->weight = p;
+				new_particles.push_back(new_particle);
+				sum += p;
+			}
+		}
+		for (int i = 0; i < new_particles.size(); i++)
+			new_particles[i]->weight /= sum;
+
+		successors[obs] = new ParticleBelief(new_particles, this, NULL, false);
+	}
+
+	for (int i = 0; i < reached.size(); i++)
+		probs[reached[i]] = 0;
+	reached.clear();
+}
+
 double BaseTag::StepReward(const Belief* belief, ACT_TYPE action) const {
 	const vector<State*>& particles =
 		static_cast<const ParticleBelief*>(belief)->particles();
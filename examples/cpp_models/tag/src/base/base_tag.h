@@ -120,6 +120,9 @@ public:
 	inline double GetMaxReward() const {
 		return TAG_REWARD;
 	}
+	inline double GetMinReward() const {
+		return -TAG_REWARD;
+	}
 	ParticleUpperBound* CreateParticleUpperBound(std::string name = "DEFAULT") const;
 	ScenarioUpperBound* CreateScenarioUpperBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
@@ -128,12 +131,18 @@ public:
 	inline ValuedAction GetBestAction() const {
 		return ValuedAction(0, -1);
 	}
+	ParticleLowerBound* CreateParticleLowerBound(std::string name = "DEFAULT") const;
 	ScenarioLowerBound* CreateScenarioLowerBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 	BeliefLowerBound* CreateBeliefLowerBound(std::string name = "DEFAULT") const;
 
 	POMCPPrior* CreatePOMCPPrior(std::string name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	virtual void PrintObs(const State& state, OBS_TYPE obs, std::ostream& out = std::cout) const = 0;
@@ -152,6 +161,9 @@ public:
 	int GetAction(const State& tagstate) const;
 
 	Belief* Tau(const Belief* belief, ACT_TYPE action, OBS_TYPE obs) const;
+	void Successors(const Belief* belief, ACT_TYPE action,
+		std::map<OBS_TYPE, double>& obss,
+		std::map<OBS_TYPE, Belief*>& successors) const;
 	void Observe(const Belief* belief, ACT_TYPE action, std::map<OBS_TYPE, double>& obss) const = 0;
 	double StepReward(const Belief* belief, ACT_TYPE action) const;
 };
@@ -152,6 +152,25 @@ ScenarioLowerBound* Tiger::CreateScenarioLowerBound(string name,
 	return bound;
 }
 
+uint64_t Tiger::Hash(const State& state) const {
+	return static_cast<const TigerState&>(state).tiger_position;
+}
+
+bool Tiger::Equal(const State& s1, const State& s2) const {
+	return static_cast<const TigerState&>(s1).tiger_position
+		== static_cast<const TigerState&>(s2).tiger_position;
+}
+
+void Tiger::WriteState(const State& state, CheckpointWriter& writer) const {
+	writer.WriteValue(static_cast<const TigerState&>(state).tiger_position);
+}
+
+State* Tiger::ReadState(CheckpointReader& reader) const {
+	TigerState* state = static_cast<TigerState*>(Allocate(-1, 0));
+	reader.ReadValue(state->tiger_position);
+	return state;
+}
+
 void Tiger::PrintState(const State& state, ostream& out) const {
 	const TigerState& tigerstate = static_cast<const TigerState&>(state);
 	out << tigerstate.text() << endl;
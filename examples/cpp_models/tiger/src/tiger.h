@@ -34,6 +34,9 @@ public:
 
 	Tiger();
 	Tiger(std::string params_file);
+	DSPOMDP* MakeCopy() const {
+		return new Tiger();
+	}
 
 	bool Step(State& s, double random_num, ACT_TYPE action, double& reward,
 		OBS_TYPE& obs) const;
@@ -47,6 +50,9 @@ public:
 	inline double GetMaxReward() const {
 		return 10;
 	}
+	inline double GetMinReward() const {
+		return -100;
+	}
 
 	inline ValuedAction GetBestAction() const {
 		return ValuedAction(LISTEN, -1);
@@ -54,6 +60,11 @@ public:
 	ScenarioLowerBound* CreateScenarioLowerBound(std::string name = "DEFAULT",
 		std::string particle_bound_name = "DEFAULT") const;
 
+	uint64_t Hash(const State& state) const;
+	bool Equal(const State& s1, const State& s2) const;
+	void WriteState(const State& state, CheckpointWriter& writer) const;
+	State* ReadState(CheckpointReader& reader) const;
+
 	void PrintState(const State& state, std::ostream& out = std::cout) const;
 	void PrintBelief(const Belief& belief, std::ostream& out = std::cout) const;
 	void PrintObs(const State& state, OBS_TYPE obs, std::ostream& out = std::cout) const;
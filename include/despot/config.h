@@ -7,10 +7,21 @@ namespace despot {
 
 struct Config {
 	double time_per_move;  // CPU time available to construct the search tree
+	int max_trials; // If positive, stop the search after this many trials (DESPOT), iterations (AEMS) or simulations (POMCP) instead of after time_per_move
+	int max_tree_particles; // If positive, the number of particles a DESPOT tree may hold; when reached, closed subtrees are recycled and then open ones off the path of the next trial are collapsed
+	bool replay_particles; // Only keep particles at the root of a DESPOT tree, regenerating those of a node from the root when it is expanded
+	bool merge_transpositions; // Share DESPOT belief nodes at the same depth with the same particles, turning the tree into a DAG
+	std::string alpha_vectors_file; // If set, files caching the alpha vectors of ALPHA bounds are named after it
+	int bound_cache_size; // If positive, the number of entries of a cache sharing the bounds of DESPOT nodes with the same particles
+	bool reuse_tree; // Keep the DESPOT subtrees after the chosen action, refine them while it executes, and start the next search from the one of the received observation
+	int pipeline_branches; // If positive, the number of most likely observations of the executed action from whose beliefs the solver searches while the action executes
+	std::string checkpoint_file; // If set, the planning state is saved to this file after every step and restored from it when the planner starts
+	int num_threads; // Number of threads running POMCP simulations on a shared tree (with more than one, time_per_move is wall-clock time) computing alpha vector bounds and Tag floor distances, and updating Pocman beliefs
 	int sim_len; // The number of simulation steps for each episode.
 	int num_scenarios; // The number of scenarios usedto generate the DESPOT tree
 	int search_depth; // The maximum depth of the search tree
 	int max_policy_sim_len; // Maximum number of steps for simulating the default policy (rollout). Note that the depth of rollouts won't exceed the maximum search depth.
+	double rollout_tolerance; // If positive, POMCP rollouts stop once the discounted reward they can still collect, bounded from GetMaxReward and GetMinReward, is below this
 	double discount; // The discount factor
 	double pruning_constant; // The pruning constant attached to each node for regularization purpose
 	double xi; // xi * gap(root) is the target uncertainty at the root.
@@ -21,10 +32,21 @@ struct Config {
 
 	Config() :
 		time_per_move(1),
+		max_trials(0),
+		max_tree_particles(0),
+		replay_particles(false),
+		merge_transpositions(false),
+		alpha_vectors_file(""),
+		bound_cache_size(0),
+		reuse_tree(false),
+		pipeline_branches(0),
+		checkpoint_file(""),
+		num_threads(1),
 		sim_len(90),
 		num_scenarios(500),
 		search_depth(90),
 		max_policy_sim_len(90),
+		rollout_tolerance(0),
 		discount(0.95),
 		pruning_constant(0),
 		xi(0.95),
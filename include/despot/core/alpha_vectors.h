@@ -0,0 +1,144 @@
+#ifndef ALPHA_VECTORS_H
+#define ALPHA_VECTORS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <despot/interface/lower_bound.h>
+#include <despot/interface/upper_bound.h>
+#include <despot/interface/pomdp.h>
+#include <despot/core/mdp.h>
+
+namespace despot {
+
+/* =============================================================================
+ * AlphaVectors class
+ * =============================================================================*/
+
+/**
+ * One alpha vector per action over the states of an MDP, bounding the value
+ * of a set of particles by max_a sum_i w_i alpha_a(s_i).
+ *
+ * The vectors are computed offline by value iteration with sparse backups
+ * over MDP::TransitionProbability, the states being split across threads:
+ * <ol>
+ * <li> QMDP vectors, alpha_a(s) = Q(s, a) of the fully observable MDP, give an
+ * upper bound. They are iterated down from max reward / (1 - discount) and
+ * remain upper bounds after any number of iterations.
+ * <li> Blind policy vectors, alpha_a(s) = value of always taking a, give a
+ * lower bound and the action to take. They are iterated up from the lowest
+ * reward / (1 - discount).
+ * </ol>
+ * Computed vectors can be saved to a binary file and loaded back, so that
+ * the precomputation runs once per model.
+ */
+class AlphaVectors {
+public:
+	enum Type {
+		QMDP, BLIND
+	};
+
+protected:
+	int num_states_, num_actions_;
+	std::vector<double> values_; // alpha_a(s) at s * num_actions_ + a
+
+	// Buffers for the indices and weights of the particles being evaluated
+	mutable std::vector<int> indices_;
+	mutable std::vector<double> weights_;
+	mutable std::vector<double> action_values_;
+
+	static void* BackupStates(void* task);
+
+	/**
+	 * Hash of the rewards and transitions of the model, stored with the
+	 * vectors so that those of another model are not loaded.
+	 */
+	static uint64_t Fingerprint(const MDP* model);
+
+public:
+	AlphaVectors();
+
+	/**
+	 * Computes the vectors of the given type with num_threads threads.
+	 */
+	void Compute(const MDP* model, Type type, int num_threads);
+
+	/**
+	 * Loads the vectors from file if it holds vectors for the given model
+	 * and the current discount factor, and computes and saves them there
+	 * otherwise. Nothing is saved if file is empty.
+	 */
+	void LoadOrCompute(const MDP* model, Type type, const std::string& file,
+		int num_threads);
+
+	bool Save(const std::string& file, const MDP* model) const;
+	bool Load(const std::string& file, const MDP* model);
+
+	int NumStates() const;
+	int NumActions() const;
+
+	inline double Value(int state, ACT_TYPE action) const {
+		return values_[state * num_actions_ + action];
+	}
+
+	/**
+	 * Returns the best action and its value max_a sum_i w_i alpha_a(s_i) on a
+	 * set of particles, gathering their state indices first and accumulating
+	 * all actions in one pass.
+	 */
+	ValuedAction Value(const std::vector<State*>& particles,
+		const StateIndexer& indexer) const;
+};
+
+/* =============================================================================
+ * AlphaVectorUpperBound class
+ * =============================================================================*/
+
+/**
+ * Upper bound given by QMDP alpha vectors, tighter than MDPUpperBound on sets
+ * of particles since a single action is maximized over for all of them. The
+ * vectors are loaded from Globals::config.alpha_vectors_file + ".qmdp" when
+ * that is set, and computed (and saved there) otherwise.
+ */
+class AlphaVectorUpperBound: public ParticleUpperBound, public BeliefUpperBound {
+protected:
+	const StateIndexer& indexer_;
+	AlphaVectors alpha_vectors_;
+
+public:
+	AlphaVectorUpperBound(const MDP* model, const StateIndexer& indexer);
+
+	double Value(const State& state) const;
+
+	double Value(const std::vector<State*>& particles, RandomStreams& streams,
+		History& history) const;
+
+	double Value(const Belief* belief) const;
+};
+
+/* =============================================================================
+ * AlphaVectorLowerBound class
+ * =============================================================================*/
+
+/**
+ * Lower bound given by blind policy alpha vectors: the value of always taking
+ * the best single action. The vectors are loaded from
+ * Globals::config.alpha_vectors_file + ".blind" when that is set, and
+ * computed (and saved there) otherwise.
+ */
+class AlphaVectorLowerBound: public ParticleLowerBound {
+protected:
+	const StateIndexer& indexer_;
+	AlphaVectors alpha_vectors_;
+
+public:
+	AlphaVectorLowerBound(const DSPOMDP* model, const MDP* mdp,
+		const StateIndexer& indexer);
+
+	ValuedAction Value(const std::vector<State*>& particles) const;
+};
+
+} // namespace despot
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef BOUND_CACHE_H
+#define BOUND_CACHE_H
+
+#include <vector>
+
+#include <despot/interface/lower_bound.h>
+#include <despot/interface/upper_bound.h>
+#include <despot/interface/pomdp.h>
+
+namespace despot {
+
+/* =============================================================================
+ * BoundCache class
+ * =============================================================================*/
+
+/**
+ * Transposition cache for the bounds of DESPOT nodes. The bounds of a node
+ * depend on its particles and on the position in the random streams, and on
+ * the history for bounds whose UsesHistory() is true, such as the default
+ * policies of Tag or Pocman. Nodes reached through different paths with the
+ * same scenarios in the same states share their bounds if the bounds do not
+ * use the history.
+ *
+ * Entries are keyed by a 64-bit hash of the stream position and of the
+ * scenario id, weight and state hash (DSPOMDP::Hash) of every particle, to
+ * which the keys of bounds using the history add its actions and
+ * observations. They are stored in a direct-mapped table: a new entry
+ * replaces the one in its slot. Each entry keeps copies of the particles it
+ * was computed for, and a hit is only taken if they are equal
+ * (DSPOMDP::Equal) to the particles looked up, so that hash collisions never
+ * return the bounds of another particle set. The copies hold at most the
+ * particles of as many nodes as the table has entries.
+ *
+ * Bounds depend on the random streams, so the cache has to be cleared
+ * whenever they are regenerated, which the cached bounds below do in Init.
+ */
+class BoundCache {
+private:
+	struct Entry {
+		uint64_t key; // 0 for an empty slot
+		bool has_lower, has_upper;
+		ValuedAction lower;
+		double upper;
+		std::vector<State*> particles; // Copies, checked on a hit
+	};
+
+	const DSPOMDP* model_;
+	std::vector<Entry> entries_;
+	uint64_t mask_;
+
+	long lookups_, hits_;
+
+	Entry& Slot(uint64_t key);
+	bool Matches(const Entry& entry, uint64_t key,
+		const std::vector<State*>& particles) const;
+	Entry& Claim(uint64_t key, const std::vector<State*>& particles);
+
+public:
+	/**
+	 * @param size Number of entries, rounded up to a power of two
+	 */
+	BoundCache(const DSPOMDP* model, int size);
+	~BoundCache();
+
+	/**
+	 * Key of bounds that do not use the history
+	 */
+	uint64_t Key(const std::vector<State*>& particles,
+		const RandomStreams& streams) const;
+	/**
+	 * Key of bounds that use the history
+	 */
+	uint64_t Key(const std::vector<State*>& particles,
+		const RandomStreams& streams, const History& history) const;
+
+	bool FindLower(uint64_t key, const std::vector<State*>& particles,
+		ValuedAction& value);
+	void StoreLower(uint64_t key, const std::vector<State*>& particles,
+		const ValuedAction& value);
+	bool FindUpper(uint64_t key, const std::vector<State*>& particles,
+		double& value);
+	void StoreUpper(uint64_t key, const std::vector<State*>& particles,
+		double value);
+
+	void Clear();
+
+	long lookups() const;
+	long hits() const;
+	void ResetStatistics();
+};
+
+/* =============================================================================
+ * CachedScenarioLowerBound class
+ * =============================================================================*/
+
+/**
+ * Looks up the lower bound of a particle set in a BoundCache before
+ * computing it with the underlying bound.
+ */
+class CachedScenarioLowerBound: public ScenarioLowerBound {
+private:
+	ScenarioLowerBound* bound_;
+	BoundCache* cache_;
+
+public:
+	CachedScenarioLowerBound(ScenarioLowerBound* bound, BoundCache* cache);
+
+	ScenarioLowerBound* bound() const;
+	BoundCache* cache() const;
+
+	void Init(const RandomStreams& streams);
+	void Learn(VNode* tree);
+	void Reset();
+	bool UsesHistory() const;
+
+	ValuedAction Value(const std::vector<State*>& particles,
+		RandomStreams& streams, History& history) const;
+};
+
+/* =============================================================================
+ * CachedScenarioUpperBound class
+ * =============================================================================*/
+
+/**
+ * Looks up the upper bound of a particle set in a BoundCache before
+ * computing it with the underlying bound.
+ */
+class CachedScenarioUpperBound: public ScenarioUpperBound {
+private:
+	ScenarioUpperBound* bound_;
+	BoundCache* cache_;
+
+public:
+	CachedScenarioUpperBound(ScenarioUpperBound* bound, BoundCache* cache);
+
+	ScenarioUpperBound* bound() const;
+	BoundCache* cache() const;
+
+	void Init(const RandomStreams& streams);
+	bool UsesHistory() const;
+
+	double Value(const std::vector<State*>& particles, RandomStreams& streams,
+		History& history) const;
+};
+
+} // namespace despot
+
+#endif
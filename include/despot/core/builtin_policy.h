@@ -20,6 +20,7 @@ public:
 
 	ACT_TYPE Action(const std::vector<State*>& particles, RandomStreams& streams,
 		History& history) const;
+	bool UsesHistory() const;
 
 	ValuedAction Search();
 	void Update(ACT_TYPE action, OBS_TYPE obs);
@@ -61,6 +62,7 @@ public:
 
 	ACT_TYPE Action(const std::vector<State*>& particles, RandomStreams& streams,
 		History& history) const;
+	bool UsesHistory() const;
 };
 
 /* =============================================================================
@@ -78,6 +80,7 @@ public:
 
 	ACT_TYPE Action(const std::vector<State*>& particles, RandomStreams& streams,
 		History& history) const;
+	bool UsesHistory() const;
 };
 
 /* =============================================================================
@@ -94,6 +97,7 @@ public:
 
 	ACT_TYPE Action(const std::vector<State*>& particles, RandomStreams& streams,
 		History& history) const;
+	bool UsesHistory() const;
 };
 
 } // namespace despot
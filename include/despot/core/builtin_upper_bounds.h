@@ -41,6 +41,8 @@ public:
 
 	double Value(const std::vector<State*>& particles,
 		RandomStreams& streams, History& history) const;
+
+	bool UsesHistory() const;
 };
 
 /* =============================================================================
@@ -65,14 +67,22 @@ protected:
 	const MDP* model_;
 	const StateIndexer& indexer_;
 	std::vector<ValuedAction> policy_;
+	std::vector<double> values_; // Values of policy_, contiguous
+
+	// Buffers for the indices and weights of the particles being evaluated
+	mutable std::vector<int> indices_;
+	mutable std::vector<double> weights_;
+
+	double Value(const std::vector<State*>& particles) const;
 
 public:
 	MDPUpperBound(const MDP* model, const StateIndexer& indexer);
 
-  // shut off "hides overloaded virtual function" warning
-  using ParticleUpperBound::Value;
 	double Value(const State& state) const;
 
+	double Value(const std::vector<State*>& particles, RandomStreams& streams,
+		History& history) const;
+
 	double Value(const Belief* belief) const;
 };
 
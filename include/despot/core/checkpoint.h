@@ -0,0 +1,128 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <despot/core/history.h>
+
+namespace despot {
+
+class State;
+class DSPOMDP;
+class RandomStreams;
+class VNode;
+
+/* =============================================================================
+ * CheckpointWriter class
+ * =============================================================================*/
+
+/**
+ * Binary snapshot of planning state, written so that a restarted planner
+ * resumes where it stopped instead of rebuilding its belief and trees.
+ * Values are written in the machine's own layout, so a checkpoint is read
+ * back on the same platform by the same build.
+ *
+ * The file starts with the magic string "DESPOTCP". The checkpoint is first
+ * written next to the file and renamed over it by Close() once complete, so
+ * an interrupted write leaves the previous checkpoint intact.
+ *
+ * Errors are sticky: after a failed write, further writes do nothing and
+ * Close() discards the checkpoint and returns false.
+ */
+class CheckpointWriter {
+protected:
+	const DSPOMDP* model_;
+	std::string file_;
+	std::string temp_file_;
+	FILE* out_;
+	bool ok_;
+
+public:
+	CheckpointWriter(const DSPOMDP* model);
+	~CheckpointWriter();
+
+	bool Open(const std::string& file);
+	bool Close();
+	bool ok() const;
+	const DSPOMDP* model() const;
+
+	void Write(const void* data, size_t size);
+
+	template<class T>
+	void WriteValue(const T& value) {
+		Write(&value, sizeof(T));
+	}
+
+	void WriteString(const std::string& str);
+	void WriteHistory(const History& history);
+	void WriteStreams(const RandomStreams& streams);
+
+	/**
+	 * Writes the scenario id, weight and state id of each particle, followed
+	 * by the rest of its state as written by DSPOMDP::WriteState.
+	 */
+	void WriteParticles(const std::vector<State*>& particles);
+
+	/**
+	 * Writes a search tree in preorder: bounds, default moves and visit
+	 * statistics of every node, and the particles of belief nodes. A node
+	 * shared by several parents in a DAG is written under each of them.
+	 */
+	void WriteTree(VNode* root);
+};
+
+/* =============================================================================
+ * CheckpointReader class
+ * =============================================================================*/
+
+/**
+ * Reads back what a CheckpointWriter wrote, in the same order. Each Read
+ * returns false once the file is exhausted or does not hold what is
+ * expected, and so do all later ones.
+ */
+class CheckpointReader {
+protected:
+	const DSPOMDP* model_;
+	FILE* in_;
+	bool ok_;
+
+public:
+	CheckpointReader(const DSPOMDP* model);
+	~CheckpointReader();
+
+	/**
+	 * Opens a checkpoint and checks its magic string. Returns false without
+	 * logging an error if there is no file.
+	 */
+	bool Open(const std::string& file);
+	void Close();
+	bool ok() const;
+	const DSPOMDP* model() const;
+
+	bool Read(void* data, size_t size);
+
+	template<class T>
+	bool ReadValue(T& value) {
+		return Read(&value, sizeof(T));
+	}
+
+	bool ReadString(std::string& str);
+	bool ReadHistory(History& history);
+	bool ReadStreams(RandomStreams& streams);
+
+	/**
+	 * Appends the particles read to particles.
+	 */
+	bool ReadParticles(std::vector<State*>& particles);
+
+	/**
+	 * Returns the tree read, or NULL if it cannot be read.
+	 */
+	VNode* ReadTree();
+};
+
+} // namespace despot
+
+#endif
@@ -18,6 +18,11 @@ protected:
 	std::vector<ValuedAction> policy_;
 
 	std::vector<std::vector<double> > blind_alpha_; // For blind policy
+	std::vector<double> blind_alpha_by_state_; // blind_alpha_[a][s] at s * NumActions() + a
+
+	// Buffers for the indices and weights of the particles being evaluated
+	mutable std::vector<int> indices_;
+	mutable std::vector<double> weights_;
 
 public:
 	virtual ~MDP();
@@ -33,6 +38,8 @@ public:
 	virtual void ComputeBlindAlpha();
 	double ComputeActionValue(const ParticleBelief* belief,
 		const StateIndexer& indexer, ACT_TYPE action) const;
+	void ComputeActionValues(const std::vector<State*>& particles,
+		const StateIndexer& indexer, std::vector<double>& values) const;
 	const std::vector<std::vector<double> >& blind_alpha() const;
 };
 
@@ -9,37 +9,143 @@
 namespace despot {
 
 class QNode;
+class VNode;
+
+/* =============================================================================
+ * ObsChildren class
+ * =============================================================================*/
+
+/**
+ * Children of a QNode, keyed by observation. Provides the subset of the
+ * std::map interface used by the solvers, but stores the (observation, node)
+ * pairs contiguously in a vector sorted by observation. Iteration order is
+ * the same as that of a map, while backups walk a single array instead of
+ * chasing one heap-allocated tree node per child.
+ */
+class ObsChildren {
+public:
+	typedef std::pair<OBS_TYPE, VNode*> value_type;
+	typedef std::vector<value_type>::iterator iterator;
+	typedef std::vector<value_type>::const_iterator const_iterator;
+
+protected:
+	std::vector<value_type> entries_;
+
+	iterator LowerBound(OBS_TYPE obs);
+	const_iterator LowerBound(OBS_TYPE obs) const;
+
+public:
+	inline iterator begin() {
+		return entries_.begin();
+	}
+	inline iterator end() {
+		return entries_.end();
+	}
+	inline const_iterator begin() const {
+		return entries_.begin();
+	}
+	inline const_iterator end() const {
+		return entries_.end();
+	}
+	inline int size() const {
+		return entries_.size();
+	}
+	inline bool empty() const {
+		return entries_.empty();
+	}
+	inline void reserve(int n) {
+		entries_.reserve(n);
+	}
+	inline void clear() {
+		entries_.clear();
+	}
+
+	iterator find(OBS_TYPE obs);
+	const_iterator find(OBS_TYPE obs) const;
+	int count(OBS_TYPE obs) const;
+	void erase(OBS_TYPE obs);
+
+	/**
+	 * Returns the node for the given observation, inserting NULL if there is
+	 * none, as std::map::operator[] does. Inserting in increasing observation
+	 * order is amortized constant time.
+	 */
+	VNode*& operator[](OBS_TYPE obs);
+};
+
+/**
+ * Visit statistics of a node, kept by POMCP only. They are allocated on first
+ * use. POMCP sets the count of its nodes as it creates them, so that the
+ * block exists before the node is shared between threads.
+ */
+struct NodeVisits {
+	int count; // Number of visits on the node
+	int virtual_loss; // Number of parallel simulations currently passing through a QNode
+	volatile int children_lock; // Guards the children of a QNode during parallel simulations
+	double value; // Value of the node
+
+	NodeVisits() :
+		count(0),
+		virtual_loss(0),
+		children_lock(0),
+		value(0) {
+	}
+};
+
+/**
+ * Fields of the belief nodes of AEMS, allocated with them.
+ */
+struct AEMSFields {
+	Belief* belief;
+	double likelihood;
+	double approx_error; // Largest approximation error of a leaf below the node
+	VNode* approx_error_leaf; // The leaf with that error
+
+	AEMSFields(Belief* b, VNode* vnode) :
+		belief(b),
+		likelihood(1),
+		approx_error(0),
+		approx_error_leaf(vnode) {
+	}
+};
 
 /* =============================================================================
  * VNode class
  * =============================================================================*/
 
 /**
- * A belief/value/AND node in the search tree.
+ * A belief/value/AND node in the search tree. Fields used by a single solver
+ * live in side structures allocated only for the nodes of that solver, so
+ * that the nodes of DESPOT, the largest trees, stay small.
  */
 class VNode {
 protected:
-  std::vector<State*> particles_; // Used in DESPOT
-	Belief* belief_; // Used in AEMS
+	// Fields read on every backup (Update, Backup, SelectBestUpperBoundNode)
+	// come first so that they share the first cache line of the node.
+	double lower_bound_;
+	double upper_bound_;
+	ValuedAction default_move_; // Value and action given by default policy
+	std::vector<QNode*> children_;
+
+public:
+	double utility_upper_bound;
+
+protected:
+	double weight_; // Total weight of particles_, kept when they are freed
 	int depth_;
+	bool recycled_; // Closed node whose subtree was recycled, see DESPOT::RecycleClosedSubtrees
 	QNode* parent_;
 	OBS_TYPE edge_;
+	std::vector<State*> particles_; // Used in DESPOT
 
-	std::vector<QNode*> children_;
+	NodeVisits* visits_; // Used in POMCP
+	AEMSFields* aems_; // Used in AEMS
+	std::vector<QNode*>* other_parents_; // Parents sharing the node in a DESPOT DAG, if any
 
-	ValuedAction default_move_; // Value and action given by default policy
-	double lower_bound_;
-	double upper_bound_;
-
-	// For POMCP
-	int count_; // Number of visits on the node
-	double value_; // Value of the node
+	NodeVisits& visits();
+	AEMSFields& aems();
 
 public:
-	VNode* vstar;
-	double likelihood; // Used in AEMS
-	double utility_upper_bound;
-
 	VNode(std::vector<State*>& particles, int depth = 0, QNode* parent = NULL,
 		OBS_TYPE edge = -1);
 	VNode(Belief* belief, int depth = 0, QNode* parent = NULL, OBS_TYPE edge =
@@ -50,13 +156,28 @@ public:
 
 	Belief* belief() const;
 	const std::vector<State*>& particles() const;
+	void particles(const std::vector<State*>& particles);
+	void FreeParticles(const DSPOMDP& model);
 	void depth(int d);
 	int depth() const;
+	void recycled(bool r);
+	bool recycled() const;
 	void parent(QNode* parent);
 	QNode* parent();
 	OBS_TYPE edge();
+	void AddParent(QNode* parent);
+	const std::vector<QNode*>& other_parents() const;
+	bool IsChildOf(const QNode* qnode) const;
+
+	double likelihood() const;
+	void likelihood(double l);
+	double approx_error() const;
+	void approx_error(double e);
+	VNode* approx_error_leaf() const;
+	void approx_error_leaf(VNode* leaf);
 
 	double Weight() const;
+	void weight(double w);
 
 	const std::vector<QNode*>& children() const;
 	std::vector<QNode*>& children();
@@ -75,10 +196,18 @@ public:
 	bool IsLeaf();
 
 	void Add(double val);
+	void AtomicAdd(double val);
 	void count(int c);
-	int count() const;
+	inline int count() const {
+		return visits_ != NULL ? visits_->count : 0;
+	}
 	void value(double v);
-	double value() const;
+	inline double value() const {
+		return visits_ != NULL ? visits_->value : 0;
+	}
+	inline bool has_visits() const {
+		return visits_ != NULL;
+	}
 
 	void PrintTree(int depth = -1, std::ostream& os = std::cout);
 	void PrintPolicyTree(int depth = -1, std::ostream& os = std::cout);
@@ -95,23 +224,26 @@ public:
  */
 class QNode {
 protected:
-	VNode* parent_;
-	ACT_TYPE edge_;
-	std::map<OBS_TYPE, VNode*> children_;
+	// Fields read on every backup come first, see VNode
 	double lower_bound_;
 	double upper_bound_;
 
-	// For POMCP
-	int count_; // Number of visits on the node
-	double value_; // Value of the node
-
 public:
-	double default_value;
 	double utility_upper_bound;
 	double step_reward;
-	double likelihood;
-	VNode* vstar;
+	double default_value;
+
+protected:
+	ObsChildren children_;
 
+	VNode* parent_;
+	ACT_TYPE edge_;
+
+	NodeVisits* visits_; // Used in POMCP
+
+	NodeVisits& visits();
+
+public:
 	QNode(VNode* parent, int edge);
 	QNode(int count, double value);
 	~QNode();
@@ -119,7 +251,7 @@ public:
 	void parent(VNode* parent);
 	VNode* parent();
 	int edge();
-	std::map<OBS_TYPE, VNode*>& children();
+	ObsChildren& children();
 	VNode* Child(OBS_TYPE obs);
 	int Size() const;
 	int PolicyTreeSize() const;
@@ -132,10 +264,25 @@ public:
 	double upper_bound() const;
 
 	void Add(double val);
+	void AtomicAdd(double val);
 	void count(int c);
-	int count() const;
+	inline int count() const {
+		return visits_ != NULL ? visits_->count : 0;
+	}
 	void value(double v);
-	double value() const;
+	inline double value() const {
+		return visits_ != NULL ? visits_->value : 0;
+	}
+	inline bool has_visits() const {
+		return visits_ != NULL;
+	}
+
+	void AddVirtualLoss(int n);
+	inline int virtual_loss() const {
+		return visits_ != NULL ? visits_->virtual_loss : 0;
+	}
+	void LockChildren();
+	void UnlockChildren();
 };
 
 } // namespace despot
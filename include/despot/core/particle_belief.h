@@ -41,6 +41,9 @@ public:
 
 	virtual Belief* MakeCopy() const;
 
+	virtual bool Save(CheckpointWriter& writer) const;
+	virtual bool Restore(CheckpointReader& reader);
+
 	virtual std::string text() const;
 
 	static std::vector<State*> Sample(int num, std::vector<State*> belief,
@@ -32,6 +32,9 @@ public:
 	virtual inline void world_seed(unsigned seed) {
 		random_ = Random(seed);
 	}
+	inline const DSPOMDP* model() const {
+		return model_;
+	}
 
 public:
 	//establish connection to simulator or system
@@ -44,6 +47,9 @@ public:
 	void PrintState(const State& s, ostream& out) const;
 	//send action, receive reward, obs, and terminal
 	bool ExecuteAction(ACT_TYPE action, OBS_TYPE& obs);
+	//Write and read back the simulated state and random number generator
+	bool Save(CheckpointWriter& writer) const;
+	bool Restore(CheckpointReader& reader);
 };
 
 } /* namespace despot */
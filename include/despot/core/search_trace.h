@@ -0,0 +1,88 @@
+#ifndef SEARCH_TRACE_H
+#define SEARCH_TRACE_H
+
+#include <cstdio>
+#include <string>
+
+#include <despot/core/solver.h>
+
+namespace despot {
+
+/* =============================================================================
+ * SearchTrace class
+ * =============================================================================*/
+
+/**
+ * Process-wide sink for structured search metrics. Records are written as
+ * JSON lines, one object per line, so that traces from thousands of decisions
+ * can be aggregated offline (see tools/trace_summary.cpp).
+ *
+ * Two record types are produced:
+ * - "decision": one per call to Search(), carrying the SearchStatistics;
+ * - "trial": one per trial (DESPOT) or iteration (AEMS), carrying the trial
+ *   depth, duration, number of expansions and the root bounds after backup.
+ *   Only written when the trace is opened with trials enabled.
+ *
+ * Records of searches from a speculated belief (see Solver::Speculate) carry
+ * "speculative":true, so that they can be told from decisions.
+ *
+ * When no trace is open, enabled() is a single load of a static pointer, and
+ * callers are expected to test it before collecting anything.
+ */
+class SearchTrace {
+private:
+	static FILE* out_;
+	static bool trials_;
+	static int decision_;
+	static bool speculative_;
+
+public:
+	static bool Open(const std::string& file, bool trials = false);
+	static void Close();
+
+	static inline bool enabled() {
+		return out_ != NULL;
+	}
+
+	static inline bool trials_enabled() {
+		return out_ != NULL && trials_;
+	}
+
+	/**
+	 * Index of the decision currently being searched. Trial records carry
+	 * this index so that they can be grouped with their decision record.
+	 */
+	static inline int decision() {
+		return decision_;
+	}
+
+	/**
+	 * Set while a solver searches from a speculated belief.
+	 */
+	static inline void speculative(bool speculative) {
+		speculative_ = speculative;
+	}
+
+	static inline bool speculative() {
+		return speculative_;
+	}
+
+	static void Trial(int trial, int depth, double duration,
+		int num_expansions, double lower, double upper);
+
+	/**
+	 * Write the record for the decision that just finished and advance the
+	 * decision index.
+	 *
+	 * @param solver     Name of the solver that produced the decision
+	 * @param action     Chosen action and its value
+	 * @param statistics Statistics collected during the search
+	 * @param real_time  Wall-clock time spent in Search(), in seconds
+	 */
+	static void Decision(const char* solver, const ValuedAction& action,
+		const SearchStatistics& statistics, double real_time);
+};
+
+} // namespace despot
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef SHARED_MEMORY_WORLD_H
+#define SHARED_MEMORY_WORLD_H
+
+#include <string>
+#include <sys/types.h>
+
+#include <despot/interface/pomdp.h>
+#include <despot/interface/world.h>
+#include <despot/util/random.h>
+
+namespace despot {
+
+/* =============================================================================
+ * SharedMemoryChannel class
+ * =============================================================================*/
+
+/**
+ * Connection between a planner and a plant running in separate processes on
+ * the same machine, through a POSIX shared memory segment holding two
+ * single-producer single-consumer rings of fixed-size messages: requests
+ * from the planner to the plant and replies back. The rings are lock-free:
+ * each index is only written by one side, and waiting sides spin briefly
+ * before yielding the processor, so a message is picked up within
+ * microseconds without system calls on the fast path.
+ *
+ * The plant creates the segment and removes it when closed; the planner
+ * opens it, waiting for the plant to have created it.
+ */
+class SharedMemoryChannel {
+public:
+	enum MessageType {
+		RESET, // Restart the plant; replied to once it is in a start state
+		STEP, // Execute an action; replied to with obs, reward and terminal
+		CLOSE // The planner disconnects; not replied to
+	};
+
+	struct Message {
+		int type;
+		ACT_TYPE action;
+		int terminal;
+		OBS_TYPE obs;
+		double reward;
+	};
+
+protected:
+	struct Layout;
+
+	std::string name_;
+	Layout* layout_;
+	bool owner_;
+
+	bool Map(int fd);
+
+public:
+	SharedMemoryChannel();
+	~SharedMemoryChannel();
+
+	/**
+	 * Plant side: creates the segment with the given name (such as
+	 * "/despot_world"), replacing a stale one.
+	 */
+	bool Create(const std::string& name);
+
+	/**
+	 * Planner side: opens the segment with the given name, waiting up to
+	 * timeout seconds for the plant to create it.
+	 */
+	bool Open(const std::string& name, double timeout);
+
+	/**
+	 * Unmaps the segment, and removes it on the plant side.
+	 */
+	void Close();
+
+	bool IsOpen() const;
+	const std::string& name() const;
+
+	/**
+	 * Each call waits up to timeout seconds (forever if negative) for room in
+	 * or a message from its ring, and returns false if there is none by then.
+	 */
+	bool SendRequest(const Message& message, double timeout);
+	bool ReceiveRequest(Message& message, double timeout);
+	bool SendReply(const Message& message, double timeout);
+	bool ReceiveReply(Message& message, double timeout);
+};
+
+/* =============================================================================
+ * SharedMemoryWorld class
+ * =============================================================================*/
+
+/**
+ * World whose actions are executed by a plant in another process, through a
+ * SharedMemoryChannel. The true state lives in the plant, so
+ * GetCurrentState() returns NULL and the reward of the last step is
+ * reported in step_reward_.
+ *
+ * A plant serves RESET requests by restarting and replying with a RESET
+ * message, and STEP requests by replying with the observation, reward and
+ * terminal flag. SharedMemorySimulator is such a plant simulating a DSPOMDP.
+ */
+class SharedMemoryWorld: public World {
+protected:
+	const DSPOMDP* model_;
+	std::string name_;
+	double timeout_;
+	SharedMemoryChannel channel_;
+
+	bool Request(SharedMemoryChannel::Message& message);
+
+public:
+	double step_reward_;
+
+	/**
+	 * Connects to the segment with the given name; a request that is not
+	 * replied to within timeout seconds (forever if negative) ends the round.
+	 */
+	SharedMemoryWorld(const DSPOMDP* model, const std::string& name,
+		double timeout = 10);
+	virtual ~SharedMemoryWorld();
+
+	bool Connect();
+	State* Initialize();
+	State* GetCurrentState() const;
+	void PrintState(const State& s, std::ostream& out) const;
+	bool ExecuteAction(ACT_TYPE action, OBS_TYPE& obs);
+};
+
+/* =============================================================================
+ * SharedMemorySimulator class
+ * =============================================================================*/
+
+/**
+ * Plant simulating a DSPOMDP behind a SharedMemoryChannel, as a stand-in for
+ * a real system when testing a SharedMemoryWorld. Serve() runs the plant in
+ * the calling process, while Fork() runs it in a child process with its own
+ * copy of the model, so that the planner and the plant share no memory
+ * besides the segment, as with a real plant.
+ */
+class SharedMemorySimulator {
+protected:
+	const DSPOMDP* model_;
+	Random random_;
+	SharedMemoryChannel channel_;
+	State* state_;
+	pid_t parent_; // Set in a forked plant, which stops when its parent ends
+	pid_t child_;
+	std::string child_name_;
+
+public:
+	SharedMemorySimulator(const DSPOMDP* model, unsigned seed);
+	~SharedMemorySimulator();
+
+	/**
+	 * Creates the segment with the given name and serves requests on it until
+	 * the planner closes the connection, or in a forked plant, ends.
+	 */
+	void Serve(const std::string& name);
+
+	/**
+	 * Serves the segment with the given name in a child process, which is
+	 * waited for on destruction. Returns false if the process cannot be
+	 * created.
+	 */
+	bool Fork(const std::string& name);
+};
+
+} // namespace despot
+
+#endif
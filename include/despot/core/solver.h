@@ -4,11 +4,15 @@
 #include <despot/core/globals.h>
 #include <despot/core/history.h>
 
+#include <vector>
+
 namespace despot {
 
 class DSPOMDP;
 class Belief;
 struct ValuedAction;
+class CheckpointWriter;
+class CheckpointReader;
 
 /* =============================================================================
  * SearchStatistics class
@@ -28,12 +32,35 @@ struct SearchStatistics {
 	int num_particles_after_search;
 	int num_trials;
 	int longest_trial_length;
+	int peak_tree_nodes;
+	int peak_tree_particles;
+	int num_recycled_nodes;
+	long num_bound_cache_lookups;
+	long num_bound_cache_hits;
+	int num_merged_nodes;
 
 	SearchStatistics();
 
 	friend std::ostream& operator<<(std::ostream& os, const SearchStatistics& statitics);
 };
 
+/* =============================================================================
+ * Speculation class
+ * =============================================================================*/
+
+/**
+ * Search from the belief that follows an action and an observation that has
+ * not been received yet, made while the action executes.
+ */
+struct Speculation {
+	ACT_TYPE action;
+	OBS_TYPE obs;
+	Belief* belief; // Updated with action and obs; owned until committed
+	ACT_TYPE next_action; // Action found by the search from belief
+	// Likely observations of next_action from belief, most likely first
+	std::vector<std::pair<OBS_TYPE, double> > observations;
+};
+
 /* =============================================================================
  * Solver class
  * =============================================================================*/
@@ -44,6 +71,13 @@ protected:
 	Belief* belief_;
 	History history_;
 
+	// Flag that stops searches once set, see interrupt()
+	static const volatile int* interrupt_;
+
+	// Sorts observations by decreasing probability, keeping ties in order
+	static void SortObservations(
+		std::vector<std::pair<OBS_TYPE, double> >& obss);
+
 public:
 	Solver(const DSPOMDP* model, Belief* belief);
 	virtual ~Solver();
@@ -68,6 +102,60 @@ public:
 	 */
 	virtual void belief(Belief* b);
 	Belief* belief();
+
+	/**
+	 * Fills obss with the observations that action may lead to from the
+	 * current belief and their probabilities, most likely first. By default,
+	 * they are estimated by stepping particles sampled from the belief.
+	 */
+	virtual void PredictObservations(ACT_TYPE action,
+		std::vector<std::pair<OBS_TYPE, double> >& obss);
+
+	/**
+	 * Searches from the belief that would follow action and obs, leaving the
+	 * current belief and history unchanged. Returns false if the solver does
+	 * not support speculation, which is the default: solvers that keep their
+	 * tree across searches would have it changed.
+	 */
+	virtual bool Speculate(ACT_TYPE action, OBS_TYPE obs,
+		Speculation& speculation);
+
+	/**
+	 * Makes the belief of a speculation current, in place of
+	 * BeliefUpdate(speculation.action, speculation.obs), and frees the
+	 * previous belief.
+	 */
+	virtual void Commit(Speculation& speculation);
+
+	/**
+	 * Called repeatedly after a search while its action executes, to improve
+	 * what the next search starts from, doing a small amount of work per
+	 * call. Returns false once there is nothing left to refine, which is
+	 * always the case by default.
+	 */
+	virtual bool Refine();
+
+	/**
+	 * Makes searches return what they have found so far once *flag is set,
+	 * until called again with NULL. Pipelined steps use it to stop
+	 * speculative searches as soon as the observation is received.
+	 */
+	static void interrupt(const volatile int* flag);
+	static bool interrupted();
+
+	/**
+	 * Writes what the next search starts from to a checkpoint: the history
+	 * and belief, and the trees of solvers that keep them across searches.
+	 * Returns false if any of it cannot be saved.
+	 */
+	virtual bool Save(CheckpointWriter& writer) const;
+
+	/**
+	 * Restores what Save() wrote, in a solver of the same type whose belief
+	 * was created for the same model. Returns false, possibly with the
+	 * belief partly restored, if the checkpoint cannot be read.
+	 */
+	virtual bool Restore(CheckpointReader& reader);
 };
 
 } // namespace despot
@@ -0,0 +1,54 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include <map>
+#include <vector>
+
+#include <despot/interface/pomdp.h>
+
+namespace despot {
+
+class VNode;
+
+/* =============================================================================
+ * TranspositionTable class
+ * =============================================================================*/
+
+/**
+ * Belief nodes of a DESPOT, keyed by their depth and particles. The subtree
+ * below a node only depends on its depth and on the scenarios and states of
+ * its particles, so when expansion produces a node that is already in the
+ * table, the existing node is shared instead, turning the tree into a DAG.
+ *
+ * Nodes are identified by a 64-bit hash of their depth and of the scenario
+ * id, weight and state hash (DSPOMDP::Hash) of every particle. A node found
+ * by its key is only shared if its particles are equal (DSPOMDP::Equal) to
+ * the new ones, so that hash collisions do not merge distinct beliefs. Nodes
+ * whose particles were freed are never shared.
+ */
+class TranspositionTable {
+private:
+	const DSPOMDP* model_;
+	std::map<uint64_t, VNode*> nodes_;
+	int num_merged_;
+
+public:
+	TranspositionTable(const DSPOMDP* model);
+
+	uint64_t Key(const std::vector<State*>& particles, int depth) const;
+
+	/**
+	 * Returns the node with the given key and particles, or NULL if there is
+	 * none. A found node is counted as merged.
+	 */
+	VNode* Find(uint64_t key, const std::vector<State*>& particles);
+	void Insert(uint64_t key, VNode* vnode);
+	void Clear();
+
+	int size() const;
+	int num_merged() const;
+};
+
+} // namespace despot
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <deque>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace despot {
+
+class VNode;
+
+/**
+ * Record of one node in a tree export. Records have a fixed size and layout,
+ * so that the reader (see tools/tree_summary.cpp) can stream exports of
+ * millions of nodes without parsing.
+ */
+struct TreeExportNode {
+	enum Type {
+		BELIEF_NODE, ACTION_NODE
+	};
+
+	int64_t edge; // Observation of a belief node (-1 at the root), action of an action node
+	double lower_bound;
+	double upper_bound;
+	double weight;
+	double value; // For POMCP
+	int32_t id; // Index in the tree, parents coming before their children
+	int32_t parent; // -1 at the root
+	int32_t depth; // Depth of the belief node, or of the parent of an action node
+	int32_t count; // Number of visits, for POMCP
+	int32_t type;
+	int32_t num_children; // Including children shared with other parents
+};
+
+/**
+ * Header preceding the nodes of each tree in an export.
+ */
+struct TreeExportHeader {
+	char solver[16];
+	int32_t decision;
+	int32_t num_nodes;
+	int32_t speculative; // 1 for a search from a speculated belief
+};
+
+/* =============================================================================
+ * TreeExport class
+ * =============================================================================*/
+
+/**
+ * Process-wide sink writing the search tree of every decision to a binary
+ * file, for offline analysis of search behavior on large trees where
+ * VNode::PrintTree is unusable.
+ *
+ * The file starts with the magic string "DESPOTTE", followed for each
+ * decision by a TreeExportHeader and its TreeExportNode records, in the
+ * machine's own layout. Nodes shared by several parents in a DESPOT DAG are
+ * written once, under the parent that created them.
+ *
+ * Export() only copies the tree into a flat snapshot; a writer thread puts
+ * snapshots on disk while the search goes on. If the writer falls behind by
+ * more than a few snapshots, further ones are dropped rather than slowing the
+ * search, and leave a gap in the decision indices.
+ */
+class TreeExport {
+private:
+	struct Snapshot;
+
+	static FILE* out_;
+	static int decision_;
+	static int num_dropped_;
+	static bool closing_;
+	static pthread_t writer_;
+	static pthread_mutex_t mutex_;
+	static pthread_cond_t pending_cond_;
+	static std::deque<Snapshot*> pending_;
+	static Snapshot* spare_; // Written snapshot whose buffer is reused
+
+	static void* Write(void* arg);
+
+public:
+	static bool Open(const std::string& file);
+
+	/**
+	 * Waits for the pending snapshots to be written and closes the file.
+	 */
+	static void Close();
+
+	static inline bool enabled() {
+		return out_ != NULL;
+	}
+
+	/**
+	 * Queue the tree searched for the current decision for writing and
+	 * advance the decision index, which matches that of SearchTrace. Trees
+	 * searched from a speculated belief are flagged as speculative.
+	 */
+	static void Export(const char* solver, VNode* root,
+		bool speculative = false);
+};
+
+} // namespace despot
+
+#endif
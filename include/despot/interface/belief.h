@@ -12,6 +12,8 @@ namespace despot {
 class State;
 class StateIndexer;
 class DSPOMDP;
+class CheckpointWriter;
+class CheckpointReader;
 
 /* =============================================================================
  * Belief class
@@ -53,6 +55,19 @@ public:
 	 */
 	virtual Belief* MakeCopy() const = 0;
 
+	/**
+	 * Writes the belief and its history to a checkpoint. Returns false if the
+	 * belief cannot be saved, which is the default.
+	 */
+	virtual bool Save(CheckpointWriter& writer) const;
+
+	/**
+	 * Replaces the belief and its history with those saved by Save(), in a
+	 * belief of the same type created for the same model. Returns false if
+	 * they cannot be read.
+	 */
+	virtual bool Restore(CheckpointReader& reader);
+
 };
 
 } // namespace despot
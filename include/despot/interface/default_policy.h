@@ -46,11 +46,29 @@ struct ValuedAction {
  */
 class DefaultPolicy: public ScenarioLowerBound {
 private:
+	/* A group of particles sharing an observation history below the root */
+	struct Frame {
+		int begin, end; // Range of the particles in buffer_
+		int depth;
+		ACT_TYPE action; // Last action and observation of the history
+		OBS_TYPE obs;
+		double discount;
+	};
+
 	mutable int initial_depth_;
 	ParticleLowerBound* particle_lower_bound_;
+	bool partition_;
+
+	// Work space reused across calls to Value
+	mutable std::vector<State*> buffer_;
+	mutable std::vector<State*> group_;
+	mutable std::vector<std::pair<OBS_TYPE, int> > keys_; // (observation, index in group_)
+	mutable std::vector<std::pair<OBS_TYPE, int> > counts_; // (observation, count)
+	mutable std::vector<Frame> frames_;
 
-	ValuedAction RecursiveValue(const std::vector<State*>& particles,
-		RandomStreams& streams, History& history) const;
+	ValuedAction PartitionedValue(RandomStreams& streams,
+		History& history) const;
+	ValuedAction ScenarioValue(RandomStreams& streams, History& history) const;
 
 public:
 	DefaultPolicy(const DSPOMDP* model, ParticleLowerBound* particle_lower_bound);
@@ -58,6 +76,21 @@ public:
 
 	void Reset();
 
+	/**
+	 * By default, particles are partitioned by their observations and the
+	 * policy chooses one action per partition, given the observation history.
+	 * Policies that use neither the history nor the other particles of a
+	 * partition can be evaluated scenario by scenario instead, which avoids
+	 * partitioning. The action at the root is still chosen for all particles.
+	 */
+	void partition(bool p);
+	bool partition() const;
+
+	/**
+	 * Policies evaluated without partitions do not use the history.
+	 */
+	bool UsesHistory() const;
+
 	/**
 	 * Returns an action based on the weighted scenarios and the history
 	 *
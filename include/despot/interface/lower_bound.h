@@ -37,6 +37,14 @@ public:
 	virtual void Learn(VNode* tree);
 	virtual void Reset();
 
+	/**
+	 * Returns whether Value depends on the history, and not only on the
+	 * particles and the random streams. Bounds that do not should return
+	 * false, so that their values can be shared between paths (see
+	 * BoundCache). Defaults to true.
+	 */
+	virtual bool UsesHistory() const;
+
 	/**
 	 * Returns a lower bound for the maximum total discounted reward obtainable
 	 * by a policy on a set of weighted scenarios. The horizon is infinite. The
@@ -79,6 +87,8 @@ public:
 
 	ValuedAction Value(const std::vector<State*>& particles,
 		RandomStreams& streams, History& history) const;
+
+	bool UsesHistory() const;
 };
 
 /* =============================================================================
@@ -1,6 +1,7 @@
 #ifndef POMDP_H
 #define POMDP_H
 
+#include <despot/core/checkpoint.h>
 #include <despot/core/globals.h>
 #include <despot/interface/belief.h>
 #include <despot/random_streams.h>
@@ -58,6 +59,14 @@ public:
 	virtual int NumStates() const = 0;
 	virtual int GetIndex(const State* state) const = 0;
 	virtual const State* GetState(int index) const = 0;
+
+	/**
+	 * Writes the indices and weights of a set of particles into contiguous
+	 * arrays, so that tables indexed by state can be evaluated on the
+	 * particles in a single pass without further virtual calls.
+	 */
+	void Gather(const std::vector<State*>& particles, std::vector<int>& indices,
+		std::vector<double>& weights) const;
 };
 
 /* =============================================================================
@@ -207,6 +216,14 @@ public:
 	 */
 	virtual ValuedAction GetBestAction() const = 0;
 
+	/**
+	 * [Optional]
+	 * Returns the minimum reward, or negative infinity if it is not known.
+	 * Together with the maximum reward, it bounds the reward given up by
+	 * POMCP rollouts cut off by --rollout-tolerance.
+	 */
+	virtual double GetMinReward() const;
+
 	/**
 	 * [Optional]
 	 * Override to create custom ParticleUpperBounds for solvers
@@ -246,6 +263,68 @@ public:
 	 */
 	virtual POMCPPrior* CreatePOMCPPrior(std::string name = "DEFAULT") const;
 
+	/* ========================================================================
+	 * State comparison
+	 * ========================================================================*/
+	/**
+	 * [Optional]
+	 * Returns a hash of a state. Equal states must have equal hashes, and
+	 * distinct states should collide only by chance, since caches keyed by
+	 * hashes (e.g. the bound cache, --bound-cache) do not compare the states
+	 * themselves. Required by those caches; the default exits with an error.
+	 * @param state The state to be hashed
+	 */
+	virtual uint64_t Hash(const State& state) const;
+
+	/**
+	 * [Optional]
+	 * Returns whether two states are the same state of the model, ignoring
+	 * their state_id, scenario_id and weight unless the model itself encodes
+	 * the state in them. Must be consistent with Hash: equal states have
+	 * equal hashes. The default compares the hashes, which is exact only for
+	 * models whose hash identifies the state (e.g. a state index).
+	 * @param s1 The first state
+	 * @param s2 The second state
+	 */
+	virtual bool Equal(const State& s1, const State& s2) const;
+
+	/**
+	 * Returns a hash of a list of particles, combining the scenario id,
+	 * weight and state hash of each of them.
+	 * @param particles The particles to be hashed
+	 * @param seed Value the hash starts from, e.g. the depth of a node
+	 */
+	uint64_t Hash(const std::vector<State*>& particles, uint64_t seed = 0) const;
+
+	/**
+	 * Returns whether two lists of particles hold, in order, particles with
+	 * the same scenario ids, weights and states (by Equal).
+	 */
+	bool Equal(const std::vector<State*>& particles1,
+		const std::vector<State*>& particles2) const;
+
+	/* ========================================================================
+	 * Serialization
+	 * ========================================================================*/
+	/**
+	 * [Optional]
+	 * Writes a state to a checkpoint (--checkpoint), besides its state_id,
+	 * scenario_id and weight, which are written for every state. Required
+	 * to save particles; the default exits with an error.
+	 * @param state  The state to be written
+	 * @param writer The checkpoint being written
+	 */
+	virtual void WriteState(const State& state, CheckpointWriter& writer) const;
+
+	/**
+	 * [Optional]
+	 * Reads a state written by WriteState into a newly allocated state, whose
+	 * state_id, scenario_id and weight are then set by the caller. Whether
+	 * it could be read is checked on the reader, which frees the state if not.
+	 * @param reader The checkpoint being read
+	 */
+	virtual State* ReadState(CheckpointReader& reader) const;
+
 	/* ========================================================================
 	 * Display
 	 * ========================================================================*/
@@ -324,7 +403,9 @@ public:
 
 	/**
 	 * [Optional]
-	 * Returns a copy of this POMDP model.
+	 * Returns a copy of this POMDP model. With --pipeline or --reuse-tree,
+	 * the simulated world steps a copy while the solver searches, and
+	 * actions are executed before searching ahead if there is none.
 	 */
 	inline virtual DSPOMDP* MakeCopy() const {
 		return NULL;
@@ -362,6 +443,15 @@ public:
 	virtual void Observe(const Belief* belief, ACT_TYPE action,
 		std::map<OBS_TYPE, double>& obss) const = 0;
 
+  /**
+   * Observation probabilities and successor beliefs for all observations of
+   * an action. The default calls Observe and then Tau for each observation;
+   * models can override it to share the work between observations.
+   */
+	virtual void Successors(const Belief* belief, ACT_TYPE action,
+		std::map<OBS_TYPE, double>& obss,
+		std::map<OBS_TYPE, Belief*>& successors) const;
+
   /**
    * Reward function for the belief MDP.
    */
@@ -32,6 +32,12 @@ public:
 
 	virtual void Init(const RandomStreams& streams);
 
+	/**
+	 * Returns whether Value depends on the history, as for
+	 * ScenarioLowerBound::UsesHistory. Defaults to true.
+	 */
+	virtual bool UsesHistory() const;
+
 	/**
 	 * Returns a upper bound for the maximum total discounted reward
 	 * on a set of weighted scenarios. The horizon is infinite.
@@ -77,6 +83,8 @@ public:
 	 */
 	virtual double Value(const std::vector<State*>& particles,
 		RandomStreams& streams, History& history) const;
+
+	bool UsesHistory() const;
 };
 
 
@@ -14,6 +14,9 @@ using namespace std;
 
 namespace despot {
 
+class CheckpointWriter;
+class CheckpointReader;
+
 /* =============================================================================
  * World class
  * =============================================================================*/
@@ -62,6 +65,20 @@ public:
 	 * @param obs    Observation sent back from the real-world system
 	 */
 	virtual bool ExecuteAction(ACT_TYPE action, OBS_TYPE& obs) =0;
+
+	/**
+	 * [Optional]
+	 * Write the state of a simulated world to a planner checkpoint (see
+	 * --checkpoint). Worlds whose state lives outside the planner have
+	 * nothing to write, which is the default.
+	 */
+	virtual bool Save(CheckpointWriter& writer) const;
+
+	/**
+	 * [Optional]
+	 * Restore what Save() wrote
+	 */
+	virtual bool Restore(CheckpointReader& reader);
 };
 
 } /* namespace despot */
@@ -130,6 +130,14 @@ public:
 	double StderrDiscountedRoundReward() const;
 
 	void CheckTargetTime() const;
+
+	/**
+	 * Writes the step and reward totals of the current round to a planner
+	 * checkpoint, and reads them back. Restore() is called after the world
+	 * is restored, whose state it then logs.
+	 */
+	void Save(CheckpointWriter& writer) const;
+	bool Restore(CheckpointReader& reader);
 };
 
 } // namespace despot
@@ -16,6 +16,25 @@ class Planner: public PlannerBase {
 protected:
 	int step_;
 	int round_;
+	// Action found by a committed speculative search for the next step, or -1
+	ACT_TYPE next_action_;
+	// Whether Globals::config.checkpoint_file was looked for, which is done
+	// once, when the first round starts
+	bool checkpoint_checked_;
+
+	/**
+	 * Writes the random number generators, next_action_, the round and step,
+	 * and the state of the world, logger and solver to
+	 * Globals::config.checkpoint_file.
+	 */
+	bool SaveCheckpoint(Solver* solver, World* world, Logger* logger);
+
+	/**
+	 * Resumes from Globals::config.checkpoint_file if it exists, and exits
+	 * with an error if it cannot be restored or was written in another
+	 * round.
+	 */
+	void RestoreCheckpoint(Solver* solver, World* world, Logger* logger);
 public:
 	Planner(string lower_bounds_str = "TRIVIAL",
 			string base_lower_bounds_str = "TRIVIAL", string upper_bounds_str =
@@ -28,6 +47,16 @@ public:
 	 */
 	virtual bool RunStep(Solver* solver, World* world, Logger* logger);
 
+	/**
+	 * Perform one step with the world executing the action on another thread,
+	 * while the solver searches from the beliefs after the most likely
+	 * observations (Globals::config.pipeline_branches of them). When the
+	 * received observation is one of them, its belief and search are used
+	 * instead of a belief update and the next search. The solver then
+	 * refines its search until the observation is received.
+	 */
+	virtual bool RunPipelinedStep(Solver* solver, World* world, Logger* logger);
+
 	/**
 	 * Run POMDP planning till terminal reached or time out
 	 */
@@ -54,6 +54,21 @@ enum OptionIndex {
 	E_SERVER,
 	E_PORT,
 	E_LOG,
+	E_TRACE,
+	E_TRACE_TRIALS,
+	E_TRIALS,
+	E_MAX_TREE_PARTICLES,
+	E_REPLAY_PARTICLES,
+	E_THREADS,
+	E_ROLLOUT_TOLERANCE,
+	E_BOUND_CACHE,
+	E_TRANSPOSITIONS,
+	E_ALPHA_VECTORS,
+	E_SHM_NAME,
+	E_PIPELINE,
+	E_REUSE_TREE,
+	E_CHECKPOINT,
+	E_TREE_EXPORT,
 };
 
 option::Descriptor* BuildUsage(string lower_bounds_str,
@@ -180,6 +195,14 @@ public:
 	World* InitializePOMDPWorld(std::string& world_type, DSPOMDP *model,
 			option::Option* options);
 
+	/**
+	 * Initialize a world executing actions in a plant in another process,
+	 * through shared memory (world type shm), or in a simulator of the model
+	 * forked as such a plant (world type shm-sim)
+	 */
+	World* InitializeSharedMemoryWorld(std::string& world_type, DSPOMDP *model,
+			option::Option* options);
+
 	/**
 	 * Initialize global parameters according command-line arguments
 	 */
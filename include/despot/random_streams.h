@@ -13,6 +13,9 @@ namespace despot {
  * entry is independently and identically drawn from [0, 1].
  */
 class RandomStreams {
+	friend class CheckpointWriter;
+	friend class CheckpointReader;
+
 private:
   std::vector<std::vector<double> > streams_; // streams_[i] is associated with i-th particle
 	mutable int position_;
@@ -39,6 +42,13 @@ public:
 	void Advance() const;
 	void Back() const;
 
+	/**
+	 * Drops the first entry of every sequence and appends a new random one,
+	 * so that entries move one position down, as seen from a search starting
+	 * one step later.
+	 */
+	void Shift();
+
 	void position(int value) const;
 	int position() const;
 
@@ -39,11 +39,8 @@ private:
 	static void Backup(VNode* vnode);
 	static void Update(VNode* vnode);
 	static void Update(QNode* qnode);
+	static void UpdateApproxError(VNode* vnode);
 	static VNode* FindMaxApproxErrorLeaf(VNode* root);
-	static void FindMaxApproxErrorLeaf(VNode* vnode, double likelihood,
-		double& bestAE, VNode*& bestNode);
-	static void FindMaxApproxErrorLeaf(QNode* qnode, double likelihood,
-		double& bestAE, VNode*& bestNode);
 
 	static ValuedAction OptimalAction(const VNode* vnode);
 	static double Likelihood(QNode* qnode);
@@ -7,6 +7,7 @@
 #include <despot/core/node.h>
 #include <despot/core/globals.h>
 #include <despot/core/history.h>
+#include <despot/core/transposition_table.h>
 #include <despot/random_streams.h>
 
 namespace despot {
@@ -21,6 +22,36 @@ protected:
 	ScenarioLowerBound* lower_bound_;
 	ScenarioUpperBound* upper_bound_;
 
+	// Observation branches of the action found by the last search, with the
+	// weights of their particles, most likely first
+	ACT_TYPE observations_action_;
+	std::vector<std::pair<OBS_TYPE, double> > observations_;
+
+	void RecordObservations(ACT_TYPE action);
+
+	/**
+	 * With Globals::config.reuse_tree, the subtrees below the action found by
+	 * a search are kept, rebased to start at depth 0 with the streams shifted
+	 * by one step, and refined while the action executes. The one of the
+	 * received observation becomes the root of the next search.
+	 */
+	struct RetainedSubtree {
+		OBS_TYPE obs;
+		double weight; // Probability of obs when retained
+		VNode* root;
+	};
+
+	RandomStreams* streams_; // Streams of the last search
+	ACT_TYPE retained_action_;
+	std::vector<RetainedSubtree> retained_;
+	VNode* reused_root_;
+	RandomStreams* restored_streams_; // Streams of a restored reused_root_
+
+	static bool ReusesTree();
+	void RetainSubtrees(ACT_TYPE action);
+	void DiscardSubtrees();
+	static void Rebase(VNode* vnode, double value_scale, double weight_scale);
+
 public:
 	DESPOT(const DSPOMDP* model, ScenarioLowerBound* lb, ScenarioUpperBound* ub, Belief* belief = NULL);
 	virtual ~DESPOT();
@@ -30,6 +61,20 @@ public:
 	void belief(Belief* b);
 	void BeliefUpdate(ACT_TYPE action, OBS_TYPE obs);
 
+	void PredictObservations(ACT_TYPE action,
+		std::vector<std::pair<OBS_TYPE, double> >& obss);
+	bool Speculate(ACT_TYPE action, OBS_TYPE obs, Speculation& speculation);
+	void Commit(Speculation& speculation);
+	bool Refine();
+
+	/**
+	 * Also saves the subtree kept for the next search and its streams. Meant
+	 * to be called between steps: subtrees retained by a search are only
+	 * saved once the belief update has picked one of them.
+	 */
+	bool Save(CheckpointWriter& writer) const;
+	bool Restore(CheckpointReader& reader);
+
 	ScenarioLowerBound* lower_bound() const;
 	ScenarioUpperBound* upper_bound() const;
 
@@ -38,11 +83,20 @@ public:
 		const DSPOMDP* model, History& history, double timeout,
 		SearchStatistics* statistics = NULL);
 
+	/**
+	 * Runs trials from root, which may already be expanded, until the timeout
+	 * or trial limit.
+	 */
+	static void GrowTree(VNode* root, RandomStreams& streams,
+		ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
+		const DSPOMDP* model, History& history, double timeout,
+		SearchStatistics* statistics = NULL);
+
 protected:
 	static VNode* Trial(VNode* root, RandomStreams& streams,
 		ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
 		const DSPOMDP* model, History& history, SearchStatistics* statistics =
-			NULL);
+			NULL, TranspositionTable* transpositions = NULL);
 	static void InitLowerBound(VNode* vnode, ScenarioLowerBound* lower_bound,
 		RandomStreams& streams, History& history);
 	static void InitUpperBound(VNode* vnode, ScenarioUpperBound* upper_bound,
@@ -50,10 +104,19 @@ protected:
 	static void InitBounds(VNode* vnode, ScenarioLowerBound* lower_bound,
 		ScenarioUpperBound* upper_bound, RandomStreams& streams, History& history);
 
-	static void Expand(VNode* vnode,
+	static int Expand(VNode* vnode,
 		ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
-		const DSPOMDP* model, RandomStreams& streams, History& history);
+		const DSPOMDP* model, RandomStreams& streams, History& history,
+		TranspositionTable* transpositions = NULL);
 	static void Backup(VNode* vnode);
+	static void BackupShared(VNode* vnode);
+	static int RecycleClosedSubtrees(VNode* vnode, const DSPOMDP* model);
+	static int CollapseSubtrees(VNode* vnode, const DSPOMDP* model,
+		bool keep_best_action);
+	static int Collapse(VNode* vnode, const DSPOMDP* model);
+	static int NumTreeParticles(VNode* vnode);
+	static std::vector<State*> ReplayParticles(VNode* vnode,
+		const DSPOMDP* model, const RandomStreams& streams);
 
 	static double Gap(VNode* vnode);
 
@@ -63,9 +126,10 @@ protected:
 
 	static void ExploitBlockers(VNode* vnode);
 	static VNode* FindBlocker(VNode* vnode);
-	static void Expand(QNode* qnode, ScenarioLowerBound* lower_bound,
+	static int Expand(QNode* qnode, ScenarioLowerBound* lower_bound,
 		ScenarioUpperBound* upper_bound, const DSPOMDP* model,
-		RandomStreams& streams, History& history);
+		RandomStreams& streams, History& history,
+		TranspositionTable* transpositions = NULL);
 	static void Update(VNode* vnode);
 	static void Update(QNode* qnode);
 	static VNode* Prune(VNode* vnode, ACT_TYPE& pruned_action, double& pruned_value);
@@ -4,6 +4,7 @@
 #include <despot/interface/pomdp.h>
 #include <despot/core/node.h>
 #include <despot/core/globals.h>
+#include <despot/util/random.h>
 
 namespace despot {
 
@@ -18,6 +19,7 @@ protected:
 	double exploration_constant_;
 	std::vector<int> preferred_actions_;
 	std::vector<int> legal_actions_;
+	Random* random_;
 
 public:
 	POMCPPrior(const DSPOMDP* model);
@@ -31,6 +33,18 @@ public:
 		return exploration_constant_;
 	}
 
+	/**
+	 * Random number generator used for rollouts and simulation steps; defaults
+	 * to Random::RANDOM. Each thread of a parallel POMCP uses its own.
+	 */
+	inline void random(Random* random) {
+		random_ = random;
+	}
+
+	inline Random& random() const {
+		return *random_;
+	}
+
 	inline virtual int SmartCount(ACT_TYPE action) const {
 		return 10;
 	}
@@ -83,27 +97,51 @@ public:
  * POMCP class
  * =============================================================================*/
 
+struct SimulationPool;
+
 class POMCP: public Solver {
 protected:
 	VNode* root_;
 	POMCPPrior* prior_;
 	bool reuse_;
 
+	// For parallel simulations, one prior and random number generator per thread
+	std::vector<POMCPPrior*> thread_priors_;
+	std::vector<Random> thread_randoms_;
+	SimulationPool* pool_; // Threads running them, started by the first search
+
+	int SimulateParallel(double timeout);
+
 public:
 	POMCP(const DSPOMDP* model, POMCPPrior* prior, Belief* belief = NULL);
+	virtual ~POMCP();
 	virtual ValuedAction Search();
 	virtual ValuedAction Search(double timeout);
 
 	void reuse(bool r);
+	/**
+	 * Run the simulations of each search on priors.size() threads sharing the
+	 * tree, one prior per thread since priors keep per-simulation state. The
+	 * priors must be of the same type as the main one.
+	 */
+	void thread_priors(const std::vector<POMCPPrior*>& priors);
 	virtual void belief(Belief* b);
 	virtual void BeliefUpdate(ACT_TYPE action, OBS_TYPE obs);
 
+	/**
+	 * Also saves the tree kept for the next search when reusing trees.
+	 */
+	virtual bool Save(CheckpointWriter& writer) const;
+	virtual bool Restore(CheckpointReader& reader);
+
 	static VNode* CreateVNode(int depth, const State*, POMCPPrior* prior,
 		const DSPOMDP* model);
 	static double Simulate(State* particle, VNode* root, const DSPOMDP* model,
 		POMCPPrior* prior);
 	static double Simulate(State* particle, RandomStreams& streams,
 		VNode* vnode, const DSPOMDP* model, POMCPPrior* prior);
+	static double ParallelSimulate(State* particle, VNode* vnode,
+		const DSPOMDP* model, POMCPPrior* prior);
 	static double Rollout(State* particle, int depth, const DSPOMDP* model,
 		POMCPPrior* prior);
 	static double Rollout(State* particle, RandomStreams& streams, int depth,
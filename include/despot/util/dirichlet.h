@@ -15,6 +15,14 @@ public:
 	std::vector<double> alpha();
 	std::vector<double> Next();
 	static std::vector<double> Next(std::vector<double> alpha);
+
+	/**
+	 * Draws count samples at once into samples, which is resized to
+	 * count * alpha.size(); sample i occupies entries
+	 * [i * alpha.size(), (i + 1) * alpha.size()).
+	 */
+	static void Next(const std::vector<double>& alpha, int count,
+		std::vector<double>& samples);
 };
 
 } // namespace despot
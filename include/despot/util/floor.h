@@ -2,6 +2,7 @@
 #define FLOOR_H
 
 #include <despot/util/coord.h>
+#include <stdint.h>
 #include <vector>
 
 namespace despot {
@@ -11,9 +12,10 @@ private:
 	int num_rows_, num_cols_;
 	int** floor_;
   std::vector<Coord> cells_;
-	std::vector<std::vector<double> > dist_;
+	std::vector<uint16_t> dist_; // Distance from c1 to c2 at c1 * NumCells() + c2
+	std::vector<int> neighbors_; // Cell in direction d of c at 4 * c + d, or INVALID
 
-	std::vector<double> ComputeDistances(int source);
+	static void* ComputeDistances(void* task);
 
 public:
 	static int INVALID;
@@ -34,8 +36,17 @@ public:
 	bool Inside(Coord coord) const;
 	bool Inside(int x, int y) const;
 
-	void ComputeDistances();
-	double Distance(int c1, int c2) const;
+	/**
+	 * Computes the distances between all pairs of cells with one breadth-first
+	 * search per source cell, the sources being split across num_threads
+	 * threads. Distances are stored in a contiguous matrix of 16-bit entries,
+	 * so the floor can have at most 65535 cells; unreachable cells are at
+	 * distance NumCells().
+	 */
+	void ComputeDistances(int num_threads = 1);
+	inline double Distance(int c1, int c2) const {
+		return dist_[c1 * cells_.size() + c2];
+	}
 
 	std::vector<int> ComputeShortestPath(int start, int end) const;
 
@@ -17,6 +17,14 @@ public:
 	double Next();
 
 	static double Next(double k, double theta);
+
+	/**
+	 * Draws count samples into values with the Marsaglia-Tsang method. The
+	 * candidates of a round are drawn and tested in separate straight loops
+	 * over arrays, and rejected ones are redrawn in the next round. Shapes
+	 * k < 1 are sampled as Gamma(k + 1) * U^(1 / k).
+	 */
+	static void Next(double k, double theta, int count, double* values);
 };
 
 } // namespace despot
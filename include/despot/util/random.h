@@ -16,7 +16,7 @@ public:
 	Random(double seed);
 	Random(unsigned seed);
 
-	unsigned seed();
+	unsigned seed() const;
 
 	unsigned NextUnsigned();
 	int NextInt(int n);
@@ -15,6 +15,13 @@ private:
 public:
 	static void root_seed(unsigned value);
 
+	/**
+	 * State of the seed generator, saved in checkpoints so that a restored
+	 * planner draws the seeds it would have drawn.
+	 */
+	static unsigned state();
+	static void state(unsigned value);
+
 	static unsigned Next();
 
 	static std::vector<unsigned> Next(int n);
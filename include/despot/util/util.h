@@ -10,6 +10,7 @@
 // #include <chrono>
 #include <locale>
 #include <sys/time.h>
+#include <inttypes.h>
 
 namespace despot {
 
@@ -114,6 +115,18 @@ inline double get_time_second() {
 }
 */
 
+/**
+ * Mixes value into the hash seed (splitmix64 finalizer), so that sequences
+ * of values can be hashed by chaining calls.
+ */
+inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+	uint64_t x = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6)
+		+ (seed >> 2));
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
 inline std::string lower(std::string str) {
   std::locale loc;
 	std::string copy = str;
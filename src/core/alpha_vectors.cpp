@@ -0,0 +1,336 @@
+#include <despot/core/alpha_vectors.h>
+#include <despot/core/particle_belief.h>
+#include <despot/util/util.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <typeinfo>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * AlphaVectors class
+ * =============================================================================*/
+
+static const char ALPHA_VECTORS_MAGIC[8] = { 'D', 'E', 'S', 'P', 'O', 'T', 'A',
+	'V' };
+// Length of the model class name stored in the file
+static const int MODEL_NAME_SIZE = 64;
+
+// Backs up the vectors of the states in [begin, end) from prev into cur
+struct BackupTask {
+	const MDP* model;
+	AlphaVectors::Type type;
+	const vector<double>* prev;
+	const vector<double>* prev_values; // max_a prev, for QMDP
+	vector<double>* cur;
+	int begin, end;
+	double residual; // Largest change of the task's entries
+	pthread_t thread;
+};
+
+AlphaVectors::AlphaVectors() :
+	num_states_(0),
+	num_actions_(0) {
+}
+
+void* AlphaVectors::BackupStates(void* arg) {
+	BackupTask* task = (BackupTask*) arg;
+	const MDP* model = task->model;
+	int num_actions = model->NumActions();
+	const double* prev = &(*task->prev)[0];
+	double* cur = &(*task->cur)[0];
+	double discount = Globals::Discount();
+
+	task->residual = 0;
+	for (int s = task->begin; s < task->end; s++) {
+		for (ACT_TYPE a = 0; a < num_actions; a++) {
+			const vector<State>& transition = model->TransitionProbability(s, a);
+			double next_value = 0;
+			for (int i = 0; i < transition.size(); i++) {
+				const State& next = transition[i];
+				next_value += next.weight * (task->type == QMDP ?
+					(*task->prev_values)[next.state_id] :
+					prev[next.state_id * num_actions + a]);
+			}
+
+			int entry = s * num_actions + a;
+			cur[entry] = model->Reward(s, a) + discount * next_value;
+			task->residual = max(task->residual, fabs(cur[entry] - prev[entry]));
+		}
+	}
+	return NULL;
+}
+
+void AlphaVectors::Compute(const MDP* model, Type type, int num_threads) {
+	num_states_ = model->NumStates();
+	num_actions_ = model->NumActions();
+	num_threads = max(1, min(num_threads, num_states_));
+
+	double min_reward = Globals::POS_INFTY, max_reward = Globals::NEG_INFTY;
+	for (int s = 0; s < num_states_; s++) {
+		for (ACT_TYPE a = 0; a < num_actions_; a++) {
+			double reward = model->Reward(s, a);
+			min_reward = min(min_reward, reward);
+			max_reward = max(max_reward, reward);
+		}
+	}
+
+	values_.assign(num_states_ * num_actions_,
+		(type == QMDP ? max_reward : min_reward) / (1 - Globals::Discount()));
+	vector<double> next(values_.size()), state_values(num_states_);
+
+	double start = get_time_second();
+	vector<BackupTask> tasks(num_threads);
+	for (int t = 0; t < num_threads; t++) {
+		tasks[t].model = model;
+		tasks[t].type = type;
+		tasks[t].prev = &values_;
+		tasks[t].prev_values = &state_values;
+		tasks[t].cur = &next;
+		tasks[t].begin = (long) num_states_ * t / num_threads;
+		tasks[t].end = (long) num_states_ * (t + 1) / num_threads;
+	}
+
+	int iter = 0;
+	double residual = 0;
+	for (iter = 0; iter < 1000; iter++) {
+		if (type == QMDP) {
+			for (int s = 0; s < num_states_; s++) {
+				double value = Globals::NEG_INFTY;
+				for (ACT_TYPE a = 0; a < num_actions_; a++)
+					value = max(value, Value(s, a));
+				state_values[s] = value;
+			}
+		}
+
+		if (num_threads == 1) {
+			BackupStates(&tasks[0]);
+		} else {
+			for (int t = 0; t < num_threads; t++)
+				pthread_create(&tasks[t].thread, NULL, BackupStates, &tasks[t]);
+			for (int t = 0; t < num_threads; t++)
+				pthread_join(tasks[t].thread, NULL);
+		}
+
+		values_.swap(next);
+		residual = 0;
+		for (int t = 0; t < num_threads; t++)
+			residual = max(residual, tasks[t].residual);
+
+		if (residual < 1e-4) {
+			iter++;
+			break;
+		}
+	}
+
+	logi << "[AlphaVectors::Compute] " << (type == QMDP ? "QMDP" : "Blind")
+		<< " vectors after " << iter << " iterations on " << num_threads
+		<< " threads: residual = " << residual << " ["
+		<< (get_time_second() - start) << "s]" << endl;
+}
+
+void AlphaVectors::LoadOrCompute(const MDP* model, Type type,
+	const string& file, int num_threads) {
+	if (file != "" && Load(file, model)) {
+		logi << "[AlphaVectors::LoadOrCompute] Loaded " << file << endl;
+		return;
+	}
+
+	Compute(model, type, num_threads);
+	if (file != "" && Save(file, model)) {
+		logi << "[AlphaVectors::LoadOrCompute] Saved " << file << endl;
+	}
+}
+
+static void ModelName(const MDP* model, char* name) {
+	memset(name, 0, MODEL_NAME_SIZE);
+	strncpy(name, typeid(*model).name(), MODEL_NAME_SIZE - 1);
+}
+
+uint64_t AlphaVectors::Fingerprint(const MDP* model) {
+	// FNV-1a over the rewards and transitions, which tells apart instances
+	// of one model class with the same numbers of states and actions, such
+	// as different maps, at the cost of one backup
+	uint64_t hash = 14695981039346656037ULL;
+	for (int s = 0; s < model->NumStates(); s++) {
+		for (ACT_TYPE a = 0; a < model->NumActions(); a++) {
+			const vector<State>& transition = model->TransitionProbability(s, a);
+			double reward = model->Reward(s, a);
+			vector<double> entries(1, reward);
+			for (int i = 0; i < transition.size(); i++) {
+				entries.push_back(transition[i].state_id);
+				entries.push_back(transition[i].weight);
+			}
+
+			const unsigned char* bytes = (const unsigned char*) &entries[0];
+			for (int i = 0; i < entries.size() * sizeof(double); i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		}
+	}
+	return hash;
+}
+
+/**
+ * File layout: the magic string "DESPOTAV", the class name of the model
+ * (MODEL_NAME_SIZE chars) and its fingerprint (uint64_t), the numbers of
+ * states and actions (int), the discount factor (double), then the vectors
+ * by state.
+ */
+bool AlphaVectors::Save(const string& file, const MDP* model) const {
+	FILE* out = fopen(file.c_str(), "wb");
+	if (out == NULL) {
+		loge << "[AlphaVectors::Save] Cannot open " << file << " for writing"
+			<< endl;
+		return false;
+	}
+
+	char name[MODEL_NAME_SIZE];
+	ModelName(model, name);
+	uint64_t fingerprint = Fingerprint(model);
+	double discount = Globals::Discount();
+	bool ok = fwrite(ALPHA_VECTORS_MAGIC, 1, 8, out) == 8
+		&& fwrite(name, 1, MODEL_NAME_SIZE, out) == MODEL_NAME_SIZE
+		&& fwrite(&fingerprint, sizeof(uint64_t), 1, out) == 1
+		&& fwrite(&num_states_, sizeof(int), 1, out) == 1
+		&& fwrite(&num_actions_, sizeof(int), 1, out) == 1
+		&& fwrite(&discount, sizeof(double), 1, out) == 1
+		&& fwrite(&values_[0], sizeof(double), values_.size(), out)
+			== values_.size();
+	ok = fclose(out) == 0 && ok;
+
+	if (!ok) {
+		loge << "[AlphaVectors::Save] Error writing " << file << endl;
+	}
+	return ok;
+}
+
+bool AlphaVectors::Load(const string& file, const MDP* model) {
+	FILE* in = fopen(file.c_str(), "rb");
+	if (in == NULL)
+		return false;
+
+	char magic[8], name[MODEL_NAME_SIZE], model_name[MODEL_NAME_SIZE];
+	ModelName(model, model_name);
+	uint64_t fingerprint;
+	int num_states, num_actions;
+	double discount;
+	bool ok = fread(magic, 1, 8, in) == 8
+		&& memcmp(magic, ALPHA_VECTORS_MAGIC, 8) == 0
+		&& fread(name, 1, MODEL_NAME_SIZE, in) == MODEL_NAME_SIZE
+		&& fread(&fingerprint, sizeof(uint64_t), 1, in) == 1
+		&& fread(&num_states, sizeof(int), 1, in) == 1
+		&& fread(&num_actions, sizeof(int), 1, in) == 1
+		&& fread(&discount, sizeof(double), 1, in) == 1
+		&& memcmp(name, model_name, MODEL_NAME_SIZE) == 0
+		&& num_states == model->NumStates()
+		&& num_actions == model->NumActions()
+		&& discount == Globals::Discount()
+		&& fingerprint == Fingerprint(model);
+
+	vector<double> values;
+	if (ok) {
+		values.resize((long) num_states * num_actions);
+		ok = fread(&values[0], sizeof(double), values.size(), in)
+			== values.size();
+	}
+	fclose(in);
+
+	if (!ok) {
+		logi << "[AlphaVectors::Load] " << file
+			<< " does not hold alpha vectors for this model and discount"
+			<< endl;
+		return false;
+	}
+
+	num_states_ = num_states;
+	num_actions_ = num_actions;
+	values_.swap(values);
+	return true;
+}
+
+int AlphaVectors::NumStates() const {
+	return num_states_;
+}
+
+int AlphaVectors::NumActions() const {
+	return num_actions_;
+}
+
+ValuedAction AlphaVectors::Value(const vector<State*>& particles,
+	const StateIndexer& indexer) const {
+	indexer.Gather(particles, indices_, weights_);
+	action_values_.assign(num_actions_, 0);
+
+	const double* alpha = &values_[0];
+	double* value = &action_values_[0];
+	for (int i = 0; i < indices_.size(); i++) {
+		const double* row = alpha + indices_[i] * num_actions_;
+		double weight = weights_[i];
+		for (ACT_TYPE a = 0; a < num_actions_; a++)
+			value[a] += weight * row[a];
+	}
+
+	ValuedAction best(0, value[0]);
+	for (ACT_TYPE a = 1; a < num_actions_; a++) {
+		if (value[a] > best.value)
+			best = ValuedAction(a, value[a]);
+	}
+	return best;
+}
+
+/* =============================================================================
+ * AlphaVectorUpperBound class
+ * =============================================================================*/
+
+AlphaVectorUpperBound::AlphaVectorUpperBound(const MDP* model,
+	const StateIndexer& indexer) :
+	indexer_(indexer) {
+	string file = Globals::config.alpha_vectors_file;
+	alpha_vectors_.LoadOrCompute(model, AlphaVectors::QMDP,
+		file == "" ? file : file + ".qmdp", Globals::config.num_threads);
+}
+
+double AlphaVectorUpperBound::Value(const State& state) const {
+	int s = indexer_.GetIndex(&state);
+	double value = Globals::NEG_INFTY;
+	for (ACT_TYPE a = 0; a < alpha_vectors_.NumActions(); a++)
+		value = max(value, alpha_vectors_.Value(s, a));
+	return value;
+}
+
+double AlphaVectorUpperBound::Value(const vector<State*>& particles,
+	RandomStreams& streams, History& history) const {
+	return alpha_vectors_.Value(particles, indexer_).value;
+}
+
+double AlphaVectorUpperBound::Value(const Belief* belief) const {
+	return alpha_vectors_.Value(
+		static_cast<const ParticleBelief*>(belief)->particles(), indexer_).value;
+}
+
+/* =============================================================================
+ * AlphaVectorLowerBound class
+ * =============================================================================*/
+
+AlphaVectorLowerBound::AlphaVectorLowerBound(const DSPOMDP* model,
+	const MDP* mdp, const StateIndexer& indexer) :
+	ParticleLowerBound(model),
+	indexer_(indexer) {
+	string file = Globals::config.alpha_vectors_file;
+	alpha_vectors_.LoadOrCompute(mdp, AlphaVectors::BLIND,
+		file == "" ? file : file + ".blind", Globals::config.num_threads);
+}
+
+ValuedAction AlphaVectorLowerBound::Value(
+	const vector<State*>& particles) const {
+	return alpha_vectors_.Value(particles, indexer_);
+}
+
+} // namespace despot
@@ -0,0 +1,231 @@
+#include <despot/core/bound_cache.h>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * BoundCache class
+ * =============================================================================*/
+
+BoundCache::BoundCache(const DSPOMDP* model, int size) :
+	model_(model),
+	lookups_(0),
+	hits_(0) {
+	int capacity = 1;
+	while (capacity < size)
+		capacity *= 2;
+
+	entries_.resize(capacity);
+	mask_ = capacity - 1;
+	for (int i = 0; i < entries_.size(); i++) {
+		entries_[i].key = 0;
+		entries_[i].has_lower = false;
+		entries_[i].has_upper = false;
+	}
+}
+
+BoundCache::~BoundCache() {
+	Clear();
+}
+
+uint64_t BoundCache::Key(const vector<State*>& particles,
+	const RandomStreams& streams) const {
+	uint64_t key = model_->Hash(particles, streams.position());
+	return key != 0 ? key : 1;
+}
+
+uint64_t BoundCache::Key(const vector<State*>& particles,
+	const RandomStreams& streams, const History& history) const {
+	uint64_t seed = HashCombine(streams.position(), history.Size());
+	for (int i = 0; i < history.Size(); i++) {
+		seed = HashCombine(seed, history.Action(i));
+		seed = HashCombine(seed, history.Observation(i));
+	}
+	uint64_t key = model_->Hash(particles, seed);
+	return key != 0 ? key : 1;
+}
+
+BoundCache::Entry& BoundCache::Slot(uint64_t key) {
+	return entries_[key & mask_];
+}
+
+bool BoundCache::Matches(const Entry& entry, uint64_t key,
+	const vector<State*>& particles) const {
+	return entry.key == key && model_->Equal(entry.particles, particles);
+}
+
+/**
+ * Returns the entry of the particles, replacing the one in their slot if it
+ * holds other particles.
+ */
+BoundCache::Entry& BoundCache::Claim(uint64_t key,
+	const vector<State*>& particles) {
+	Entry& entry = Slot(key);
+	if (Matches(entry, key, particles))
+		return entry;
+
+	for (int i = 0; i < entry.particles.size(); i++)
+		model_->Free(entry.particles[i]);
+	entry.particles.resize(particles.size());
+	for (int i = 0; i < particles.size(); i++)
+		entry.particles[i] = model_->Copy(particles[i]);
+	entry.key = key;
+	entry.has_lower = false;
+	entry.has_upper = false;
+	return entry;
+}
+
+bool BoundCache::FindLower(uint64_t key, const vector<State*>& particles,
+	ValuedAction& value) {
+	lookups_++;
+	Entry& entry = Slot(key);
+	if (!entry.has_lower || !Matches(entry, key, particles))
+		return false;
+
+	hits_++;
+	value = entry.lower;
+	return true;
+}
+
+void BoundCache::StoreLower(uint64_t key, const vector<State*>& particles,
+	const ValuedAction& value) {
+	Entry& entry = Claim(key, particles);
+	entry.has_lower = true;
+	entry.lower = value;
+}
+
+bool BoundCache::FindUpper(uint64_t key, const vector<State*>& particles,
+	double& value) {
+	lookups_++;
+	Entry& entry = Slot(key);
+	if (!entry.has_upper || !Matches(entry, key, particles))
+		return false;
+
+	hits_++;
+	value = entry.upper;
+	return true;
+}
+
+void BoundCache::StoreUpper(uint64_t key, const vector<State*>& particles,
+	double value) {
+	Entry& entry = Claim(key, particles);
+	entry.has_upper = true;
+	entry.upper = value;
+}
+
+void BoundCache::Clear() {
+	for (int i = 0; i < entries_.size(); i++) {
+		Entry& entry = entries_[i];
+		for (int j = 0; j < entry.particles.size(); j++)
+			model_->Free(entry.particles[j]);
+		entry.particles.clear();
+		entry.key = 0;
+		entry.has_lower = false;
+		entry.has_upper = false;
+	}
+}
+
+long BoundCache::lookups() const {
+	return lookups_;
+}
+
+long BoundCache::hits() const {
+	return hits_;
+}
+
+void BoundCache::ResetStatistics() {
+	lookups_ = 0;
+	hits_ = 0;
+}
+
+/* =============================================================================
+ * CachedScenarioLowerBound class
+ * =============================================================================*/
+
+CachedScenarioLowerBound::CachedScenarioLowerBound(ScenarioLowerBound* bound,
+	BoundCache* cache) :
+	ScenarioLowerBound(bound->model()),
+	bound_(bound),
+	cache_(cache) {
+}
+
+ScenarioLowerBound* CachedScenarioLowerBound::bound() const {
+	return bound_;
+}
+
+BoundCache* CachedScenarioLowerBound::cache() const {
+	return cache_;
+}
+
+void CachedScenarioLowerBound::Init(const RandomStreams& streams) {
+	bound_->Init(streams);
+	cache_->Clear();
+}
+
+void CachedScenarioLowerBound::Learn(VNode* tree) {
+	bound_->Learn(tree);
+}
+
+void CachedScenarioLowerBound::Reset() {
+	bound_->Reset();
+}
+
+bool CachedScenarioLowerBound::UsesHistory() const {
+	return bound_->UsesHistory();
+}
+
+ValuedAction CachedScenarioLowerBound::Value(const vector<State*>& particles,
+	RandomStreams& streams, History& history) const {
+	uint64_t key = bound_->UsesHistory() ?
+		cache_->Key(particles, streams, history) :
+		cache_->Key(particles, streams);
+	ValuedAction value;
+	if (!cache_->FindLower(key, particles, value)) {
+		value = bound_->Value(particles, streams, history);
+		cache_->StoreLower(key, particles, value);
+	}
+	return value;
+}
+
+/* =============================================================================
+ * CachedScenarioUpperBound class
+ * =============================================================================*/
+
+CachedScenarioUpperBound::CachedScenarioUpperBound(ScenarioUpperBound* bound,
+	BoundCache* cache) :
+	bound_(bound),
+	cache_(cache) {
+}
+
+ScenarioUpperBound* CachedScenarioUpperBound::bound() const {
+	return bound_;
+}
+
+BoundCache* CachedScenarioUpperBound::cache() const {
+	return cache_;
+}
+
+void CachedScenarioUpperBound::Init(const RandomStreams& streams) {
+	bound_->Init(streams);
+	cache_->Clear();
+}
+
+bool CachedScenarioUpperBound::UsesHistory() const {
+	return bound_->UsesHistory();
+}
+
+double CachedScenarioUpperBound::Value(const vector<State*>& particles,
+	RandomStreams& streams, History& history) const {
+	uint64_t key = bound_->UsesHistory() ?
+		cache_->Key(particles, streams, history) :
+		cache_->Key(particles, streams);
+	double value;
+	if (!cache_->FindUpper(key, particles, value)) {
+		value = bound_->Value(particles, streams, history);
+		cache_->StoreUpper(key, particles, value);
+	}
+	return value;
+}
+
+} // namespace despot
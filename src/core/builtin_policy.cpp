@@ -21,6 +21,10 @@ ACT_TYPE BlindPolicy::Action(const vector<State*>& particles, RandomStreams& str
 	return action_;
 }
 
+bool BlindPolicy::UsesHistory() const {
+	return false;
+}
+
 ValuedAction BlindPolicy::Search() {
 	double dummy_value = Globals::NEG_INFTY;
 	return ValuedAction(action_, dummy_value);
@@ -104,6 +108,10 @@ ACT_TYPE MajorityActionPolicy::Action(const vector<State*>& particles,
 	return bestAction;
 }
 
+bool MajorityActionPolicy::UsesHistory() const {
+	return false;
+}
+
 /* =============================================================================
  * ModeStatePolicy class
  * =============================================================================*/
@@ -140,6 +148,10 @@ ACT_TYPE ModeStatePolicy::Action(const vector<State*>& particles,
 	return policy_.GetAction(*mode);
 }
 
+bool ModeStatePolicy::UsesHistory() const {
+	return false;
+}
+
 /* =============================================================================
  * MMAPStatePolicy class
  * =============================================================================*/
@@ -157,4 +169,8 @@ ACT_TYPE MMAPStatePolicy::Action(const vector<State*>& particles,
 	return policy_.GetAction(*inferencer_.GetMMAP(particles));
 }
 
+bool MMAPStatePolicy::UsesHistory() const {
+	return false;
+}
+
 } // namespace despot
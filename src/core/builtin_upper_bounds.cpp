@@ -92,6 +92,10 @@ double LookaheadUpperBound::Value(const vector<State*>& particles,
 	return bound;
 }
 
+bool LookaheadUpperBound::UsesHistory() const {
+	return false;
+}
+
 
 /* =============================================================================
  * TrivialBeliefUpperBound
@@ -115,22 +119,37 @@ MDPUpperBound::MDPUpperBound(const MDP* model,
 	indexer_(indexer) {
 	const_cast<MDP*>(model_)->ComputeOptimalPolicyUsingVI();
 	policy_ = model_->policy();
+
+	values_.resize(policy_.size());
+	for (int s = 0; s < policy_.size(); s++)
+		values_[s] = policy_[s].value;
 }
 
 double MDPUpperBound::Value(const State& state) const {
-	return policy_[indexer_.GetIndex(&state)].value;
+	return values_[indexer_.GetIndex(&state)];
 }
 
-double MDPUpperBound::Value(const Belief* belief) const {
-	const vector<State*>& particles =
-		static_cast<const ParticleBelief*>(belief)->particles();
+/**
+ * Weighted sum of the values of the particles, gathered from values_ after
+ * extracting the state indices of all particles.
+ */
+double MDPUpperBound::Value(const vector<State*>& particles) const {
+	indexer_.Gather(particles, indices_, weights_);
 
+	const double* values = &values_[0];
 	double value = 0;
-	for (int i = 0; i < particles.size(); i++) {
-		State* particle = particles[i];
-		value += particle->weight * policy_[indexer_.GetIndex(particle)].value;
-	}
+	for (int i = 0; i < indices_.size(); i++)
+		value += weights_[i] * values[indices_[i]];
 	return value;
 }
 
+double MDPUpperBound::Value(const vector<State*>& particles,
+	RandomStreams& streams, History& history) const {
+	return Value(particles);
+}
+
+double MDPUpperBound::Value(const Belief* belief) const {
+	return Value(static_cast<const ParticleBelief*>(belief)->particles());
+}
+
 } // namespace despot
@@ -0,0 +1,409 @@
+#include <despot/core/checkpoint.h>
+#include <despot/core/node.h>
+#include <despot/interface/pomdp.h>
+#include <despot/random_streams.h>
+#include <despot/util/logging.h>
+
+#include <string.h>
+
+using namespace std;
+
+namespace despot {
+
+static const char CHECKPOINT_MAGIC[8] = { 'D', 'E', 'S', 'P', 'O', 'T', 'C',
+	'P' };
+
+/* =============================================================================
+ * CheckpointWriter class
+ * =============================================================================*/
+
+CheckpointWriter::CheckpointWriter(const DSPOMDP* model) :
+	model_(model),
+	out_(NULL),
+	ok_(false) {
+}
+
+CheckpointWriter::~CheckpointWriter() {
+	if (out_ != NULL) {
+		fclose(out_);
+		remove(temp_file_.c_str());
+	}
+}
+
+bool CheckpointWriter::Open(const string& file) {
+	file_ = file;
+	temp_file_ = file + ".tmp";
+	out_ = fopen(temp_file_.c_str(), "wb");
+	if (out_ == NULL) {
+		loge << "[CheckpointWriter::Open] Cannot open " << temp_file_
+			<< " for writing" << endl;
+		return ok_ = false;
+	}
+
+	ok_ = true;
+	Write(CHECKPOINT_MAGIC, 8);
+	return ok_;
+}
+
+bool CheckpointWriter::Close() {
+	if (out_ == NULL)
+		return false;
+
+	ok_ = fclose(out_) == 0 && ok_;
+	out_ = NULL;
+	if (ok_ && rename(temp_file_.c_str(), file_.c_str()) != 0)
+		ok_ = false;
+
+	if (!ok_) {
+		loge << "[CheckpointWriter::Close] Error writing " << file_ << endl;
+		remove(temp_file_.c_str());
+	}
+	return ok_;
+}
+
+bool CheckpointWriter::ok() const {
+	return ok_;
+}
+
+const DSPOMDP* CheckpointWriter::model() const {
+	return model_;
+}
+
+void CheckpointWriter::Write(const void* data, size_t size) {
+	if (ok_ && size > 0)
+		ok_ = fwrite(data, 1, size, out_) == size;
+}
+
+void CheckpointWriter::WriteString(const string& str) {
+	WriteValue((int) str.size());
+	Write(str.data(), str.size());
+}
+
+void CheckpointWriter::WriteHistory(const History& history) {
+	WriteValue((int) history.Size());
+	for (int t = 0; t < history.Size(); t++) {
+		WriteValue(history.Action(t));
+		WriteValue(history.Observation(t));
+	}
+}
+
+void CheckpointWriter::WriteStreams(const RandomStreams& streams) {
+	WriteValue(streams.NumStreams());
+	WriteValue(streams.Length());
+	WriteValue(streams.position());
+	for (int i = 0; i < streams.NumStreams() && streams.Length() > 0; i++)
+		Write(&streams.streams_[i][0], streams.Length() * sizeof(double));
+}
+
+void CheckpointWriter::WriteParticles(const vector<State*>& particles) {
+	WriteValue((int) particles.size());
+	for (int i = 0; i < particles.size() && ok_; i++) {
+		const State* particle = particles[i];
+		WriteValue(particle->scenario_id);
+		WriteValue(particle->weight);
+		WriteValue(particle->state_id);
+		model_->WriteState(*particle, *this);
+	}
+}
+
+void CheckpointWriter::WriteTree(VNode* root) {
+	// Preorder traversal with an explicit stack, as trees can be deep
+	vector<VNode*> stack(1, root);
+	while (!stack.empty() && ok_) {
+		VNode* vnode = stack.back();
+		stack.pop_back();
+
+		WriteValue(vnode->depth());
+		WriteValue(vnode->edge());
+		WriteValue((int) (vnode->parent() != NULL));
+		WriteValue(vnode->Weight());
+		WriteValue(vnode->lower_bound());
+		WriteValue(vnode->upper_bound());
+		WriteValue(vnode->utility_upper_bound);
+		WriteValue(vnode->default_move().action);
+		WriteValue(vnode->default_move().value);
+		WriteValue((int) vnode->recycled());
+		WriteValue((int) vnode->has_visits());
+		WriteValue(vnode->count());
+		WriteValue(vnode->value());
+		WriteParticles(vnode->particles());
+
+		vector<QNode*>& children = vnode->children();
+		WriteValue((int) children.size());
+		for (int a = 0; a < children.size(); a++) {
+			QNode* qnode = children[a];
+			WriteValue(qnode->edge());
+			WriteValue(qnode->lower_bound());
+			WriteValue(qnode->upper_bound());
+			WriteValue(qnode->utility_upper_bound);
+			WriteValue(qnode->step_reward);
+			WriteValue(qnode->default_value);
+			WriteValue((int) qnode->has_visits());
+			WriteValue(qnode->count());
+			WriteValue(qnode->value());
+
+			ObsChildren& obs_children = qnode->children();
+			WriteValue(obs_children.size());
+			for (ObsChildren::iterator it = obs_children.begin();
+				it != obs_children.end(); it++)
+				WriteValue(it->first);
+		}
+
+		// Children are pushed last to first, so that they are written in the
+		// order of their observations under their actions
+		for (int a = children.size() - 1; a >= 0; a--) {
+			ObsChildren& obs_children = children[a]->children();
+			for (int i = obs_children.size() - 1; i >= 0; i--)
+				stack.push_back((obs_children.begin() + i)->second);
+		}
+	}
+}
+
+/* =============================================================================
+ * CheckpointReader class
+ * =============================================================================*/
+
+CheckpointReader::CheckpointReader(const DSPOMDP* model) :
+	model_(model),
+	in_(NULL),
+	ok_(false) {
+}
+
+CheckpointReader::~CheckpointReader() {
+	Close();
+}
+
+bool CheckpointReader::Open(const string& file) {
+	Close();
+	in_ = fopen(file.c_str(), "rb");
+	if (in_ == NULL)
+		return ok_ = false;
+
+	ok_ = true;
+	char magic[8];
+	if (!Read(magic, 8) || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0) {
+		loge << "[CheckpointReader::Open] " << file << " is not a checkpoint"
+			<< endl;
+		Close();
+		return ok_ = false;
+	}
+	return true;
+}
+
+void CheckpointReader::Close() {
+	if (in_ != NULL)
+		fclose(in_);
+	in_ = NULL;
+}
+
+bool CheckpointReader::ok() const {
+	return ok_;
+}
+
+const DSPOMDP* CheckpointReader::model() const {
+	return model_;
+}
+
+bool CheckpointReader::Read(void* data, size_t size) {
+	if (ok_ && size > 0)
+		ok_ = fread(data, 1, size, in_) == size;
+	return ok_;
+}
+
+bool CheckpointReader::ReadString(string& str) {
+	int size;
+	if (!ReadValue(size) || size < 0)
+		return ok_ = false;
+
+	str.resize(size);
+	return size == 0 || Read(&str[0], size);
+}
+
+bool CheckpointReader::ReadHistory(History& history) {
+	int size;
+	if (!ReadValue(size) || size < 0)
+		return ok_ = false;
+
+	history.Truncate(0);
+	for (int t = 0; t < size; t++) {
+		ACT_TYPE action;
+		OBS_TYPE obs;
+		if (!ReadValue(action) || !ReadValue(obs))
+			return false;
+		history.Add(action, obs);
+	}
+	return true;
+}
+
+bool CheckpointReader::ReadStreams(RandomStreams& streams) {
+	int num_streams, length, position;
+	if (!ReadValue(num_streams) || !ReadValue(length) || !ReadValue(position)
+		|| num_streams < 0 || length < 0)
+		return ok_ = false;
+
+	vector<vector<double> > entries(num_streams, vector<double>(length));
+	for (int i = 0; i < num_streams && length > 0; i++) {
+		if (!Read(&entries[i][0], length * sizeof(double)))
+			return false;
+	}
+	streams.streams_.swap(entries);
+	streams.position(position);
+	return true;
+}
+
+bool CheckpointReader::ReadParticles(vector<State*>& particles) {
+	int size;
+	if (!ReadValue(size) || size < 0)
+		return ok_ = false;
+
+	for (int i = 0; i < size; i++) {
+		int scenario_id, state_id;
+		double weight;
+		if (!ReadValue(scenario_id) || !ReadValue(weight)
+			|| !ReadValue(state_id))
+			return false;
+
+		State* particle = model_->ReadState(*this);
+		if (particle == NULL || !ok_) {
+			if (particle != NULL)
+				model_->Free(particle);
+			return ok_ = false;
+		}
+		particle->scenario_id = scenario_id;
+		particle->weight = weight;
+		particle->state_id = state_id;
+		particles.push_back(particle);
+	}
+	return true;
+}
+
+// A belief node to be read, in the slot reserved for it under its parent
+struct PendingVNode {
+	QNode* parent; // NULL for the root
+	OBS_TYPE obs;
+};
+
+// Removes the slots of the children that were not read from a partial tree
+static void DropUnread(VNode* vnode) {
+	vector<QNode*>& children = vnode->children();
+	for (int a = 0; a < children.size(); a++) {
+		ObsChildren& obs_children = children[a]->children();
+		vector<OBS_TYPE> unread;
+		for (ObsChildren::iterator it = obs_children.begin();
+			it != obs_children.end(); it++) {
+			if (it->second == NULL)
+				unread.push_back(it->first);
+			else
+				DropUnread(it->second);
+		}
+		for (int i = 0; i < unread.size(); i++)
+			obs_children.erase(unread[i]);
+	}
+}
+
+VNode* CheckpointReader::ReadTree() {
+	VNode* root = NULL;
+	vector<PendingVNode> stack(1);
+	stack[0].parent = NULL;
+	stack[0].obs = -1;
+	while (!stack.empty()) {
+		PendingVNode pending = stack.back();
+		stack.pop_back();
+
+		int depth, has_parent, recycled, has_visits, count, num_children;
+		OBS_TYPE edge;
+		double weight, lower, upper, utility_upper, value;
+		ValuedAction default_move;
+		vector<State*> particles;
+		bool ok = ReadValue(depth) && ReadValue(edge) && ReadValue(has_parent)
+			&& ReadValue(weight) && ReadValue(lower) && ReadValue(upper)
+			&& ReadValue(utility_upper) && ReadValue(default_move.action)
+			&& ReadValue(default_move.value) && ReadValue(recycled)
+			&& ReadValue(has_visits)
+			&& ReadValue(count)
+			&& ReadValue(value) && ReadParticles(particles)
+			&& ReadValue(num_children) && num_children >= 0;
+		if (!ok) {
+			for (int i = 0; i < particles.size(); i++)
+				model_->Free(particles[i]);
+			break;
+		}
+
+		VNode* vnode = new VNode(particles, depth,
+			has_parent ? pending.parent : NULL, edge);
+		vnode->weight(weight);
+		vnode->lower_bound(lower);
+		vnode->upper_bound(upper);
+		vnode->utility_upper_bound = utility_upper;
+		vnode->default_move(default_move);
+		vnode->recycled(recycled != 0);
+		// Visit statistics are only allocated for the nodes that had them
+		if (has_visits) {
+			vnode->count(count);
+			vnode->value(value);
+		}
+		if (pending.parent != NULL)
+			pending.parent->children()[pending.obs] = vnode;
+		else
+			root = vnode;
+
+		vector<QNode*>& children = vnode->children();
+		vector<PendingVNode> pending_children;
+		for (int a = 0; a < num_children && ok; a++) {
+			int action, q_has_visits, q_count, num_obs;
+			double q_lower, q_upper, q_utility_upper, step_reward,
+				default_value, q_value;
+			ok = ReadValue(action) && ReadValue(q_lower) && ReadValue(q_upper)
+				&& ReadValue(q_utility_upper) && ReadValue(step_reward)
+				&& ReadValue(default_value) && ReadValue(q_has_visits)
+				&& ReadValue(q_count)
+				&& ReadValue(q_value) && ReadValue(num_obs) && num_obs >= 0;
+			if (!ok)
+				break;
+
+			QNode* qnode = new QNode(vnode, action);
+			qnode->lower_bound(q_lower);
+			qnode->upper_bound(q_upper);
+			qnode->utility_upper_bound = q_utility_upper;
+			qnode->step_reward = step_reward;
+			qnode->default_value = default_value;
+			if (q_has_visits) {
+				qnode->count(q_count);
+				qnode->value(q_value);
+			}
+			children.push_back(qnode);
+
+			ObsChildren& obs_children = qnode->children();
+			obs_children.reserve(num_obs);
+			for (int i = 0; i < num_obs && ok; i++) {
+				PendingVNode child;
+				child.parent = qnode;
+				ok = ReadValue(child.obs);
+				pending_children.push_back(child);
+			}
+		}
+		// The child slots are filled in as the children are read, so they
+		// are reserved now, in observation order
+		for (int i = 0; i < pending_children.size(); i++)
+			pending_children[i].parent->children()[pending_children[i].obs] =
+				NULL;
+		if (!ok)
+			break;
+		stack.insert(stack.end(), pending_children.rbegin(),
+			pending_children.rend());
+	}
+
+	if (!stack.empty() || !ok_) {
+		loge << "[CheckpointReader::ReadTree] Incomplete tree" << endl;
+		if (root != NULL) {
+			// Children that were not read are still NULL
+			DropUnread(root);
+			root->Free(*model_);
+			delete root;
+		}
+		return NULL;
+	}
+	return root;
+}
+
+} // namespace despot
@@ -112,23 +112,50 @@ void MDP::ComputeBlindAlpha() {
 
 		blind_alpha_[action] = cur;
 	}
+
+	blind_alpha_by_state_.resize(num_states * num_actions);
+	for (int s = 0; s < num_states; s++)
+		for (ACT_TYPE action = 0; action < num_actions; action++)
+			blind_alpha_by_state_[s * num_actions + action] =
+				blind_alpha_[action][s];
 }
 
 double MDP::ComputeActionValue(const ParticleBelief* belief,
 	const StateIndexer& indexer, ACT_TYPE action) const {
 	assert(blind_alpha_.size() != 0);
 
-	const vector<State*> particles = belief->particles();
+	indexer.Gather(belief->particles(), indices_, weights_);
+	const double* alpha = &blind_alpha_[action][0];
 	double value = 0;
-	for (int i = 0; i < particles.size(); i++) {
-		State* particle = particles[i];
-		value += particle->weight
-			* blind_alpha_[action][indexer.GetIndex(particle)];
-	}
+	for (int i = 0; i < indices_.size(); i++)
+		value += weights_[i] * alpha[indices_[i]];
 
 	return value;
 }
 
+/**
+ * Computes the values of the blind policies of all actions on a set of
+ * particles in one pass over them: each particle adds its weight times its
+ * row of blind_alpha_by_state_ to the values.
+ */
+void MDP::ComputeActionValues(const vector<State*>& particles,
+	const StateIndexer& indexer, vector<double>& values) const {
+	assert(blind_alpha_by_state_.size() != 0);
+
+	int num_actions = blind_alpha_.size();
+	values.assign(num_actions, 0);
+	indexer.Gather(particles, indices_, weights_);
+
+	const double* alpha = &blind_alpha_by_state_[0];
+	double* value = &values[0];
+	for (int i = 0; i < indices_.size(); i++) {
+		const double* row = alpha + indices_[i] * num_actions;
+		double weight = weights_[i];
+		for (ACT_TYPE action = 0; action < num_actions; action++)
+			value[action] += weight * row[action];
+	}
+}
+
 const vector<ValuedAction>& MDP::policy() const {
 	return policy_;
 }
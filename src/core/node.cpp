@@ -5,19 +5,88 @@ using namespace std;
 
 namespace despot {
 
+// Lock-free update of a running mean shared by several threads. The count
+// of the caller's own visit is taken atomically beforehand, so concurrent
+// updates only reorder the terms of the mean.
+static void AtomicMeanAdd(double* mean, int count, double val) {
+	union {
+		double value;
+		uint64_t bits;
+	} old_mean, new_mean;
+
+	do {
+		old_mean.value = *(volatile double*) mean;
+		new_mean.value = old_mean.value + (val - old_mean.value) / (count + 1);
+	} while (!__sync_bool_compare_and_swap((uint64_t*) mean, old_mean.bits,
+		new_mean.bits));
+}
+
+/* =============================================================================
+ * ObsChildren class
+ * =============================================================================*/
+
+ObsChildren::iterator ObsChildren::LowerBound(OBS_TYPE obs) {
+	// Children are mostly appended in increasing order, check the end first
+	if (entries_.empty() || entries_.back().first < obs)
+		return entries_.end();
+
+	int low = 0, high = entries_.size();
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (entries_[mid].first < obs)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return entries_.begin() + low;
+}
+
+ObsChildren::const_iterator ObsChildren::LowerBound(OBS_TYPE obs) const {
+	return const_cast<ObsChildren*>(this)->LowerBound(obs);
+}
+
+ObsChildren::iterator ObsChildren::find(OBS_TYPE obs) {
+	iterator it = LowerBound(obs);
+	return (it != entries_.end() && it->first == obs) ? it : entries_.end();
+}
+
+ObsChildren::const_iterator ObsChildren::find(OBS_TYPE obs) const {
+	const_iterator it = LowerBound(obs);
+	return (it != entries_.end() && it->first == obs) ? it : entries_.end();
+}
+
+int ObsChildren::count(OBS_TYPE obs) const {
+	return find(obs) != entries_.end();
+}
+
+void ObsChildren::erase(OBS_TYPE obs) {
+	iterator it = find(obs);
+	if (it != entries_.end())
+		entries_.erase(it);
+}
+
+VNode*& ObsChildren::operator[](OBS_TYPE obs) {
+	iterator it = LowerBound(obs);
+	if (it == entries_.end() || it->first != obs)
+		it = entries_.insert(it, value_type(obs, (VNode*) NULL));
+	return it->second;
+}
+
 /* =============================================================================
  * VNode class
  * =============================================================================*/
 
 VNode::VNode(vector<State*>& particles, int depth, QNode* parent,
 	OBS_TYPE edge) :
-	particles_(particles),
-	belief_(NULL),
+	weight_(State::Weight(particles)),
 	depth_(depth),
+	recycled_(false),
 	parent_(parent),
 	edge_(edge),
-	vstar(this),
-	likelihood(1) {
+	particles_(particles),
+	visits_(NULL),
+	aems_(NULL),
+	other_parents_(NULL) {
 	logd << "Constructed vnode with " << particles_.size() << " particles"
 		<< endl;
 	for (int i = 0; i < particles_.size(); i++) {
@@ -26,21 +95,29 @@ VNode::VNode(vector<State*>& particles, int depth, QNode* parent,
 }
 
 VNode::VNode(Belief* belief, int depth, QNode* parent, OBS_TYPE edge) :
-	belief_(belief),
+	weight_(0),
 	depth_(depth),
+	recycled_(false),
 	parent_(parent),
 	edge_(edge),
-	vstar(this),
-	likelihood(1) {
+	visits_(NULL),
+	aems_(new AEMSFields(belief, this)),
+	other_parents_(NULL) {
 }
 
 VNode::VNode(int count, double value, int depth, QNode* parent, OBS_TYPE edge) :
-	belief_(NULL),
+	lower_bound_(0),
+	upper_bound_(0),
+	weight_(0),
 	depth_(depth),
+	recycled_(false),
 	parent_(parent),
 	edge_(edge),
-	count_(count),
-	value_(value) {
+	visits_(new NodeVisits()),
+	aems_(NULL),
+	other_parents_(NULL) {
+	visits_->count = count;
+	visits_->value = value;
 }
 
 VNode::~VNode() {
@@ -51,18 +128,41 @@ VNode::~VNode() {
 	}
 	children_.clear();
 
-	if (belief_ != NULL)
-		delete belief_;
+	if (aems_ != NULL) {
+		delete aems_->belief;
+		delete aems_;
+	}
+	delete visits_;
+	delete other_parents_;
 }
 
 Belief* VNode::belief() const {
-	return belief_;
+	return aems_ != NULL ? aems_->belief : NULL;
 }
 
 const vector<State*>& VNode::particles() const {
 	return particles_;
 }
 
+/**
+ * Sets particles regenerated for a node whose particles were freed. They must
+ * be the same particles the node was created with.
+ */
+void VNode::particles(const vector<State*>& particles) {
+	assert(particles_.size() == 0);
+	particles_ = particles;
+}
+
+/**
+ * Frees the particles of the node while keeping their total weight.
+ */
+void VNode::FreeParticles(const DSPOMDP& model) {
+	for (int i = 0; i < particles_.size(); i++) {
+		model.Free(particles_[i]);
+	}
+	vector<State*>().swap(particles_);
+}
+
 void VNode::depth(int d) {
 	depth_ = d;
 }
@@ -71,6 +171,14 @@ int VNode::depth() const {
 	return depth_;
 }
 
+void VNode::recycled(bool r) {
+	recycled_ = r;
+}
+
+bool VNode::recycled() const {
+	return recycled_;
+}
+
 void VNode::parent(QNode* parent) {
 	parent_ = parent;
 }
@@ -83,8 +191,36 @@ OBS_TYPE VNode::edge() {
 	return edge_;
 }
 
+/**
+ * Shares the node with another parent. The node still belongs to parent(),
+ * which is the only parent deleting it and through which it is counted and
+ * freed.
+ */
+void VNode::AddParent(QNode* parent) {
+	if (other_parents_ == NULL)
+		other_parents_ = new vector<QNode*>();
+	other_parents_->push_back(parent);
+}
+
+const vector<QNode*>& VNode::other_parents() const {
+	static const vector<QNode*> none;
+	return other_parents_ != NULL ? *other_parents_ : none;
+}
+
+/**
+ * Returns whether the node belongs to qnode rather than being shared with it.
+ * Nodes without a parent (as in POMCP) belong to the node holding them.
+ */
+bool VNode::IsChildOf(const QNode* qnode) const {
+	return parent_ == qnode || parent_ == NULL;
+}
+
 double VNode::Weight() const {
-	return State::Weight(particles_);
+	return weight_;
+}
+
+void VNode::weight(double w) {
+	weight_ = w;
 }
 
 const vector<QNode*>& VNode::children() const {
@@ -152,22 +288,58 @@ bool VNode::IsLeaf() {
 	return children_.size() == 0;
 }
 
+NodeVisits& VNode::visits() {
+	if (visits_ == NULL)
+		visits_ = new NodeVisits();
+	return *visits_;
+}
+
 void VNode::Add(double val) {
-	value_ = (value_ * count_ + val) / (count_ + 1);
-	count_++;
+	NodeVisits& v = visits();
+	v.value = (v.value * v.count + val) / (v.count + 1);
+	v.count++;
 }
 
-void VNode::count(int c) {
-	count_ = c;
+void VNode::AtomicAdd(double val) {
+	NodeVisits& v = visits();
+	AtomicMeanAdd(&v.value, __sync_fetch_and_add(&v.count, 1), val);
 }
-int VNode::count() const {
-	return count_;
+
+void VNode::count(int c) {
+	visits().count = c;
 }
 void VNode::value(double v) {
-	value_ = v;
+	visits().value = v;
+}
+
+AEMSFields& VNode::aems() {
+	if (aems_ == NULL)
+		aems_ = new AEMSFields(NULL, this);
+	return *aems_;
+}
+
+double VNode::likelihood() const {
+	return aems_ != NULL ? aems_->likelihood : 1;
+}
+
+void VNode::likelihood(double l) {
+	aems().likelihood = l;
 }
-double VNode::value() const {
-	return value_;
+
+double VNode::approx_error() const {
+	return aems_ != NULL ? aems_->approx_error : 0;
+}
+
+void VNode::approx_error(double e) {
+	aems().approx_error = e;
+}
+
+VNode* VNode::approx_error_leaf() const {
+	return aems_ != NULL ? aems_->approx_error_leaf : const_cast<VNode*>(this);
+}
+
+void VNode::approx_error_leaf(VNode* leaf) {
+	aems().approx_error_leaf = leaf;
 }
 
 void VNode::Free(const DSPOMDP& model) {
@@ -177,10 +349,11 @@ void VNode::Free(const DSPOMDP& model) {
 
 	for (int a = 0; a < children().size(); a++) {
 		QNode* qnode = Child(a);
-		map<OBS_TYPE, VNode*>& children = qnode->children();
-		for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+		ObsChildren& children = qnode->children();
+		for (ObsChildren::iterator it = children.begin();
 			it != children.end(); it++) {
-			it->second->Free(model);
+			if (it->second->IsChildOf(qnode))
+				it->second->Free(model);
 		}
 	}
 }
@@ -205,8 +378,8 @@ void VNode::PrintPolicyTree(int depth, ostream& os) {
 		os << this << "-a=" << qstar->edge() << endl;
 
 		vector<OBS_TYPE> labels;
-		map<OBS_TYPE, VNode*>& vnodes = qstar->children();
-		for (map<OBS_TYPE, VNode*>::iterator it = vnodes.begin();
+		ObsChildren& vnodes = qstar->children();
+		for (ObsChildren::iterator it = vnodes.begin();
 			it != vnodes.end(); it++) {
 			labels.push_back(it->first);
 		}
@@ -245,8 +418,8 @@ void VNode::PrintTree(int depth, ostream& os) {
 		QNode* qnode = qnodes[a];
 
 		vector<OBS_TYPE> labels;
-		map<OBS_TYPE, VNode*>& vnodes = qnode->children();
-		for (map<OBS_TYPE, VNode*>::iterator it = vnodes.begin();
+		ObsChildren& vnodes = qnode->children();
+		for (ObsChildren::iterator it = vnodes.begin();
 			it != vnodes.end(); it++) {
 			labels.push_back(it->first);
 		}
@@ -274,21 +447,26 @@ void VNode::PrintTree(int depth, ostream& os) {
 QNode::QNode(VNode* parent, int edge) :
 	parent_(parent),
 	edge_(edge),
-	vstar(NULL) {
+	visits_(NULL) {
 }
 
 QNode::QNode(int count, double value) :
-	count_(count),
-	value_(value) {
+	lower_bound_(0),
+	upper_bound_(0),
+	visits_(new NodeVisits()) {
+	visits_->count = count;
+	visits_->value = value;
 }
 
 QNode::~QNode() {
-	for (map<OBS_TYPE, VNode*>::iterator it = children_.begin();
+	for (ObsChildren::iterator it = children_.begin();
 		it != children_.end(); it++) {
 		assert(it->second != NULL);
-		delete it->second;
+		if (it->second->IsChildOf(this))
+			delete it->second;
 	}
 	children_.clear();
+	delete visits_;
 }
 
 void QNode::parent(VNode* parent) {
@@ -303,7 +481,7 @@ int QNode::edge() {
 	return edge_;
 }
 
-map<OBS_TYPE, VNode*>& QNode::children() {
+ObsChildren& QNode::children() {
 	return children_;
 }
 
@@ -313,16 +491,17 @@ VNode* QNode::Child(OBS_TYPE obs) {
 
 int QNode::Size() const {
 	int size = 0;
-	for (map<OBS_TYPE, VNode*>::const_iterator it = children_.begin();
+	for (ObsChildren::const_iterator it = children_.begin();
 		it != children_.end(); it++) {
-		size += it->second->Size();
+		if (it->second->IsChildOf(this))
+			size += it->second->Size();
 	}
 	return size;
 }
 
 int QNode::PolicyTreeSize() const {
 	int size = 0;
-	for (map<OBS_TYPE, VNode*>::const_iterator it = children_.begin();
+	for (ObsChildren::const_iterator it = children_.begin();
 		it != children_.end(); it++) {
 		size += it->second->PolicyTreeSize();
 	}
@@ -331,7 +510,7 @@ int QNode::PolicyTreeSize() const {
 
 double QNode::Weight() const {
 	double weight = 0;
-	for (map<OBS_TYPE, VNode*>::const_iterator it = children_.begin();
+	for (ObsChildren::const_iterator it = children_.begin();
 		it != children_.end(); it++) {
 		weight += it->second->Weight();
 	}
@@ -354,25 +533,45 @@ double QNode::upper_bound() const {
 	return upper_bound_;
 }
 
+NodeVisits& QNode::visits() {
+	if (visits_ == NULL)
+		visits_ = new NodeVisits();
+	return *visits_;
+}
+
 void QNode::Add(double val) {
-	value_ = (value_ * count_ + val) / (count_ + 1);
-	count_++;
+	NodeVisits& v = visits();
+	v.value = (v.value * v.count + val) / (v.count + 1);
+	v.count++;
 }
 
-void QNode::count(int c) {
-	count_ = c;
+void QNode::AtomicAdd(double val) {
+	NodeVisits& v = visits();
+	AtomicMeanAdd(&v.value, __sync_fetch_and_add(&v.count, 1), val);
 }
 
-int QNode::count() const {
-	return count_;
+void QNode::count(int c) {
+	visits().count = c;
 }
 
 void QNode::value(double v) {
-	value_ = v;
+	visits().value = v;
+}
+
+void QNode::AddVirtualLoss(int n) {
+	__sync_fetch_and_add(&visits().virtual_loss, n);
+}
+
+void QNode::LockChildren() {
+	NodeVisits& v = visits();
+	while (__sync_lock_test_and_set(&v.children_lock, 1)) {
+		while (v.children_lock)
+			;
+	}
 }
 
-double QNode::value() const {
-	return value_;
+void QNode::UnlockChildren() {
+	__sync_lock_release(&visits().children_lock);
 }
 
 } // namespace despot
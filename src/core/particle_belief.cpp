@@ -185,6 +185,44 @@ Belief* ParticleBelief::MakeCopy() const {
 	return new ParticleBelief(copy, model_, prior_, split_);
 }
 
+/**
+ * The initial particles are saved as well, as they are resampled from when
+ * the particles are depleted. The prior belief is not saved.
+ */
+bool ParticleBelief::Save(CheckpointWriter& writer) const {
+	writer.WriteHistory(history_);
+	writer.WriteValue(num_particles_);
+	writer.WriteParticles(particles_);
+	writer.WriteParticles(initial_particles_);
+	return writer.ok();
+}
+
+bool ParticleBelief::Restore(CheckpointReader& reader) {
+	History history;
+	int num_particles;
+	vector<State*> particles, initial_particles;
+	if (!reader.ReadHistory(history) || !reader.ReadValue(num_particles)
+		|| !reader.ReadParticles(particles)
+		|| !reader.ReadParticles(initial_particles)) {
+		for (int i = 0; i < particles.size(); i++)
+			model_->Free(particles[i]);
+		for (int i = 0; i < initial_particles.size(); i++)
+			model_->Free(initial_particles[i]);
+		return false;
+	}
+
+	for (int i = 0; i < particles_.size(); i++)
+		model_->Free(particles_[i]);
+	for (int i = 0; i < initial_particles_.size(); i++)
+		model_->Free(initial_particles_[i]);
+
+	history_ = history;
+	num_particles_ = num_particles;
+	particles_.swap(particles);
+	initial_particles_.swap(initial_particles);
+	return true;
+}
+
 string ParticleBelief::text() const {
 	ostringstream oss;
 	map<string, double> pdf;
@@ -5,6 +5,7 @@
  *      Author: panpan
  */
 
+#include <despot/core/checkpoint.h>
 #include <despot/core/pomdp_world.h>
 
 namespace despot {
@@ -45,4 +46,28 @@ bool POMDPWorld::ExecuteAction(ACT_TYPE action, OBS_TYPE& obs) {
 	return terminal;
 }
 
+bool POMDPWorld::Save(CheckpointWriter& writer) const {
+	writer.WriteValue(random_.seed());
+	writer.WriteParticles(vector<State*>(1, state_));
+	return writer.ok();
+}
+
+bool POMDPWorld::Restore(CheckpointReader& reader) {
+	unsigned seed;
+	vector<State*> states;
+	if (!reader.ReadValue(seed) || !reader.ReadParticles(states))
+		return false;
+	if (states.size() != 1) {
+		for (int i = 0; i < states.size(); i++)
+			model_->Free(states[i]);
+		return false;
+	}
+
+	// The replaced start state is not freed, as models create it with new or
+	// from their memory pool, as for the states of earlier rounds
+	random_ = Random(seed);
+	state_ = states[0];
+	return true;
+}
+
 } /* namespace despot */
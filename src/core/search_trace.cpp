@@ -0,0 +1,116 @@
+#include <despot/core/search_trace.h>
+#include <despot/interface/pomdp.h>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * SearchTrace class
+ * =============================================================================*/
+
+FILE* SearchTrace::out_ = NULL;
+bool SearchTrace::trials_ = false;
+int SearchTrace::decision_ = 0;
+bool SearchTrace::speculative_ = false;
+
+// JSON has no representation for infinities, which SearchStatistics uses for
+// unset bounds, so they are written as null.
+static void WriteNumber(FILE* out, const char* key, double value) {
+	if (value != value || value == Globals::POS_INFTY
+		|| value == Globals::NEG_INFTY)
+		fprintf(out, ",\"%s\":null", key);
+	else
+		fprintf(out, ",\"%s\":%.9g", key, value);
+}
+
+static void WriteInt(FILE* out, const char* key, long value) {
+	fprintf(out, ",\"%s\":%ld", key, value);
+}
+
+bool SearchTrace::Open(const string& file, bool trials) {
+	Close();
+
+	out_ = fopen(file.c_str(), "w");
+	if (out_ == NULL) {
+		loge << "[SearchTrace::Open] Cannot open " << file << " for writing"
+			<< endl;
+		return false;
+	}
+
+	trials_ = trials;
+	decision_ = 0;
+	return true;
+}
+
+void SearchTrace::Close() {
+	if (out_ != NULL) {
+		fclose(out_);
+		out_ = NULL;
+	}
+}
+
+void SearchTrace::Trial(int trial, int depth, double duration,
+	int num_expansions, double lower, double upper) {
+	if (!trials_enabled())
+		return;
+
+	fprintf(out_, "{\"type\":\"trial\"");
+	WriteInt(out_, "decision", decision_);
+	WriteInt(out_, "trial", trial);
+	WriteInt(out_, "depth", depth);
+	WriteNumber(out_, "duration", duration);
+	WriteInt(out_, "expansions", num_expansions);
+	WriteNumber(out_, "lb", lower);
+	WriteNumber(out_, "ub", upper);
+	if (speculative_)
+		fputs(",\"speculative\":true", out_);
+	fputs("}\n", out_);
+}
+
+void SearchTrace::Decision(const char* solver, const ValuedAction& action,
+	const SearchStatistics& statistics, double real_time) {
+	if (!enabled())
+		return;
+
+	fprintf(out_, "{\"type\":\"decision\"");
+	WriteInt(out_, "decision", decision_);
+	fprintf(out_, ",\"solver\":\"%s\"", solver);
+	WriteInt(out_, "action", action.action);
+	WriteNumber(out_, "value", action.value);
+	WriteNumber(out_, "initial_lb", statistics.initial_lb);
+	WriteNumber(out_, "initial_ub", statistics.initial_ub);
+	WriteNumber(out_, "final_lb", statistics.final_lb);
+	WriteNumber(out_, "final_ub", statistics.final_ub);
+	WriteNumber(out_, "time_search", statistics.time_search);
+	WriteNumber(out_, "time_path", statistics.time_path);
+	WriteNumber(out_, "time_backup", statistics.time_backup);
+	WriteNumber(out_, "time_node_expansion", statistics.time_node_expansion);
+	WriteNumber(out_, "time_real", real_time);
+	WriteInt(out_, "num_policy_nodes", statistics.num_policy_nodes);
+	WriteInt(out_, "num_tree_nodes", statistics.num_tree_nodes);
+	WriteInt(out_, "num_expanded_nodes", statistics.num_expanded_nodes);
+	WriteInt(out_, "num_tree_particles", statistics.num_tree_particles);
+	WriteInt(out_, "num_particles_before_search",
+		statistics.num_particles_before_search);
+	WriteInt(out_, "num_particles_after_search",
+		statistics.num_particles_after_search);
+	WriteInt(out_, "num_trials", statistics.num_trials);
+	WriteInt(out_, "longest_trial_length", statistics.longest_trial_length);
+	WriteInt(out_, "peak_tree_nodes", statistics.peak_tree_nodes);
+	WriteInt(out_, "peak_tree_particles", statistics.peak_tree_particles);
+	WriteInt(out_, "num_recycled_nodes", statistics.num_recycled_nodes);
+	WriteInt(out_, "num_bound_cache_lookups",
+		statistics.num_bound_cache_lookups);
+	WriteInt(out_, "num_bound_cache_hits", statistics.num_bound_cache_hits);
+	WriteInt(out_, "num_merged_nodes", statistics.num_merged_nodes);
+	if (speculative_)
+		fputs(",\"speculative\":true", out_);
+	fputs("}\n", out_);
+
+	// Flush per decision so that a killed process still leaves a usable trace
+	fflush(out_);
+	decision_++;
+}
+
+} // namespace despot
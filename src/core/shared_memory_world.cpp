@@ -0,0 +1,385 @@
+#include <despot/core/shared_memory_world.h>
+#include <despot/util/logging.h>
+#include <despot/util/util.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * SharedMemoryChannel class
+ * =============================================================================*/
+
+static const char SHARED_MEMORY_MAGIC[8] = { 'D', 'E', 'S', 'P', 'O', 'T', 'S',
+	'M' };
+static const int CACHE_LINE = 64;
+static const uint32_t RING_SIZE = 64;
+// Failed tries before a waiting side starts yielding the processor
+static const int SPIN_TRIES = 1000;
+
+typedef SharedMemoryChannel::Message Message;
+
+/**
+ * Single-producer single-consumer ring. The indices count messages since the
+ * segment was created and sit on their own cache lines; head is only written
+ * by the producer and tail by the consumer, each after the slot it covers.
+ */
+struct Ring {
+	volatile uint32_t head;
+	char head_pad[CACHE_LINE - sizeof(uint32_t)];
+	volatile uint32_t tail;
+	char tail_pad[CACHE_LINE - sizeof(uint32_t)];
+	Message slots[RING_SIZE];
+};
+
+struct SharedMemoryChannel::Layout {
+	char magic[8];
+	volatile uint32_t ready; // Set by the plant once the segment is initialized
+	char pad[CACHE_LINE - 8 - sizeof(uint32_t)];
+	Ring requests; // Planner to plant
+	Ring replies; // Plant to planner
+};
+
+static bool Push(Ring& ring, const Message& message) {
+	uint32_t head = ring.head;
+	if (head - ring.tail == RING_SIZE)
+		return false;
+
+	ring.slots[head % RING_SIZE] = message;
+	__sync_synchronize();
+	ring.head = head + 1;
+	return true;
+}
+
+static bool Pop(Ring& ring, Message& message) {
+	uint32_t tail = ring.tail;
+	if (ring.head == tail)
+		return false;
+
+	__sync_synchronize();
+	message = ring.slots[tail % RING_SIZE];
+	__sync_synchronize();
+	ring.tail = tail + 1;
+	return true;
+}
+
+/**
+ * Called after the given number of failed tries: spins for the first ones,
+ * then yields the processor, and returns false once timeout seconds (if not
+ * negative) have passed since the first yield.
+ */
+static bool Backoff(int tries, double& start, double timeout) {
+	if (tries < SPIN_TRIES)
+		return true;
+
+	if (timeout >= 0) {
+		double now = get_time_second();
+		if (start < 0)
+			start = now;
+		else if (now - start > timeout)
+			return false;
+	}
+	sched_yield();
+	return true;
+}
+
+static bool Send(Ring& ring, const Message& message, double timeout) {
+	double start = -1;
+	for (int tries = 0; !Push(ring, message); tries++) {
+		if (!Backoff(tries, start, timeout))
+			return false;
+	}
+	return true;
+}
+
+static bool Receive(Ring& ring, Message& message, double timeout) {
+	double start = -1;
+	for (int tries = 0; !Pop(ring, message); tries++) {
+		if (!Backoff(tries, start, timeout))
+			return false;
+	}
+	return true;
+}
+
+SharedMemoryChannel::SharedMemoryChannel() :
+	layout_(NULL),
+	owner_(false) {
+}
+
+SharedMemoryChannel::~SharedMemoryChannel() {
+	Close();
+}
+
+bool SharedMemoryChannel::Map(int fd) {
+	void* address = mmap(NULL, sizeof(Layout), PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+		return false;
+
+	layout_ = (Layout*) address;
+	return true;
+}
+
+bool SharedMemoryChannel::Create(const string& name) {
+	Close();
+
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 || ftruncate(fd, sizeof(Layout)) != 0 || !Map(fd)) {
+		loge << "[SharedMemoryChannel::Create] Cannot create " << name << ": "
+			<< strerror(errno) << endl;
+		if (fd >= 0)
+			shm_unlink(name.c_str());
+		return false;
+	}
+
+	// The segment is zero-filled, so both rings start empty
+	name_ = name;
+	owner_ = true;
+	memcpy(layout_->magic, SHARED_MEMORY_MAGIC, 8);
+	__sync_synchronize();
+	layout_->ready = 1;
+	return true;
+}
+
+bool SharedMemoryChannel::Open(const string& name, double timeout) {
+	Close();
+
+	double start = get_time_second();
+	while (true) {
+		if (layout_ == NULL) {
+			int fd = shm_open(name.c_str(), O_RDWR, 0);
+			struct stat st;
+			if (fd >= 0) {
+				// The plant may not have sized the segment yet
+				if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(Layout))
+					Map(fd);
+				else
+					close(fd);
+			}
+		}
+
+		if (layout_ != NULL && layout_->ready) {
+			__sync_synchronize();
+			if (memcmp(layout_->magic, SHARED_MEMORY_MAGIC, 8) != 0) {
+				loge << "[SharedMemoryChannel::Open] " << name
+					<< " is not a DESPOT shared memory segment" << endl;
+				Close();
+				return false;
+			}
+			name_ = name;
+			return true;
+		}
+
+		if (timeout >= 0 && get_time_second() - start > timeout) {
+			Close();
+			return false;
+		}
+		usleep(1000);
+	}
+}
+
+void SharedMemoryChannel::Close() {
+	if (layout_ == NULL)
+		return;
+
+	munmap(layout_, sizeof(Layout));
+	if (owner_)
+		shm_unlink(name_.c_str());
+	layout_ = NULL;
+	owner_ = false;
+	name_ = "";
+}
+
+bool SharedMemoryChannel::IsOpen() const {
+	return layout_ != NULL;
+}
+
+const string& SharedMemoryChannel::name() const {
+	return name_;
+}
+
+bool SharedMemoryChannel::SendRequest(const Message& message, double timeout) {
+	return Send(layout_->requests, message, timeout);
+}
+
+bool SharedMemoryChannel::ReceiveRequest(Message& message, double timeout) {
+	return Receive(layout_->requests, message, timeout);
+}
+
+bool SharedMemoryChannel::SendReply(const Message& message, double timeout) {
+	return Send(layout_->replies, message, timeout);
+}
+
+bool SharedMemoryChannel::ReceiveReply(Message& message, double timeout) {
+	return Receive(layout_->replies, message, timeout);
+}
+
+/* =============================================================================
+ * SharedMemoryWorld class
+ * =============================================================================*/
+
+SharedMemoryWorld::SharedMemoryWorld(const DSPOMDP* model, const string& name,
+	double timeout) :
+	model_(model),
+	name_(name),
+	timeout_(timeout),
+	step_reward_(0) {
+}
+
+SharedMemoryWorld::~SharedMemoryWorld() {
+	if (channel_.IsOpen()) {
+		Message message = { SharedMemoryChannel::CLOSE, 0, 0, 0, 0 };
+		channel_.SendRequest(message, 0);
+	}
+}
+
+bool SharedMemoryWorld::Connect() {
+	if (!channel_.Open(name_, timeout_)) {
+		loge << "[SharedMemoryWorld::Connect] No plant serving " << name_
+			<< endl;
+		return false;
+	}
+	logi << "[SharedMemoryWorld::Connect] Connected to " << name_ << endl;
+	return true;
+}
+
+bool SharedMemoryWorld::Request(Message& message) {
+	int type = message.type;
+	if (!channel_.SendRequest(message, timeout_)
+		|| !channel_.ReceiveReply(message, timeout_)) {
+		loge << "[SharedMemoryWorld::Request] No reply from the plant at "
+			<< name_ << endl;
+		return false;
+	}
+	if (message.type != type) {
+		loge << "[SharedMemoryWorld::Request] Reply of type " << message.type
+			<< " to a request of type " << type << endl;
+		return false;
+	}
+	return true;
+}
+
+State* SharedMemoryWorld::Initialize() {
+	Message message = { SharedMemoryChannel::RESET, 0, 0, 0, 0 };
+	Request(message);
+	return NULL;
+}
+
+State* SharedMemoryWorld::GetCurrentState() const {
+	return NULL;
+}
+
+void SharedMemoryWorld::PrintState(const State& s, ostream& out) const {
+	model_->PrintState(s, out);
+}
+
+bool SharedMemoryWorld::ExecuteAction(ACT_TYPE action, OBS_TYPE& obs) {
+	if (action >= model_->NumActions()) {
+		cout << "WARNING: Planned action " << action <<
+			" set to maximum allowed value " << (model_->NumActions() - 1) << endl;
+		action = model_->NumActions() - 1;
+	}
+
+	Message message = { SharedMemoryChannel::STEP, action, 0, 0, 0 };
+	if (!Request(message)) {
+		// Without a plant, the round cannot go on
+		obs = 0;
+		step_reward_ = 0;
+		return true;
+	}
+	obs = message.obs;
+	step_reward_ = message.reward;
+	return message.terminal;
+}
+
+/* =============================================================================
+ * SharedMemorySimulator class
+ * =============================================================================*/
+
+SharedMemorySimulator::SharedMemorySimulator(const DSPOMDP* model,
+	unsigned seed) :
+	model_(model),
+	random_(seed),
+	state_(NULL),
+	parent_(0),
+	child_(0) {
+}
+
+SharedMemorySimulator::~SharedMemorySimulator() {
+	if (child_ > 0) {
+		// A child stopped before the planner closed the connection leaves its
+		// segment behind
+		kill(child_, SIGTERM);
+		waitpid(child_, NULL, 0);
+		shm_unlink(child_name_.c_str());
+	}
+}
+
+void SharedMemorySimulator::Serve(const string& name) {
+	if (!channel_.Create(name))
+		return;
+	logi << "[SharedMemorySimulator::Serve] Serving " << name << endl;
+
+	Message request;
+	while (true) {
+		if (!channel_.ReceiveRequest(request, 0.5)) {
+			if (parent_ != 0 && getppid() != parent_)
+				break;
+			continue;
+		}
+		if (request.type == SharedMemoryChannel::CLOSE)
+			break;
+
+		Message reply = request;
+		reply.terminal = 0;
+		// As in POMDPWorld, start states are not freed: models may create
+		// them outside of their memory pools
+		if (request.type == SharedMemoryChannel::RESET || state_ == NULL)
+			state_ = model_->CreateStartState();
+		if (request.type == SharedMemoryChannel::STEP) {
+			reply.terminal = model_->Step(*state_, random_.NextDouble(),
+				request.action, reply.reward, reply.obs);
+		}
+		channel_.SendReply(reply, -1);
+	}
+
+	logi << "[SharedMemorySimulator::Serve] Closed " << name << endl;
+	channel_.Close();
+}
+
+bool SharedMemorySimulator::Fork(const string& name) {
+	pid_t parent = getpid();
+	cout.flush();
+	pid_t pid = fork();
+	if (pid < 0) {
+		loge << "[SharedMemorySimulator::Fork] Cannot fork: " << strerror(errno)
+			<< endl;
+		return false;
+	}
+
+	if (pid == 0) {
+		// Static destructors and exit handlers belong to the parent
+		parent_ = parent;
+		Serve(name);
+		cout.flush();
+		_exit(0);
+	}
+
+	child_ = pid;
+	child_name_ = name;
+	return true;
+}
+
+} // namespace despot
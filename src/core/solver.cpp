@@ -3,6 +3,8 @@
 #include <despot/interface/pomdp.h>
 #include <despot/interface/belief.h>
 
+#include <map>
+
 using namespace std;
 
 namespace despot {
@@ -27,7 +29,13 @@ SearchStatistics::SearchStatistics() :
 	num_particles_before_search(0),
 	num_particles_after_search(0),
 	num_trials(0),
-	longest_trial_length(0) {
+	longest_trial_length(0),
+	peak_tree_nodes(0),
+	peak_tree_particles(0),
+	num_recycled_nodes(0),
+	num_bound_cache_lookups(0),
+	num_bound_cache_hits(0),
+	num_merged_nodes(0) {
 }
 
 ostream& operator<<(ostream& os, const SearchStatistics& statistics) {
@@ -47,7 +55,18 @@ ostream& operator<<(ostream& os, const SearchStatistics& statistics) {
 	os << "# particles: initial / final / tree = "
 		<< statistics.num_particles_before_search << " / "
 		<< statistics.num_particles_after_search << " / "
-		<< statistics.num_tree_particles; // << endl;
+		<< statistics.num_tree_particles << endl;
+	os << "Peak tree: nodes / particles / recycled nodes = "
+		<< statistics.peak_tree_nodes << " / "
+		<< statistics.peak_tree_particles << " / "
+		<< statistics.num_recycled_nodes;
+	if (statistics.num_bound_cache_lookups > 0)
+		os << endl << "Bound cache: hits / lookups = "
+			<< statistics.num_bound_cache_hits << " / "
+			<< statistics.num_bound_cache_lookups;
+	if (statistics.num_merged_nodes > 0)
+		os << endl << "Transpositions: shared nodes = "
+			<< statistics.num_merged_nodes;
 	return os;
 }
 
@@ -55,6 +74,8 @@ ostream& operator<<(ostream& os, const SearchStatistics& statistics) {
  * Solver class
  * =============================================================================*/
 
+const volatile int* Solver::interrupt_ = NULL;
+
 Solver::Solver(const DSPOMDP* model, Belief* belief) :
 	model_(model),
 	belief_(belief),
@@ -84,4 +105,75 @@ Belief* Solver::belief() {
 	return belief_;
 }
 
+static bool MoreLikely(const pair<OBS_TYPE, double>& a,
+	const pair<OBS_TYPE, double>& b) {
+	return a.second > b.second;
+}
+
+void Solver::SortObservations(vector<pair<OBS_TYPE, double> >& obss) {
+	stable_sort(obss.begin(), obss.end(), MoreLikely);
+}
+
+void Solver::PredictObservations(ACT_TYPE action,
+	vector<pair<OBS_TYPE, double> >& obss) {
+	vector<State*> particles = belief_->Sample(Globals::config.num_scenarios);
+	map<OBS_TYPE, double> probs;
+	// A generator of its own, seeded by the step, leaves Random::RANDOM to
+	// the searches and is not shared with the world executing the action
+	Random random((unsigned) history_.Size());
+	for (int i = 0; i < particles.size(); i++) {
+		State* particle = particles[i];
+		double reward;
+		OBS_TYPE obs;
+		model_->Step(*particle, random.NextDouble(), action, reward, obs);
+		probs[obs] += particle->weight;
+		model_->Free(particle);
+	}
+
+	obss.assign(probs.begin(), probs.end());
+	SortObservations(obss);
+}
+
+bool Solver::Speculate(ACT_TYPE action, OBS_TYPE obs,
+	Speculation& speculation) {
+	return false;
+}
+
+void Solver::Commit(Speculation& speculation) {
+	delete belief_;
+	belief_ = speculation.belief;
+	speculation.belief = NULL;
+	history_.Add(speculation.action, speculation.obs);
+
+	logi << "[Solver::Commit] Updated belief and history with action "
+		<< speculation.action << ", observation " << speculation.obs
+		<< " from a speculative search" << endl;
+}
+
+bool Solver::Refine() {
+	return false;
+}
+
+void Solver::interrupt(const volatile int* flag) {
+	interrupt_ = flag;
+}
+
+bool Solver::interrupted() {
+	return interrupt_ != NULL && *interrupt_;
+}
+
+bool Solver::Save(CheckpointWriter& writer) const {
+	writer.WriteHistory(history_);
+	return writer.ok() && belief_->Save(writer);
+}
+
+bool Solver::Restore(CheckpointReader& reader) {
+	History history;
+	if (!reader.ReadHistory(history) || !belief_->Restore(reader))
+		return false;
+
+	history_ = history;
+	return true;
+}
+
 } // namespace despot
@@ -0,0 +1,56 @@
+#include <despot/core/transposition_table.h>
+#include <despot/core/node.h>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * TranspositionTable class
+ * =============================================================================*/
+
+TranspositionTable::TranspositionTable(const DSPOMDP* model) :
+	model_(model),
+	num_merged_(0) {
+}
+
+uint64_t TranspositionTable::Key(const vector<State*>& particles,
+	int depth) const {
+	return model_->Hash(particles, depth);
+}
+
+VNode* TranspositionTable::Find(uint64_t key,
+	const vector<State*>& particles) {
+	map<uint64_t, VNode*>::iterator it = nodes_.find(key);
+	if (it == nodes_.end())
+		return NULL;
+
+	// Nodes whose particles were freed cannot be compared, so they are never
+	// shared
+	VNode* vnode = it->second;
+	const vector<State*>& existing = vnode->particles();
+	if (existing.empty() || !model_->Equal(existing, particles))
+		return NULL;
+
+	num_merged_++;
+	return vnode;
+}
+
+void TranspositionTable::Insert(uint64_t key, VNode* vnode) {
+	nodes_[key] = vnode;
+}
+
+void TranspositionTable::Clear() {
+	nodes_.clear();
+	num_merged_ = 0;
+}
+
+int TranspositionTable::size() const {
+	return nodes_.size();
+}
+
+int TranspositionTable::num_merged() const {
+	return num_merged_;
+}
+
+} // namespace despot
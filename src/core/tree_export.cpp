@@ -0,0 +1,202 @@
+#include <despot/core/tree_export.h>
+#include <despot/core/node.h>
+#include <despot/util/logging.h>
+#include <despot/util/util.h>
+
+#include <string.h>
+
+using namespace std;
+
+namespace despot {
+
+/* =============================================================================
+ * TreeExport class
+ * =============================================================================*/
+
+static const char TREE_EXPORT_MAGIC[8] = { 'D', 'E', 'S', 'P', 'O', 'T', 'T',
+	'E' };
+// Snapshots waiting for the writer beyond which new ones are dropped
+static const int MAX_PENDING = 4;
+
+struct TreeExport::Snapshot {
+	TreeExportHeader header;
+	vector<TreeExportNode> nodes;
+};
+
+FILE* TreeExport::out_ = NULL;
+int TreeExport::decision_ = 0;
+int TreeExport::num_dropped_ = 0;
+bool TreeExport::closing_ = false;
+pthread_t TreeExport::writer_;
+pthread_mutex_t TreeExport::mutex_ = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t TreeExport::pending_cond_ = PTHREAD_COND_INITIALIZER;
+deque<TreeExport::Snapshot*> TreeExport::pending_;
+TreeExport::Snapshot* TreeExport::spare_ = NULL;
+
+bool TreeExport::Open(const string& file) {
+	Close();
+
+	out_ = fopen(file.c_str(), "wb");
+	if (out_ == NULL || fwrite(TREE_EXPORT_MAGIC, 1, 8, out_) != 8) {
+		loge << "[TreeExport::Open] Cannot open " << file << " for writing"
+			<< endl;
+		if (out_ != NULL)
+			fclose(out_);
+		out_ = NULL;
+		return false;
+	}
+
+	decision_ = 0;
+	num_dropped_ = 0;
+	closing_ = false;
+	pthread_create(&writer_, NULL, Write, NULL);
+	return true;
+}
+
+void TreeExport::Close() {
+	if (out_ == NULL)
+		return;
+
+	pthread_mutex_lock(&mutex_);
+	closing_ = true;
+	pthread_cond_signal(&pending_cond_);
+	pthread_mutex_unlock(&mutex_);
+	pthread_join(writer_, NULL);
+
+	if (num_dropped_ > 0) {
+		logw << "[TreeExport::Close] " << num_dropped_
+			<< " trees were dropped as the writer fell behind" << endl;
+	}
+	delete spare_;
+	spare_ = NULL;
+	fclose(out_);
+	out_ = NULL;
+}
+
+void* TreeExport::Write(void* arg) {
+	pthread_mutex_lock(&mutex_);
+	while (true) {
+		while (pending_.empty() && !closing_)
+			pthread_cond_wait(&pending_cond_, &mutex_);
+		if (pending_.empty())
+			break;
+
+		Snapshot* snapshot = pending_.front();
+		pending_.pop_front();
+		pthread_mutex_unlock(&mutex_);
+
+		size_t num_nodes = snapshot->nodes.size();
+		bool ok = fwrite(&snapshot->header, sizeof(TreeExportHeader), 1, out_)
+			== 1
+			&& fwrite(&snapshot->nodes[0], sizeof(TreeExportNode), num_nodes,
+				out_) == num_nodes && fflush(out_) == 0;
+		if (!ok) {
+			loge << "[TreeExport::Write] Error writing the tree of decision "
+				<< snapshot->header.decision << endl;
+		}
+
+		pthread_mutex_lock(&mutex_);
+		if (spare_ == NULL)
+			spare_ = snapshot;
+		else
+			delete snapshot;
+	}
+	pthread_mutex_unlock(&mutex_);
+	return NULL;
+}
+
+void TreeExport::Export(const char* solver, VNode* root,
+	bool speculative) {
+	if (!enabled())
+		return;
+
+	pthread_mutex_lock(&mutex_);
+	int decision = decision_++;
+	bool full = pending_.size() >= MAX_PENDING;
+	Snapshot* snapshot = full ? NULL : spare_;
+	if (full)
+		num_dropped_++;
+	else
+		spare_ = NULL;
+	pthread_mutex_unlock(&mutex_);
+	if (full)
+		return;
+
+	double start = get_time_second();
+	if (snapshot == NULL)
+		snapshot = new Snapshot();
+	memset(&snapshot->header, 0, sizeof(TreeExportHeader));
+	strncpy(snapshot->header.solver, solver,
+		sizeof(snapshot->header.solver) - 1);
+	snapshot->header.decision = decision;
+	snapshot->header.speculative = speculative;
+
+	vector<TreeExportNode>& nodes = snapshot->nodes;
+	nodes.clear();
+	TreeExportNode node;
+	memset(&node, 0, sizeof(TreeExportNode));
+
+	// Belief nodes to visit, with the id of their parent action node and
+	// their observation, which POMCP does not record in its nodes
+	vector<pair<VNode*, pair<int, OBS_TYPE> > > stack(1,
+		make_pair(root, make_pair(-1, (OBS_TYPE) 0)));
+	while (!stack.empty()) {
+		VNode* vnode = stack.back().first;
+		int parent = stack.back().second.first;
+		OBS_TYPE obs = stack.back().second.second;
+		stack.pop_back();
+
+		int id = nodes.size();
+		vector<QNode*>& children = vnode->children();
+		node.edge = parent >= 0 ? (int64_t) obs : -1;
+		node.lower_bound = vnode->lower_bound();
+		node.upper_bound = vnode->upper_bound();
+		node.weight = vnode->Weight();
+		node.value = vnode->value();
+		node.id = id;
+		node.parent = parent;
+		node.depth = vnode->depth();
+		node.count = vnode->count();
+		node.type = TreeExportNode::BELIEF_NODE;
+		node.num_children = children.size();
+		nodes.push_back(node);
+
+		// Action nodes follow their parent, and their children are pushed
+		// last to first so that they are visited in order
+		int first = nodes.size();
+		for (int a = 0; a < children.size(); a++) {
+			QNode* qnode = children[a];
+			node.edge = qnode->edge();
+			node.lower_bound = qnode->lower_bound();
+			node.upper_bound = qnode->upper_bound();
+			node.weight = qnode->Weight();
+			node.value = qnode->value();
+			node.id = nodes.size();
+			node.parent = id;
+			node.count = qnode->count();
+			node.type = TreeExportNode::ACTION_NODE;
+			node.num_children = qnode->children().size();
+			nodes.push_back(node);
+		}
+		for (int a = children.size() - 1; a >= 0; a--) {
+			ObsChildren& obs_children = children[a]->children();
+			for (int i = obs_children.size() - 1; i >= 0; i--) {
+				ObsChildren::iterator it = obs_children.begin() + i;
+				if (it->second->IsChildOf(children[a])) {
+					stack.push_back(make_pair(it->second,
+						make_pair(first + a, it->first)));
+				}
+			}
+		}
+	}
+	snapshot->header.num_nodes = nodes.size();
+	logi << "[TreeExport::Export] Copied " << nodes.size() << " nodes in "
+		<< (get_time_second() - start) << "s" << endl;
+
+	pthread_mutex_lock(&mutex_);
+	pending_.push_back(snapshot);
+	pthread_cond_signal(&pending_cond_);
+	pthread_mutex_unlock(&mutex_);
+}
+
+} // namespace despot
@@ -1,6 +1,8 @@
 #include <despot/interface/belief.h>
 #include <despot/interface/pomdp.h>
 
+#include <typeinfo>
+
 using namespace std;
 
 namespace despot {
@@ -16,6 +18,18 @@ Belief::Belief(const DSPOMDP* model) :
 Belief::~Belief() {
 }
 
+bool Belief::Save(CheckpointWriter& writer) const {
+	loge << "[Belief::Save] " << typeid(*this).name() << " cannot be saved"
+		<< endl;
+	return false;
+}
+
+bool Belief::Restore(CheckpointReader& reader) {
+	loge << "[Belief::Restore] " << typeid(*this).name()
+		<< " cannot be restored" << endl;
+	return false;
+}
+
 string Belief::text() const {
 	return "AbstractBelief";
 }
@@ -12,7 +12,8 @@ namespace despot {
 
 DefaultPolicy::DefaultPolicy(const DSPOMDP* model, ParticleLowerBound* particle_lower_bound) :
 	ScenarioLowerBound(model),
-	particle_lower_bound_(particle_lower_bound) {
+	particle_lower_bound_(particle_lower_bound),
+	partition_(true) {
 	assert(particle_lower_bound_ != NULL);
 }
 
@@ -21,58 +22,195 @@ DefaultPolicy::~DefaultPolicy() {
 
 ValuedAction DefaultPolicy::Value(const vector<State*>& particles,
 	RandomStreams& streams, History& history) const {
-	vector<State*> copy;
+	buffer_.clear();
 	for (int i = 0; i < particles.size(); i++)
-		copy.push_back(model_->Copy(particles[i]));
+		buffer_.push_back(model_->Copy(particles[i]));
 
 	initial_depth_ = history.Size();
-	ValuedAction va = RecursiveValue(copy, streams, history);
+	int position = streams.position();
+	ValuedAction va = partition_ ? PartitionedValue(streams, history) :
+		ScenarioValue(streams, history);
+	streams.position(position);
 
-	for (int i = 0; i < copy.size(); i++)
-		model_->Free(copy[i]);
+	for (int i = 0; i < buffer_.size(); i++)
+		model_->Free(buffer_[i]);
 
 	return va;
 }
 
-ValuedAction DefaultPolicy::RecursiveValue(const vector<State*>& particles,
-	RandomStreams& streams, History& history) const {
-	if (streams.Exhausted()
-		|| (history.Size() - initial_depth_
-			>= Globals::config.max_policy_sim_len)) {
-		return particle_lower_bound_->Value(particles);
-	} else {
-		ACT_TYPE action = Action(particles, streams, history);
-
-		double value = 0;
-
-		map<OBS_TYPE, vector<State*> > partitions;
-		OBS_TYPE obs;
-		double reward;
-		for (int i = 0; i < particles.size(); i++) {
-			State* particle = particles[i];
+/**
+ * Depth-first traversal of the observation histories, with an explicit stack
+ * of frames instead of recursion. The particles of a frame occupy a range of
+ * buffer_ that is reordered in place to hold the ranges of its children, so
+ * no partition is allocated. Since the value is linear in the rewards, each
+ * frame adds its discounted rewards to the total directly.
+ */
+ValuedAction DefaultPolicy::PartitionedValue(RandomStreams& streams,
+	History& history) const {
+	int position = streams.position();
+	ACT_TYPE root_action = -1;
+	double value = 0;
+
+	Frame root = { 0, (int) buffer_.size(), 0, -1, 0, 1.0 };
+	frames_.clear();
+	frames_.push_back(root);
+	while (!frames_.empty()) {
+		Frame frame = frames_.back();
+		frames_.pop_back();
+
+		if (frame.depth > 0) {
+			history.Truncate(initial_depth_ + frame.depth - 1);
+			history.Add(frame.action, frame.obs);
+		}
+		streams.position(position + frame.depth);
+		group_.assign(buffer_.begin() + frame.begin,
+			buffer_.begin() + frame.end);
+
+		if (streams.Exhausted()
+			|| frame.depth >= Globals::config.max_policy_sim_len) {
+			ValuedAction va = particle_lower_bound_->Value(group_);
+			if (frame.depth == 0)
+				return va;
+			value += frame.discount * va.value;
+			continue;
+		}
+
+		ACT_TYPE action = Action(group_, streams, history);
+		if (frame.depth == 0)
+			root_action = action;
+
+		int num_particles = group_.size();
+		if (num_particles == 0)
+			continue;
+
+		// Particles that are not terminal are listed in keys_ with their
+		// observation, in their order in the group
+		keys_.resize(num_particles);
+		pair<OBS_TYPE, int>* keys = &keys_[0];
+		State** group = &group_[0];
+		int num_keys = 0;
+		bool mixed = false;
+		for (int i = 0; i < num_particles; i++) {
+			State* particle = group[i];
+			OBS_TYPE obs;
+			double reward;
 			bool terminal = model_->Step(*particle,
 				streams.Entry(particle->scenario_id), action, reward, obs);
 
-			value += reward * particle->weight;
+			value += frame.discount * reward * particle->weight;
 
 			if (!terminal) {
-				partitions[obs].push_back(particle);
+				keys[num_keys].first = obs;
+				keys[num_keys].second = i;
+				mixed = mixed || obs != keys[0].first;
+				num_keys++;
+			}
+		}
+		if (num_keys == 0)
+			continue;
+
+		// Group the remaining particles by observation, keeping their order.
+		// Often they all share one observation. Otherwise, there are usually
+		// few distinct observations, so they are counted in a small sorted
+		// table and the particles placed with a counting sort.
+		counts_.clear();
+		State** children = &buffer_[frame.begin];
+		if (!mixed) {
+			for (int k = 0; k < num_keys; k++)
+				children[k] = group[keys[k].second];
+			counts_.push_back(make_pair(keys[0].first, frame.begin + num_keys));
+		} else {
+			int last = -1;
+			for (int k = 0; k < num_keys; k++) {
+				OBS_TYPE obs = keys[k].first;
+				if (last < 0 || counts_[last].first != obs) {
+					last = lower_bound(counts_.begin(), counts_.end(),
+						make_pair(obs, 0)) - counts_.begin();
+					if (last == counts_.size() || counts_[last].first != obs)
+						counts_.insert(counts_.begin() + last, make_pair(obs, 0));
+				}
+				counts_[last].second++;
+			}
+
+			int offset = frame.begin;
+			for (int c = 0; c < counts_.size(); c++) {
+				int count = counts_[c].second;
+				counts_[c].second = offset;
+				offset += count;
+			}
+
+			for (int k = 0; k < num_keys; k++) {
+				int c = lower_bound(counts_.begin(), counts_.end(),
+					make_pair(keys[k].first, 0)) - counts_.begin();
+				buffer_[counts_[c].second++] = group[keys[k].second];
 			}
 		}
 
-		for (map<OBS_TYPE, vector<State*> >::iterator it = partitions.begin();
-			it != partitions.end(); it++) {
-			OBS_TYPE obs = it->first;
-			history.Add(action, obs);
-			streams.Advance();
-			ValuedAction va = RecursiveValue(it->second, streams, history);
-			value += Globals::Discount() * va.value;
-			streams.Back();
-			history.RemoveLast();
+		// Terminal particles go after the children's ranges, so that every
+		// particle stays in buffer_ and is freed exactly once
+		for (int i = 0, k = 0, tail = frame.begin + num_keys; i < num_particles;
+			i++) {
+			if (k < num_keys && keys[k].second == i)
+				k++;
+			else
+				buffer_[tail++] = group[i];
 		}
 
-		return ValuedAction(action, value);
+		// Push the children in decreasing order of observation, so that they
+		// are evaluated in increasing order. Each count now holds the end of
+		// the range of its observation.
+		for (int c = counts_.size() - 1; c >= 0; c--) {
+			Frame child = { c > 0 ? counts_[c - 1].second : frame.begin,
+				counts_[c].second, frame.depth + 1, action, counts_[c].first,
+				frame.discount * Globals::Discount() };
+			frames_.push_back(child);
+		}
+	}
+
+	history.Truncate(initial_depth_);
+	return ValuedAction(root_action, value);
+}
+
+ValuedAction DefaultPolicy::ScenarioValue(RandomStreams& streams,
+	History& history) const {
+	if (streams.Exhausted() || Globals::config.max_policy_sim_len <= 0)
+		return particle_lower_bound_->Value(buffer_);
+
+	int position = streams.position();
+	ACT_TYPE root_action = Action(buffer_, streams, history);
+	double value = 0;
+
+	group_.resize(1);
+	for (int i = 0; i < buffer_.size(); i++) {
+		State* particle = buffer_[i];
+		group_[0] = particle;
+
+		ACT_TYPE action = root_action;
+		double discount = 1.0;
+		for (int depth = 0;; depth++) {
+			streams.position(position + depth);
+			if (depth > 0) {
+				if (streams.Exhausted()
+					|| depth >= Globals::config.max_policy_sim_len) {
+					value += discount * particle_lower_bound_->Value(group_).value;
+					break;
+				}
+				action = Action(group_, streams, history);
+			}
+
+			double reward;
+			OBS_TYPE obs;
+			bool terminal = model_->Step(*particle,
+				streams.Entry(particle->scenario_id), action, reward, obs);
+			value += discount * reward * particle->weight;
+
+			if (terminal)
+				break;
+			discount *= Globals::Discount();
+		}
 	}
+
+	return ValuedAction(root_action, value);
 }
 
 void DefaultPolicy::Reset() {
@@ -82,4 +220,16 @@ ParticleLowerBound* DefaultPolicy::particle_lower_bound() const {
 	return particle_lower_bound_;
 }
 
+void DefaultPolicy::partition(bool p) {
+	partition_ = p;
+}
+
+bool DefaultPolicy::partition() const {
+	return partition_;
+}
+
+bool DefaultPolicy::UsesHistory() const {
+	return partition_;
+}
+
 } // namespace despot
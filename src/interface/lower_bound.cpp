@@ -43,6 +43,10 @@ void ScenarioLowerBound::Reset() {
 void ScenarioLowerBound::Learn(VNode* tree) {
 }
 
+bool ScenarioLowerBound::UsesHistory() const {
+	return true;
+}
+
 /* =============================================================================
  * ParticleLowerBound class
  * =============================================================================*/
@@ -56,6 +60,10 @@ ValuedAction ParticleLowerBound::Value(const vector<State*>& particles,
 	return Value(particles);
 }
 
+bool ParticleLowerBound::UsesHistory() const {
+	return false;
+}
+
 /* =============================================================================
  * BeliefLowerBound class
  * =============================================================================*/
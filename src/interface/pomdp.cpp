@@ -48,6 +48,17 @@ double State::Weight(const vector<State*>& particles) {
 StateIndexer::~StateIndexer() {
 }
 
+void StateIndexer::Gather(const vector<State*>& particles, vector<int>& indices,
+	vector<double>& weights) const {
+	int num_particles = particles.size();
+	indices.resize(num_particles);
+	weights.resize(num_particles);
+	for (int i = 0; i < num_particles; i++) {
+		indices[i] = GetIndex(particles[i]);
+		weights[i] = particles[i]->weight;
+	}
+}
+
 /* =============================================================================
  * StatePolicy class
  * =============================================================================*/
@@ -92,6 +103,10 @@ State* DSPOMDP::CreateStartState(std::string type) const{
 	exit(1);
 }
 
+double DSPOMDP::GetMinReward() const {
+	return Globals::NEG_INFTY;
+}
+
 ParticleUpperBound* DSPOMDP::CreateParticleUpperBound(string name) const {
 	if (name == "TRIVIAL" || name == "DEFAULT") {
 		return new TrivialParticleUpperBound(this);
@@ -154,6 +169,62 @@ POMCPPrior* DSPOMDP::CreatePOMCPPrior(string name) const {
 	}
 }
 
+uint64_t DSPOMDP::Hash(const State& state) const {
+	cerr << "ERROR: State hashing is not implemented for this model "
+		<< "(override DSPOMDP::Hash)" << endl;
+	exit(1);
+	return 0;
+}
+
+uint64_t DSPOMDP::Hash(const vector<State*>& particles, uint64_t seed) const {
+	uint64_t hash = HashCombine(seed, particles.size());
+	for (int i = 0; i < particles.size(); i++) {
+		const State* particle = particles[i];
+		union {
+			double value;
+			uint64_t bits;
+		} weight;
+		weight.value = particle->weight;
+
+		hash = HashCombine(hash, particle->scenario_id);
+		hash = HashCombine(hash, weight.bits);
+		hash = HashCombine(hash, Hash(*particle));
+	}
+	return hash;
+}
+
+bool DSPOMDP::Equal(const State& s1, const State& s2) const {
+	return &s1 == &s2 || Hash(s1) == Hash(s2);
+}
+
+bool DSPOMDP::Equal(const vector<State*>& particles1,
+	const vector<State*>& particles2) const {
+	if (particles1.size() != particles2.size())
+		return false;
+
+	for (int i = 0; i < particles1.size(); i++) {
+		const State* p1 = particles1[i];
+		const State* p2 = particles2[i];
+		if (p1->scenario_id != p2->scenario_id || p1->weight != p2->weight
+			|| !Equal(*p1, *p2))
+			return false;
+	}
+	return true;
+}
+
+void DSPOMDP::WriteState(const State& state, CheckpointWriter& writer) const {
+	cerr << "ERROR: State serialization is not implemented for this model "
+		<< "(override DSPOMDP::WriteState and DSPOMDP::ReadState)" << endl;
+	exit(1);
+}
+
+State* DSPOMDP::ReadState(CheckpointReader& reader) const {
+	cerr << "ERROR: State serialization is not implemented for this model "
+		<< "(override DSPOMDP::WriteState and DSPOMDP::ReadState)" << endl;
+	exit(1);
+	return NULL;
+}
+
 vector<State*> DSPOMDP::Copy(const vector<State*>& particles) const {
 	vector<State*> copy;
 	for (int i = 0; i < particles.size(); i++)
@@ -191,4 +262,13 @@ BeliefUpperBound* BeliefMDP::CreateBeliefUpperBound(string name) const {
 	}
 }
 
+void BeliefMDP::Successors(const Belief* belief, ACT_TYPE action,
+	map<OBS_TYPE, double>& obss, map<OBS_TYPE, Belief*>& successors) const {
+	Observe(belief, action, obss);
+	for (map<OBS_TYPE, double>::iterator it = obss.begin(); it != obss.end();
+		it++) {
+		successors[it->first] = Tau(belief, action, it->first);
+	}
+}
+
 } // namespace despot
@@ -19,6 +19,10 @@ ScenarioUpperBound::~ScenarioUpperBound() {
 void ScenarioUpperBound::Init(const RandomStreams& streams) {
 }
 
+bool ScenarioUpperBound::UsesHistory() const {
+	return true;
+}
+
 /* =============================================================================
  * ParticleUpperBound
  * =============================================================================*/
@@ -39,6 +43,10 @@ double ParticleUpperBound::Value(const vector<State*>& particles,
 	return value;
 }
 
+bool ParticleUpperBound::UsesHistory() const {
+	return false;
+}
+
 /* =============================================================================
  * BeliefUpperBound
  * =============================================================================*/
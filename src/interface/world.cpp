@@ -24,4 +24,12 @@ void World::PrintState(const State& s, ostream& out) const {
 	out << "Not Implemented" << endl;
 }
 
+bool World::Save(CheckpointWriter& writer) const {
+	return true;
+}
+
+bool World::Restore(CheckpointReader& reader) {
+	return true;
+}
+
 } /* namespace despot */
@@ -1,4 +1,6 @@
+#include <despot/core/checkpoint.h>
 #include <despot/core/pomdp_world.h>
+#include <despot/core/shared_memory_world.h>
 #include <despot/logger.h>
 
 using namespace std;
@@ -183,6 +185,21 @@ double Logger::StderrDiscountedRoundReward() const {
 	return n > 0 ? sqrt(sum2 / n / n - sum * sum / n / n / n) : 0.0;
 }
 
+void Logger::Save(CheckpointWriter& writer) const {
+	writer.WriteValue(step_);
+	writer.WriteValue(total_discounted_reward_);
+	writer.WriteValue(total_undiscounted_reward_);
+}
+
+bool Logger::Restore(CheckpointReader& reader) {
+	if (!reader.ReadValue(step_) || !reader.ReadValue(total_discounted_reward_)
+			|| !reader.ReadValue(total_undiscounted_reward_))
+		return false;
+	if (world_->GetCurrentState() != NULL)
+		state_ = world_->GetCurrentState();
+	return true;
+}
+
 void Logger::CheckTargetTime() const {
 	if (target_finish_time_ != -1 && get_time_second() > target_finish_time_) {
 		if (!Globals::config.silence && out_)
@@ -267,6 +284,8 @@ bool Logger::SummarizeStep(int step, int round, bool terminal, ACT_TYPE action,
 	//Record step reward
 	if (world_type_ == "pomdp")
 		reward_ = static_cast<POMDPWorld*>(world_)->step_reward_;
+	else if (world_type_ == "shm" || world_type_ == "shm-sim")
+		reward_ = static_cast<SharedMemoryWorld*>(world_)->step_reward_;
 	else if (state_ != NULL) {
 		reward_ = model_->Reward(*state_, action);
 		if (reward_ > model_->GetMaxReward()) { //invalid reward from model_->Reward
@@ -5,19 +5,47 @@
  *      Author: panpan
  */
 
+#include <despot/core/checkpoint.h>
+#include <despot/core/pomdp_world.h>
 #include <despot/core/solver.h>
 #include <despot/interface/belief.h>
 #include <despot/interface/world.h>
 #include <despot/logger.h>
 #include <despot/planner.h>
 
+#include <pthread.h>
+#include <unistd.h>
+
 namespace despot {
 
+// Action executed by the world on its own thread during a pipelined step
+struct ExecuteTask {
+	World* world;
+	ACT_TYPE action;
+	OBS_TYPE obs;
+	bool terminal;
+	double time;
+	volatile int done;
+	pthread_t thread;
+};
+
+static void* ExecuteAction(void* arg) {
+	ExecuteTask* task = (ExecuteTask*) arg;
+	double start_t = get_time_second();
+	task->terminal = task->world->ExecuteAction(task->action, task->obs);
+	task->time = get_time_second() - start_t;
+	__sync_synchronize();
+	task->done = 1;
+	return NULL;
+}
+
 Planner::Planner(string lower_bounds_str,
 		string base_lower_bounds_str, string upper_bounds_str, string base_upper_bounds_str)
 		:PlannerBase(lower_bounds_str, base_lower_bounds_str, upper_bounds_str, base_upper_bounds_str){
 	step_=0;
 	round_=0;
+	next_action_=-1;
+	checkpoint_checked_=false;
 }
 
 Planner::~Planner() {
@@ -54,12 +82,180 @@ bool Planner::RunStep(Solver* solver, World* world, Logger* logger) {
 			step_start_t);
 }
 
+bool Planner::RunPipelinedStep(Solver* solver, World* world, Logger* logger) {
+
+	logger->CheckTargetTime();
+
+	double step_start_t = get_time_second();
+
+	double start_t = get_time_second();
+	ACT_TYPE action = next_action_;
+	if (action < 0)
+		action = solver->Search().action;
+	next_action_ = -1;
+	double end_t = get_time_second();
+	double search_time = (end_t - start_t);
+	logi << "[RunPipelinedStep] Time spent in " << typeid(*solver).name()
+			<< "::Search(): " << search_time << endl;
+
+	// A simulated world stepping the model of the solver cannot execute the
+	// action while the solver searches, see DSPOMDP::MakeCopy
+	POMDPWorld* pomdp_world = dynamic_cast<POMDPWorld*>(world);
+	bool concurrent = pomdp_world == NULL
+			|| pomdp_world->model() != solver->belief()->model_;
+
+	ExecuteTask task;
+	task.world = world;
+	task.action = action;
+	task.done = 0;
+	if (concurrent)
+		pthread_create(&task.thread, NULL, ExecuteAction, &task);
+	else
+		ExecuteAction(&task);
+
+	// Search from the most likely successor beliefs until the observation
+	// is received, which also interrupts the search in progress
+	Solver::interrupt(&task.done);
+	start_t = get_time_second();
+	vector<pair<OBS_TYPE, double> > obss;
+	solver->PredictObservations(action, obss);
+	vector<Speculation> speculations;
+	for (int i = 0; i < obss.size() && i < Globals::config.pipeline_branches
+			&& !task.done; i++) {
+		Speculation speculation;
+		if (!solver->Speculate(action, obss[i].first, speculation))
+			break;
+		speculations.push_back(speculation);
+	}
+	end_t = get_time_second();
+	logi << "[RunPipelinedStep] Time spent in " << speculations.size()
+			<< " speculative searches: " << (end_t - start_t) << endl;
+
+	start_t = get_time_second();
+	int num_refinements = 0;
+	while (!task.done && solver->Refine())
+		num_refinements++;
+	end_t = get_time_second();
+	Solver::interrupt(NULL);
+	logi << "[RunPipelinedStep] Time spent in " << num_refinements
+			<< " refinements: " << (end_t - start_t) << endl;
+
+	if (concurrent)
+		pthread_join(task.thread, NULL);
+	OBS_TYPE obs = task.obs;
+	bool terminal = task.terminal;
+	logi << "[RunPipelinedStep] Time spent in ExecuteAction(): " << task.time
+			<< endl;
+
+	start_t = get_time_second();
+	for (int i = 0; i < speculations.size(); i++) {
+		if (speculations[i].obs == obs && next_action_ < 0) {
+			solver->Commit(speculations[i]);
+			logger->belief(solver->belief());
+			next_action_ = speculations[i].next_action;
+		} else {
+			delete speculations[i].belief;
+		}
+	}
+	if (next_action_ < 0)
+		solver->BeliefUpdate(action, obs);
+	end_t = get_time_second();
+	double update_time = (end_t - start_t);
+	logi << "[RunPipelinedStep] Time spent in Update(): " << update_time
+			<< (next_action_ >= 0 ? " (speculation committed)" : "") << endl;
+
+	return logger->SummarizeStep(step_++, round_, terminal, action, obs,
+			step_start_t);
+}
+
+bool Planner::SaveCheckpoint(Solver* solver, World* world, Logger* logger) {
+	double start_t = get_time_second();
+	const string& file = Globals::config.checkpoint_file;
+	CheckpointWriter writer(solver->belief()->model_);
+	if (!writer.Open(file))
+		return false;
+
+	writer.WriteString(typeid(*solver).name());
+	writer.WriteValue(Random::RANDOM.seed());
+	writer.WriteValue(Seeds::state());
+	writer.WriteValue(next_action_);
+	writer.WriteValue(round_);
+	writer.WriteValue(step_);
+	bool ok = world->Save(writer);
+	logger->Save(writer);
+	ok = ok && solver->Save(writer) && writer.Close();
+	logi << "[Planner::SaveCheckpoint] " << (ok ? "Saved " : "Failed to save ")
+			<< file << " in " << (get_time_second() - start_t) << "s" << endl;
+	return ok;
+}
+
+void Planner::RestoreCheckpoint(Solver* solver, World* world, Logger* logger) {
+	double start_t = get_time_second();
+	const string& file = Globals::config.checkpoint_file;
+	if (access(file.c_str(), F_OK) != 0) {
+		logi << "[Planner::RestoreCheckpoint] No checkpoint at " << file
+				<< ", starting afresh" << endl;
+		return;
+	}
+
+	CheckpointReader reader(solver->belief()->model_);
+	string solver_type;
+	unsigned random_seed, seeds_state;
+	ACT_TYPE next_action;
+	int round, step;
+	if (!reader.Open(file) || !reader.ReadString(solver_type)
+			|| solver_type != typeid(*solver).name()
+			|| !reader.ReadValue(random_seed) || !reader.ReadValue(seeds_state)
+			|| !reader.ReadValue(next_action) || !reader.ReadValue(round)
+			|| !reader.ReadValue(step)) {
+		cerr << "ERROR: Cannot resume from " << file
+				<< " (written by another solver, or incomplete)" << endl;
+		exit(1);
+	}
+	// Earlier rounds are not in the checkpoint, so it is only resumed in
+	// the round that wrote it
+	if (round != round_) {
+		cerr << "ERROR: " << file << " was written in round " << round
+				<< ", not in round " << round_ << endl;
+		exit(1);
+	}
+	if (!world->Restore(reader) || !logger->Restore(reader)
+			|| !solver->Restore(reader)) {
+		cerr << "ERROR: Cannot resume from " << file << " (incomplete)"
+				<< endl;
+		exit(1);
+	}
+
+	Random::RANDOM = Random(random_seed);
+	Seeds::state(seeds_state);
+	next_action_ = next_action;
+	step_ = step;
+	logi << "[Planner::RestoreCheckpoint] Resumed from " << file << " at step "
+			<< step_ << " in " << (get_time_second() - start_t) << "s" << endl;
+}
+
 void Planner::PlanningLoop(Solver*& solver, World* world, Logger* logger) {
-	for (int i = 0; i < Globals::config.sim_len; i++) {
-		bool terminal = RunStep(solver, world, logger);
+	next_action_ = -1;
+	bool checkpoint = Globals::config.checkpoint_file != "";
+	if (checkpoint && !checkpoint_checked_)
+		RestoreCheckpoint(solver, world, logger);
+	checkpoint_checked_ = true;
+
+	// A resumed round continues from the step after the checkpoint
+	for (int i = step_; i < Globals::config.sim_len; i++) {
+		bool terminal = Globals::config.pipeline_branches > 0
+				|| Globals::config.reuse_tree ?
+				RunPipelinedStep(solver, world, logger) :
+				RunStep(solver, world, logger);
 		if (terminal)
 			break;
+		if (checkpoint)
+			SaveCheckpoint(solver, world, logger);
 	}
+
+	// A finished round is not resumed
+	if (checkpoint)
+		remove(Globals::config.checkpoint_file.c_str());
 }
 
 int Planner::RunPlanning(int argc, char *argv[]) {
@@ -1,8 +1,14 @@
+#include <despot/core/bound_cache.h>
 #include <despot/core/pomdp_world.h>
+#include <despot/core/shared_memory_world.h>
+#include <despot/core/search_trace.h>
+#include <despot/core/tree_export.h>
 #include <despot/plannerbase.h>
 #include <despot/solver/baseline_solver.h>
 #include <despot/util/seeds.h>
 
+#include <unistd.h>
+
 using namespace std;
 
 namespace despot {
@@ -54,6 +60,59 @@ option::Descriptor* BuildUsage(string lower_bounds_str,
 					{ E_TIMEOUT, 0, "t", "timeout", option::Arg::Required,
 							"-t <arg>  \t--timeout <arg>  \tSearch time per move, in seconds (default "
 									"1)." },
+					{ E_TRIALS, 0, "", "trials", option::Arg::Required,
+							"  \t--trials <arg>  \tStop each search after a fixed number of trials "
+									"(simulations for POMCP) instead of the timeout, so that runs "
+									"with the same seed build the same trees." },
+					{ E_MAX_TREE_PARTICLES, 0, "", "max-tree-particles",
+							option::Arg::Required,
+							"  \t--max-tree-particles <arg>  \tParticle budget of the DESPOT tree; "
+									"once it is reached, closed subtrees are recycled and open ones "
+									"off the path of the next trial are collapsed (default no "
+									"limit)." },
+					{ E_REPLAY_PARTICLES, 0, "", "replay-particles", option::Arg::None,
+							"  \t--replay-particles  \tKeep particles only at the root of the DESPOT "
+									"tree and regenerate those of a node when it is expanded." },
+					{ E_TRANSPOSITIONS, 0, "", "transpositions", option::Arg::None,
+							"  \t--transpositions  \tShare DESPOT nodes reached through different "
+									"paths with the same scenarios in the same states." },
+					{ E_ALPHA_VECTORS, 0, "", "alpha-vectors", option::Arg::Required,
+							"  \t--alpha-vectors <arg>  \tPath prefix of files caching the "
+									"offline alpha vectors of ALPHA bounds; computed and written "
+									"if missing (default computed on every run)." },
+					{ E_BOUND_CACHE, 0, "", "bound-cache", option::Arg::Required,
+							"  \t--bound-cache <arg>  \tNumber of entries of a cache sharing the "
+									"bounds of DESPOT nodes with the same scenarios in the same "
+									"states (default 0, no cache)." },
+					{ E_REUSE_TREE, 0, "", "reuse-tree", option::Arg::None,
+							"  \t--reuse-tree  \tKeep the DESPOT subtrees after the chosen action, "
+									"refine them while it executes, and start the next search "
+									"from the one of the received observation. Disables pruning "
+									"and --pipeline." },
+					{ E_PIPELINE, 0, "", "pipeline", option::Arg::Required,
+							"  \t--pipeline <arg>  \tWhile an action executes, search from the "
+									"beliefs after this many of its most likely observations, and "
+									"skip the next search when one is received (default 0, "
+									"DESPOT only, ignored with --reuse-tree). In simulation, "
+									"actions overlap the search only for models providing "
+									"MakeCopy()." },
+					{ E_CHECKPOINT, 0, "", "checkpoint", option::Arg::Required,
+							"  \t--checkpoint <arg>  \tFile the planning state is saved to after "
+									"every step, and resumed from if present when the planner "
+									"starts; removed when the round ends. With --reuse-tree, the "
+									"retained subtree and all its particles are saved too, which "
+									"takes tens of MB per step on larger models." },
+					{ E_THREADS, 0, "", "threads", option::Arg::Required,
+							"  \t--threads <arg>  \tNumber of threads running POMCP simulations "
+									"on a shared tree, computing ALPHA bounds and Tag floor distances, and updating Pocman beliefs (default 1)." },
+					{ E_WORLD, 0, "", "world", option::Arg::Required,
+							"  \t--world <arg>  \tWorld executing the actions: pomdp (the model "
+									"simulated in process, default), shm (a plant in another "
+									"process, through shared memory) or shm-sim (the model "
+									"simulated in a child process, through shared memory)." },
+					{ E_SHM_NAME, 0, "", "shm-name", option::Arg::Required,
+							"  \t--shm-name <arg>  \tName of the shared memory segment of the shm "
+									"worlds (default /despot_world)." },
 					{ E_NUMPARTICLES, 0, "n", "nparticles",
 							option::Arg::Required,
 							"-n <arg>  \t--nparticles <arg>  \tNumber of particles (default 500)." },
@@ -65,6 +124,12 @@ option::Descriptor* BuildUsage(string lower_bounds_str,
 							option::Arg::Required,
 							"  \t--max-policy-simlen <arg>  \tDepth to simulate the default policy "
 									"until. (default 90)." },
+					{ E_ROLLOUT_TOLERANCE, 0, "", "rollout-tolerance",
+							option::Arg::Required,
+							"  \t--rollout-tolerance <arg>  \tStop POMCP rollouts once the "
+									"discounted reward they can still collect is below this, for "
+									"models that give their minimum reward (default 0, no "
+									"cutoff)." },
 
 					{ E_SEED, 0, "r", "seed", option::Arg::Required,
 							"-r <arg>  \t--seed <arg>  \tRandom number seed (default is random)." },
@@ -92,8 +157,16 @@ option::Descriptor* BuildUsage(string lower_bounds_str,
 					{ E_SOLVER, 0, "", "solver", option::Arg::Required,
 							"  \t--solver <arg>  \t" }, { E_PRIOR, 0, "",
 							"prior", option::Arg::Required,
-							"  \t--prior <arg>  \tPOMCP prior." }, { 0, 0, 0, 0,
-							0, 0 } };
+							"  \t--prior <arg>  \tPOMCP prior." },
+					{ E_TRACE, 0, "", "trace", option::Arg::Required,
+							"  \t--trace <arg>  \tWrite per-decision search metrics to a JSON-lines "
+									"file." },
+					{ E_TRACE_TRIALS, 0, "", "trace-trials", option::Arg::None,
+							"  \t--trace-trials  \tAlso write one trace record per trial." },
+					{ E_TREE_EXPORT, 0, "", "tree-export", option::Arg::Required,
+							"  \t--tree-export <arg>  \tWrite the search tree of every decision to a "
+									"binary file in the background." },
+					{ 0, 0, 0, 0, 0, 0 } };
 	return usage;
 }
 
@@ -109,6 +182,8 @@ World* PlannerBase::InitializeWorld(std::string& world_type, DSPOMDP* model,
 		option::Option* options) {
 	if (world_type == "pomdp")
 		return InitializePOMDPWorld(world_type, model, options);
+	else if (world_type == "shm" || world_type == "shm-sim")
+		return InitializeSharedMemoryWorld(world_type, model, options);
 	else {
 		cerr
 				<< "Unsupported world type (pomdp by default). To support custom world, implement "
@@ -119,9 +194,24 @@ World* PlannerBase::InitializeWorld(std::string& world_type, DSPOMDP* model,
 
 World* PlannerBase::InitializePOMDPWorld(string& world_type, DSPOMDP *model,
 		option::Option* options) {
+	//The shared memory worlds execute actions with the same model
+	if (world_type == "shm" || world_type == "shm-sim")
+		return InitializeSharedMemoryWorld(world_type, model, options);
+
 	//Create world: use POMDP model
 	world_type = "pomdp";
-	POMDPWorld* world = new POMDPWorld(model, Seeds::Next());
+	//Pipelined steps execute actions while the solver searches, which the
+	//world only does if it steps its own copy of the model
+	DSPOMDP* world_model = NULL;
+	if (Globals::config.pipeline_branches > 0 || Globals::config.reuse_tree) {
+		world_model = model->MakeCopy();
+		if (world_model == NULL) {
+			logw << "The model provides no MakeCopy for the world to step, "
+					<< "so actions are executed before searching ahead" << endl;
+		}
+	}
+	POMDPWorld* world = new POMDPWorld(
+			world_model != NULL ? world_model : model, Seeds::Next());
 	//Establish connection: do nothing
 	world->Connect();
 	//Initialize: create start state
@@ -129,6 +219,36 @@ World* PlannerBase::InitializePOMDPWorld(string& world_type, DSPOMDP *model,
 	return world;
 }
 
+World* PlannerBase::InitializeSharedMemoryWorld(string& world_type,
+		DSPOMDP *model, option::Option* options) {
+	string name = "/despot_world";
+	if (options[E_SHM_NAME])
+		name = options[E_SHM_NAME].arg;
+
+	if (world_type == "shm-sim") {
+		if (!options[E_SHM_NAME])
+			name += "_" + to_string(getpid());
+		//The simulator serves the process's whole lifetime, like the world
+		SharedMemorySimulator* simulator = new SharedMemorySimulator(model,
+				Seeds::Next());
+		if (!simulator->Fork(name)) {
+			cerr << "ERROR: Cannot start a simulator process" << endl;
+			exit(1);
+		}
+	}
+
+	SharedMemoryWorld* world = new SharedMemoryWorld(model, name);
+	//Establish connection: open the segment created by the plant
+	if (!world->Connect()) {
+		cerr << "ERROR: No plant serving the shared memory segment " << name
+				<< endl;
+		exit(1);
+	}
+	//Initialize: reset the plant
+	world->Initialize();
+	return world;
+}
+
 option::Option* PlannerBase::InitializeParamers(int argc, char *argv[],
 		std::string& solver_type, bool& search_solver, int& num_runs,
 		std::string& world_type, std::string& belief_type, int& time_limit) {
@@ -196,6 +316,13 @@ Solver *PlannerBase::InitializeSolver(DSPOMDP *model, Belief* belief,
 			logi << "Created upper bound " << typeid(*upper_bound).name()
 					<< endl;
 
+			if (Globals::config.bound_cache_size > 0) {
+				BoundCache* cache = new BoundCache(model,
+						Globals::config.bound_cache_size);
+				lower_bound = new CachedScenarioLowerBound(lower_bound, cache);
+				upper_bound = new CachedScenarioUpperBound(upper_bound, cache);
+			}
+
 			solver = new DESPOT(model, lower_bound, upper_bound);
 		} else
 			solver = new ScenarioBaselineSolver(lower_bound);
@@ -231,9 +358,16 @@ Solver *PlannerBase::InitializeSolver(DSPOMDP *model, Belief* belief,
 			prior->exploration_constant(Globals::config.pruning_constant);
 		}
 
-		if (solver_type == "POMCP")
-			solver = new POMCP(model, prior);
-		else
+		if (solver_type == "POMCP") {
+			POMCP *pomcp = new POMCP(model, prior);
+			if (Globals::config.num_threads > 1) {
+				vector<POMCPPrior *> priors;
+				for (int t = 0; t < Globals::config.num_threads; t++)
+					priors.push_back(model->CreatePOMCPPrior(ptype));
+				pomcp->thread_priors(priors);
+			}
+			solver = pomcp;
+		} else
 			solver = new DPOMCP(model, prior);
 	} else { // Unsupported solver
 		cerr << "ERROR: Unsupported solver type: " << solver_type << endl;
@@ -270,12 +404,82 @@ void PlannerBase::OptionParse(option::Option *options, int &num_runs,
 	if (options[E_TIMEOUT])
 		Globals::config.time_per_move = atof(options[E_TIMEOUT].arg);
 
+	if (options[E_TRIALS])
+		Globals::config.max_trials = atoi(options[E_TRIALS].arg);
+
+	if (options[E_MAX_TREE_PARTICLES])
+		Globals::config.max_tree_particles = atoi(
+				options[E_MAX_TREE_PARTICLES].arg);
+
+	if (options[E_REPLAY_PARTICLES])
+		Globals::config.replay_particles = true;
+
+	if (options[E_TRANSPOSITIONS])
+		Globals::config.merge_transpositions = true;
+
+	// Recycling a closed subtree would delete nodes shared with open ones,
+	// and nodes without particles cannot be checked before being shared
+	if (Globals::config.merge_transpositions
+			&& (Globals::config.max_tree_particles > 0
+				|| Globals::config.replay_particles)) {
+		cerr << "ERROR: --transpositions cannot be combined with "
+				<< "--max-tree-particles or --replay-particles" << endl;
+		exit(1);
+	}
+
+	// The budget counts the particles replayed nodes were created with,
+	// which deleting them does not free
+	if (Globals::config.replay_particles
+			&& Globals::config.max_tree_particles > 0) {
+		cerr << "ERROR: --replay-particles cannot be combined with "
+				<< "--max-tree-particles" << endl;
+		exit(1);
+	}
+
+	if (options[E_ALPHA_VECTORS])
+		Globals::config.alpha_vectors_file = options[E_ALPHA_VECTORS].arg;
+
+	if (options[E_PIPELINE])
+		Globals::config.pipeline_branches = atoi(options[E_PIPELINE].arg);
+
+	if (options[E_CHECKPOINT])
+		Globals::config.checkpoint_file = options[E_CHECKPOINT].arg;
+
+	if (options[E_BOUND_CACHE])
+		Globals::config.bound_cache_size = atoi(options[E_BOUND_CACHE].arg);
+
+	if (options[E_THREADS])
+		Globals::config.num_threads = atoi(options[E_THREADS].arg);
+
 	if (options[E_NUMPARTICLES])
 		Globals::config.num_scenarios = atoi(options[E_NUMPARTICLES].arg);
 
 	if (options[E_PRUNE])
 		Globals::config.pruning_constant = atof(options[E_PRUNE].arg);
 
+	if (options[E_REUSE_TREE]) {
+		if (Globals::config.replay_particles
+				|| Globals::config.merge_transpositions
+				|| (options[E_PRUNE] && Globals::config.pruning_constant > 0)) {
+			cerr << "ERROR: --reuse-tree cannot be combined with "
+					<< "--replay-particles, --transpositions or --prune" << endl;
+			exit(1);
+		}
+		// Rebased bounds would carry the pruning penalty of the old root
+		if (Globals::config.pruning_constant > 0) {
+			cerr << "WARNING: --reuse-tree disables the pruning constant "
+					<< Globals::config.pruning_constant
+					<< " set by the model by default" << endl;
+			Globals::config.pruning_constant = 0;
+		}
+		if (Globals::config.pipeline_branches > 0) {
+			cerr << "WARNING: --pipeline is ignored with --reuse-tree, which "
+					<< "refines the kept subtrees instead" << endl;
+			Globals::config.pipeline_branches = 0;
+		}
+		Globals::config.reuse_tree = true;
+	}
+
 	if (options[E_GAP])
 		Globals::config.xi = atof(options[E_GAP].arg);
 
@@ -289,6 +493,10 @@ void PlannerBase::OptionParse(option::Option *options, int &num_runs,
 		Globals::config.max_policy_sim_len = atoi(
 				options[E_MAX_POLICY_SIM_LEN].arg);
 
+	if (options[E_ROLLOUT_TOLERANCE])
+		Globals::config.rollout_tolerance = atof(
+				options[E_ROLLOUT_TOLERANCE].arg);
+
 	if (options[E_DEFAULT_ACTION])
 		Globals::config.default_action = options[E_DEFAULT_ACTION].arg;
 
@@ -309,6 +517,12 @@ void PlannerBase::OptionParse(option::Option *options, int &num_runs,
 	if (options[E_SOLVER])
 		solver_type = options[E_SOLVER].arg;
 
+	if (options[E_TRACE])
+		SearchTrace::Open(options[E_TRACE].arg, options[E_TRACE_TRIALS]);
+
+	if (options[E_TREE_EXPORT])
+		TreeExport::Open(options[E_TREE_EXPORT].arg);
+
 	int verbosity = 0;
 	if (options[E_VERBOSITY])
 		verbosity = atoi(options[E_VERBOSITY].arg);
@@ -344,6 +558,9 @@ void PlannerBase::DisplayParameters(option::Option *options, DSPOMDP *model) {
 	<< endl
 	<< "Search time per step = " << Globals::config.time_per_move
 	<< endl
+	<< "Search trials per step = " << (Globals::config.max_trials > 0 ?
+		to_string(Globals::config.max_trials) : "unlimited (timed)")
+	<< endl
 	<< "Regularization constant = "
 	<< Globals::config.pruning_constant << endl
 	<< "Lower bound = " << lbtype << endl
@@ -362,6 +579,9 @@ void PlannerBase::PrintResult(int num_runs, Logger *logger,
 			<< (get_time_second() - EvalLog::curr_inst_start_time) << " / "
 			<< (double(clock() - main_clock_start) / CLOCKS_PER_SEC) << "s"
 			<< endl;
+
+	SearchTrace::Close();
+	TreeExport::Close();
 }
 
 } // namespace despot
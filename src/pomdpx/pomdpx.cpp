@@ -531,6 +531,40 @@ ScenarioUpperBound* POMDPX::CreateScenarioUpperBound(string name,
 	}
 }
 
+/**
+ * States are identified by the values of their state variables, as state_id
+ * is not maintained by Step.
+ */
+uint64_t POMDPX::Hash(const State& s) const {
+	const POMDPXState& state = static_cast<const POMDPXState&>(s);
+	uint64_t hash = state.vec_id.size();
+	for (int i = 0; i < state.vec_id.size(); i++)
+		hash = HashCombine(hash, state.vec_id[i]);
+	return hash;
+}
+
+bool POMDPX::Equal(const State& s1, const State& s2) const {
+	return static_cast<const POMDPXState&>(s1).vec_id
+		== static_cast<const POMDPXState&>(s2).vec_id;
+}
+
+void POMDPX::WriteState(const State& s, CheckpointWriter& writer) const {
+	const POMDPXState& state = static_cast<const POMDPXState&>(s);
+	writer.WriteValue((int) state.vec_id.size());
+	if (!state.vec_id.empty())
+		writer.Write(&state.vec_id[0], state.vec_id.size() * sizeof(int));
+}
+
+State* POMDPX::ReadState(CheckpointReader& reader) const {
+	POMDPXState* state = static_cast<POMDPXState*>(Allocate(-1, 0));
+	int size = 0;
+	reader.ReadValue(size);
+	state->vec_id.resize(reader.ok() && size > 0 ? size : 0);
+	if (!state->vec_id.empty())
+		reader.Read(&state->vec_id[0], state->vec_id.size() * sizeof(int));
+	return state;
+}
+
 void POMDPX::PrintState(const State& s, ostream& out) const {
 	const POMDPXState& state = static_cast<const POMDPXState&>(s);
 
@@ -34,6 +34,17 @@ void RandomStreams::Back() const {
 	position_--;
 }
 
+void RandomStreams::Shift() {
+	vector<unsigned> seeds = Seeds::Next(streams_.size());
+	for (int i = 0; i < streams_.size(); i++) {
+		vector<double>& stream = streams_[i];
+		if (stream.empty())
+			continue;
+		stream.erase(stream.begin());
+		stream.push_back(Random(seeds[i]).NextDouble());
+	}
+}
+
 void RandomStreams::position(int value) const {
 	position_ = value;
 }
@@ -1,4 +1,6 @@
 #include <despot/solver/aems.h>
+#include <despot/core/search_trace.h>
+#include <despot/core/tree_export.h>
 
 using namespace std;
 
@@ -19,6 +21,7 @@ ValuedAction AEMS::Search() {
 		root_ = new VNode(belief_->MakeCopy());
 		InitLowerBound(root_, lower_bound_, history_);
 		InitUpperBound(root_, upper_bound_, history_);
+		UpdateApproxError(root_);
 	}
 
 	statistics_ = SearchStatistics();
@@ -27,11 +30,13 @@ ValuedAction AEMS::Search() {
 	model_->PrintBelief(*belief_); //TODO: check and remove
 	// cout << *belief_ << endl;
 	clock_t begin = clock();
+	double start_real = get_time_second();
 	statistics_.initial_lb = root_->lower_bound();
 	statistics_.initial_ub = root_->upper_bound();
 
 	int num_active_particles = model_->NumActiveParticles();
 	do {
+		clock_t trial_start = clock();
 		VNode* promising_node = FindMaxApproxErrorLeaf(root_);
 		assert(promising_node->IsLeaf());
 
@@ -42,14 +47,22 @@ ValuedAction AEMS::Search() {
 		Backup(promising_node);
 		history_.Truncate(hist_size);
 
+		if (SearchTrace::trials_enabled()) {
+			SearchTrace::Trial(statistics_.num_trials, promising_node->depth(),
+				(double) (clock() - trial_start) / CLOCKS_PER_SEC, 1,
+				root_->lower_bound(), root_->upper_bound());
+		}
+
 		if (promising_node->depth() > statistics_.longest_trial_length) {
 			statistics_.longest_trial_length = promising_node->depth();
 		}
 
 		statistics_.num_trials++;
 		statistics_.num_expanded_nodes++;
-	} while ((double) (clock() - begin) / CLOCKS_PER_SEC
-		< Globals::config.time_per_move
+	} while ((Globals::config.max_trials > 0 ?
+		statistics_.num_trials < Globals::config.max_trials :
+		(double) (clock() - begin) / CLOCKS_PER_SEC
+			< Globals::config.time_per_move)
 		&& (root_->upper_bound() - root_->lower_bound()) > 1e-6);
 
 	statistics_.num_tree_particles = model_->NumActiveParticles()
@@ -65,6 +78,12 @@ ValuedAction AEMS::Search() {
 	logi << "[AEMS::Search]" << statistics_ << endl;
 
 	ValuedAction astar = OptimalAction(root_);
+	if (TreeExport::enabled())
+		TreeExport::Export("AEMS", root_);
+	if (SearchTrace::enabled()) {
+		SearchTrace::Decision("AEMS", astar, statistics_,
+			get_time_second() - start_real);
+	}
 	//delete root_;
 	return astar;
 }
@@ -81,39 +100,47 @@ ValuedAction AEMS::OptimalAction(const VNode* vnode) {
 }
 
 VNode* AEMS::FindMaxApproxErrorLeaf(VNode* root) {
-	double bestAE = Globals::NEG_INFTY;
-	VNode* bestNode = NULL;
-	FindMaxApproxErrorLeaf(root, 1.0, bestAE, bestNode);
-	return bestNode;
+	return root->approx_error_leaf();
 }
 
-void AEMS::FindMaxApproxErrorLeaf(VNode* vnode, double likelihood,
-	double& bestAE, VNode*& bestNode) {
+/**
+ * Recomputes the leaf with the largest approximation error below vnode,
+ * assuming that those of its children are up to date. The error of a leaf is
+ * its likelihood times its discounted gap, times the likelihood of the
+ * actions on the path to it, which is zero unless they have the largest
+ * upper bound (AEMS2). Bounds only change on the path of a backup, so
+ * recomputing the nodes on that path keeps the whole tree up to date, and
+ * the leaf to expand next is read off the root.
+ */
+void AEMS::UpdateApproxError(VNode* vnode) {
 	if (vnode->IsLeaf()) {
-		double curAE = likelihood * vnode->likelihood * Globals::Discount(vnode->depth())
-			* (vnode->upper_bound() - vnode->lower_bound());
-		if (curAE > bestAE) {
-			bestAE = curAE;
-			bestNode = vnode;
-		}
-	} else {
-		for (int a = 0; a < vnode->children().size(); a++) {
-			FindMaxApproxErrorLeaf(vnode->Child(a), likelihood, bestAE,
-				bestNode);
-		}
+		vnode->approx_error(vnode->likelihood()
+			* Globals::Discount(vnode->depth())
+			* (vnode->upper_bound() - vnode->lower_bound()));
+		vnode->approx_error_leaf(vnode);
+		return;
 	}
-}
 
-void AEMS::FindMaxApproxErrorLeaf(QNode* qnode, double likelihood,
-	double& bestAE, VNode*& bestNode) {
-	likelihood *= Likelihood(qnode);
+	double best_error = Globals::NEG_INFTY;
+	VNode* best_leaf = NULL;
+	for (ACT_TYPE action = 0; action < vnode->children().size(); action++) {
+		QNode* qnode = vnode->Child(action);
+		double likelihood = Likelihood(qnode);
 
-	map<OBS_TYPE, VNode*>& children = qnode->children();
-	for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+		ObsChildren& children = qnode->children();
+		for (ObsChildren::iterator it = children.begin();
 			it != children.end(); it++) {
-		VNode* vnode = it->second;
-		FindMaxApproxErrorLeaf(vnode, likelihood, bestAE, bestNode);
+			VNode* child = it->second;
+			double error = likelihood * child->approx_error();
+			if (error > best_error) {
+				best_error = error;
+				best_leaf = child->approx_error_leaf();
+			}
+		}
 	}
+
+	vnode->approx_error(best_error);
+	vnode->approx_error_leaf(best_leaf);
 }
 
 double AEMS::Likelihood(QNode* qnode) {
@@ -157,13 +184,13 @@ void AEMS::Update(QNode* qnode) {
 	double lower = qnode->step_reward;
 	double upper = qnode->step_reward;
 
-	map<OBS_TYPE, VNode*>& children = qnode->children();
-	for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+	ObsChildren& children = qnode->children();
+	for (ObsChildren::iterator it = children.begin();
 			it != children.end(); it++) {
 		VNode* vnode = it->second;
 
-		lower += Globals::Discount() * vnode->likelihood * vnode->lower_bound();
-		upper += Globals::Discount() * vnode->likelihood * vnode->upper_bound();
+		lower += Globals::Discount() * vnode->likelihood() * vnode->lower_bound();
+		upper += Globals::Discount() * vnode->likelihood() * vnode->upper_bound();
 	}
 
 	if (lower > qnode->lower_bound())
@@ -179,6 +206,7 @@ void AEMS::Backup(VNode* vnode) {
 		logd << " Iter " << (iter++) << " " << vnode << endl;
 
 		Update(vnode);
+		UpdateApproxError(vnode);
 		logd << " Updated vnode " << vnode << endl;
 
 		QNode* parentq = vnode->parent();
@@ -224,7 +252,7 @@ void AEMS::Expand(QNode* qnode, BeliefLowerBound* lb, BeliefUpperBound* ub,
 	const BeliefMDP* model, History& history) {
 	VNode* parent = qnode->parent();
 	ACT_TYPE action = qnode->edge();
-	map<OBS_TYPE, VNode*>& children = qnode->children();
+	ObsChildren& children = qnode->children();
 
 	const Belief* belief = parent->belief();
 	// cout << *belief << endl;
@@ -232,25 +260,28 @@ void AEMS::Expand(QNode* qnode, BeliefLowerBound* lb, BeliefUpperBound* ub,
 	double step_reward = model->StepReward(belief, qnode->edge());
 
 	map<OBS_TYPE, double> obss;
-	model->Observe(belief, qnode->edge(), obss);
+	map<OBS_TYPE, Belief*> successors;
+	model->Successors(belief, action, obss, successors);
 
 	double lower_bound = step_reward;
 	double upper_bound = step_reward;
 
 	// Create new belief nodes
+	children.reserve(obss.size());
 	for (map<OBS_TYPE, double>::iterator it = obss.begin(); it != obss.end(); it++) {
 		OBS_TYPE obs = it->first;
 		double weight = it->second;
 		logd << "[AEMS::Expand] Creating node for obs " << obs
 			<< " with weight " << weight << endl;
-		VNode* vnode = new VNode(model->Tau(belief, action, obs),
-			parent->depth() + 1, qnode, obs);
-		vnode->likelihood = weight;
+		VNode* vnode = new VNode(successors[obs], parent->depth() + 1, qnode,
+			obs);
+		vnode->likelihood(weight);
 		logd << " New node created!" << endl;
 		children[obs] = vnode;
 
 		InitLowerBound(vnode, lb, history);
 		InitUpperBound(vnode, ub, history);
+		UpdateApproxError(vnode);
 
 		lower_bound += weight * Globals::Discount() * vnode->lower_bound();
 		upper_bound += weight * Globals::Discount() * vnode->upper_bound();
@@ -270,8 +301,9 @@ void AEMS::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs) {
 		root_->Child(action)->children().erase(obs);
 		delete root_;
 		root_ = node;
-		root_->likelihood = 1.0;
+		root_->likelihood(1.0);
 		root_->parent(NULL);
+		UpdateApproxError(root_);
 
 		belief_ = root_->belief();
 	} else {
@@ -1,5 +1,8 @@
 #include <despot/core/builtin_upper_bounds.h>
 #include <despot/core/builtin_lower_bounds.h>
+#include <despot/core/bound_cache.h>
+#include <despot/core/search_trace.h>
+#include <despot/core/tree_export.h>
 
 #include <despot/solver/despot.h>
 #include <despot/solver/pomcp.h>
@@ -12,11 +15,17 @@ DESPOT::DESPOT(const DSPOMDP* model, ScenarioLowerBound* lb, ScenarioUpperBound*
 	Solver(model, belief),
 	root_(NULL), 
 	lower_bound_(lb),
-	upper_bound_(ub) {
+	upper_bound_(ub),
+	observations_action_(-1),
+	streams_(NULL),
+	retained_action_(-1),
+	reused_root_(NULL),
+	restored_streams_(NULL) {
 	assert(model != NULL);
 }
 
 DESPOT::~DESPOT() {
+	DiscardSubtrees();
 }
 
 ScenarioLowerBound* DESPOT::lower_bound() const {
@@ -29,7 +38,8 @@ ScenarioUpperBound* DESPOT::upper_bound() const {
 
 VNode* DESPOT::Trial(VNode* root, RandomStreams& streams,
 	ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
-	const DSPOMDP* model, History& history, SearchStatistics* statistics) {
+	const DSPOMDP* model, History& history, SearchStatistics* statistics,
+	TranspositionTable* transpositions) {
 	VNode* cur = root;
 
 	int hist_size = history.Size();
@@ -47,14 +57,29 @@ VNode* DESPOT::Trial(VNode* root, RandomStreams& streams,
 		}
 
 		if (cur->IsLeaf()) {
+			if (cur->recycled()) {
+				break;
+			}
+
 			double start = clock();
-			Expand(cur, lower_bound, upper_bound, model, streams, history);
+			int num_merged = transpositions != NULL ?
+				transpositions->num_merged() : 0;
+			int num_particles = Expand(cur, lower_bound, upper_bound, model,
+				streams, history, transpositions);
 
 			if (statistics != NULL) {
 				statistics->time_node_expansion += (double) (clock() - start)
 					/ CLOCKS_PER_SEC;
 				statistics->num_expanded_nodes++;
-				statistics->num_tree_particles += cur->particles().size();
+				statistics->num_tree_particles += num_particles;
+				for (ACT_TYPE a = 0; a < cur->children().size(); a++) {
+					statistics->num_tree_nodes +=
+						cur->Child(a)->children().size();
+				}
+				if (transpositions != NULL) {
+					statistics->num_tree_nodes -= transpositions->num_merged()
+						- num_merged;
+				}
 			}
 		}
 
@@ -70,8 +95,20 @@ VNode* DESPOT::Trial(VNode* root, RandomStreams& streams,
 			break;
 		}
 
+		OBS_TYPE obs = next->edge();
+		if (!next->IsChildOf(qstar)) { // Shared node, find the edge taken
+			ObsChildren& children = qstar->children();
+			for (ObsChildren::iterator it = children.begin();
+				it != children.end(); it++) {
+				if (it->second == next) {
+					obs = it->first;
+					break;
+				}
+			}
+		}
+
 		cur = next;
-		history.Add(qstar->edge(), cur->edge());
+		history.Add(qstar->edge(), obs);
 	} while (cur->depth() < Globals::config.search_depth && WEU(cur) > 0);
 
 	history.Truncate(hist_size);
@@ -95,9 +132,9 @@ void DESPOT::ExploitBlockers(VNode* vnode) {
 				cur->upper_bound(value);
 				cur->utility_upper_bound = value;
 			} else {
-				const map<OBS_TYPE, VNode*>& siblings =
+				const ObsChildren& siblings =
 					cur->parent()->children();
-				for (map<OBS_TYPE, VNode*>::const_iterator it = siblings.begin();
+				for (ObsChildren::const_iterator it = siblings.begin();
 					it != siblings.end(); it++) {
 					VNode* node = it->second;
 					double value = node->default_move().value;
@@ -124,10 +161,6 @@ VNode* DESPOT::ConstructTree(vector<State*>& particles, RandomStreams& streams,
 	ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
 	const DSPOMDP* model, History& history, double timeout,
 	SearchStatistics* statistics) {
-	if (statistics != NULL) {
-		statistics->num_particles_before_search = model->NumActiveParticles();
-	}
-
 	for (int i = 0; i < particles.size(); i++) {
 		particles[i]->scenario_id = i;
 	}
@@ -140,40 +173,109 @@ VNode* DESPOT::ConstructTree(vector<State*>& particles, RandomStreams& streams,
 	logd
 		<< "[DESPOT::ConstructTree] END - Initializing lower and upper bounds at the root node.";
 
-	if (statistics != NULL) {
-		statistics->initial_lb = root->lower_bound();
-		statistics->initial_ub = root->upper_bound();
+	GrowTree(root, streams, lower_bound, upper_bound, model, history, timeout,
+		statistics);
+	return root;
+}
+
+void DESPOT::GrowTree(VNode* root, RandomStreams& streams,
+	ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
+	const DSPOMDP* model, History& history, double timeout,
+	SearchStatistics* statistics) {
+	// Trials count the particles they add to the tree, which the particle
+	// budget needs even when the caller does not collect statistics
+	SearchStatistics trial_statistics;
+	if (statistics == NULL) {
+		statistics = &trial_statistics;
 	}
+	statistics->num_particles_before_search = model->NumActiveParticles();
+	statistics->num_tree_nodes = root->Size();
+	statistics->num_tree_particles = NumTreeParticles(root);
+
+	TranspositionTable* transpositions = NULL;
+	if (Globals::config.merge_transpositions) {
+		transpositions = new TranspositionTable(model);
+	}
+
+	statistics->initial_lb = root->lower_bound();
+	statistics->initial_ub = root->upper_bound();
 
 	double used_time = 0;
 	int num_trials = 0;
+	bool out_of_memory = false;
 	do {
+		int num_expanded = statistics->num_expanded_nodes;
+		double trial_start = used_time;
+
 		double start = clock();
-		VNode* cur = Trial(root, streams, lower_bound, upper_bound, model, history, statistics);
+		VNode* cur = Trial(root, streams, lower_bound, upper_bound, model,
+			history, statistics, transpositions);
 		used_time += double(clock() - start) / CLOCKS_PER_SEC;
 
 		start = clock();
 		Backup(cur);
-		if (statistics != NULL) {
-			statistics->time_backup += double(clock() - start) / CLOCKS_PER_SEC;
-		}
+		statistics->time_backup += double(clock() - start) / CLOCKS_PER_SEC;
 		used_time += double(clock() - start) / CLOCKS_PER_SEC;
 
+		if (SearchTrace::trials_enabled()) {
+			SearchTrace::Trial(num_trials, cur->depth(), used_time - trial_start,
+				statistics->num_expanded_nodes - num_expanded,
+				root->lower_bound(), root->upper_bound());
+		}
+
 		num_trials++;
-	} while (used_time * (num_trials + 1.0) / num_trials < timeout
-		&& (root->upper_bound() - root->lower_bound()) > 1e-6);
 
-	if (statistics != NULL) {
-		statistics->num_particles_after_search = model->NumActiveParticles();
-		statistics->num_policy_nodes = root->PolicyTreeSize();
-		statistics->num_tree_nodes = root->Size();
-		statistics->final_lb = root->lower_bound();
-		statistics->final_ub = root->upper_bound();
-		statistics->time_search = used_time;
-		statistics->num_trials = num_trials;
+		statistics->peak_tree_nodes = max(statistics->peak_tree_nodes,
+			statistics->num_tree_nodes);
+		statistics->peak_tree_particles = max(statistics->peak_tree_particles,
+			statistics->num_tree_particles);
+
+		// Over budget, make room for the next trials by freeing first the
+		// subtrees whose bounds have closed, then those off the actions with
+		// the best upper bound, and then all but the path the next trial
+		// follows. Collapsed nodes keep their particles and bounds, and are
+		// expanded again if trials come back to them.
+		int max_particles = Globals::config.max_tree_particles;
+		for (int stage = 0; max_particles > 0
+			&& statistics->num_tree_particles > max_particles && stage < 3;
+			stage++) {
+			int num_particles = model->NumActiveParticles();
+			int num_recycled = stage == 0 ? RecycleClosedSubtrees(root, model)
+				: CollapseSubtrees(root, model, stage == 1);
+			statistics->num_recycled_nodes += num_recycled;
+			statistics->num_tree_nodes -= num_recycled;
+			statistics->num_tree_particles -= num_particles
+				- model->NumActiveParticles();
+
+			// Even the path of the next trial does not fit, so no trial can
+			// expand a node and change a bound any more
+			if (stage == 2
+				&& statistics->num_tree_particles > max_particles) {
+				logi << "[DESPOT::GrowTree] Particle budget of "
+					<< max_particles << " too small for the path of the "
+					<< "next trial, stopping after " << num_trials
+					<< " trials" << endl;
+				out_of_memory = true;
+			}
+		}
+	} while ((Globals::config.max_trials > 0 ?
+		num_trials < Globals::config.max_trials :
+		used_time * (num_trials + 1.0) / num_trials < timeout)
+		&& (root->upper_bound() - root->lower_bound()) > 1e-6
+		&& !out_of_memory && !interrupted());
+
+	statistics->num_particles_after_search = model->NumActiveParticles();
+	statistics->num_policy_nodes = root->PolicyTreeSize();
+	statistics->num_tree_nodes = root->Size();
+	statistics->final_lb = root->lower_bound();
+	statistics->final_ub = root->upper_bound();
+	statistics->time_search = used_time;
+	statistics->num_trials = num_trials;
+	if (transpositions != NULL) {
+		statistics->num_merged_nodes = transpositions->num_merged();
 	}
 
-	return root;
+	delete transpositions;
 }
 
 void DESPOT::Compare() {
@@ -225,47 +327,98 @@ ValuedAction DESPOT::Search() {
 		model_->PrintBelief(*belief_);
 	}
 
-	if (Globals::config.time_per_move <= 0) // Return a random action if no time is allocated for planning
+	observations_.clear();
+	observations_action_ = -1;
+
+	if (Globals::config.time_per_move <= 0 && Globals::config.max_trials <= 0) { // Return a random action if no time is allocated for planning
+		DiscardSubtrees();
 		return ValuedAction(Random::RANDOM.NextInt(model_->NumActions()),
 			Globals::NEG_INFTY);
+	}
 
-	double start = get_time_second();
-	vector<State*> particles = belief_->Sample(Globals::config.num_scenarios);
-	logi << "[DESPOT::Search] Time for sampling " << particles.size()
-		<< " particles: " << (get_time_second() - start) << "s" << endl;
+	double search_start = get_time_second();
+	double start = search_start;
+	vector<State*> particles;
+	if (reused_root_ == NULL) {
+		particles = belief_->Sample(Globals::config.num_scenarios);
+		logi << "[DESPOT::Search] Time for sampling " << particles.size()
+			<< " particles: " << (get_time_second() - start) << "s" << endl;
+	}
 
 	statistics_ = SearchStatistics();
 
 	start = get_time_second();
 	static RandomStreams streams = RandomStreams(Globals::config.num_scenarios,
 		Globals::config.search_depth);
+	streams_ = &streams;
+	if (restored_streams_ != NULL) {
+		// The bounds of a restored subtree were computed on its own streams
+		streams = *restored_streams_;
+		delete restored_streams_;
+		restored_streams_ = NULL;
+		lower_bound_->Init(streams);
+		upper_bound_->Init(streams);
+	}
+
+	ScenarioUpperBound* base_upper_bound = upper_bound_;
+	CachedScenarioUpperBound* cached_upper_bound =
+		dynamic_cast<CachedScenarioUpperBound*>(upper_bound_);
+	if (cached_upper_bound != NULL) {
+		base_upper_bound = cached_upper_bound->bound();
+		cached_upper_bound->cache()->ResetStatistics();
+	}
 
-	LookaheadUpperBound* ub = dynamic_cast<LookaheadUpperBound*>(upper_bound_);
-	if (ub != NULL) { // Avoid using new streams for LookaheadUpperBound
-		static bool initialized = false;
-		if (!initialized ) {
+	LookaheadUpperBound* ub = dynamic_cast<LookaheadUpperBound*>(
+		base_upper_bound);
+	if (reused_root_ != NULL) {
+		// The streams were shifted and the bounds initialized on them when the
+		// subtree was retained
+		root_ = reused_root_;
+		reused_root_ = NULL;
+		logi << "[DESPOT::Search] Reusing a subtree of " << root_->Size()
+			<< " nodes with " << root_->particles().size() << " particles"
+			<< endl;
+		GrowTree(root_, streams, lower_bound_, upper_bound_, model_, history_,
+			Globals::config.time_per_move, &statistics_);
+	} else {
+		if (ub != NULL) { // Avoid using new streams for LookaheadUpperBound
+			static bool initialized = false;
+			if (!initialized ) {
+				lower_bound_->Init(streams);
+				upper_bound_->Init(streams);
+				initialized = true;
+			}
+		} else {
+			streams = RandomStreams(Globals::config.num_scenarios,
+				Globals::config.search_depth);
 			lower_bound_->Init(streams);
 			upper_bound_->Init(streams);
-			initialized = true;
 		}
-	} else {
-		streams = RandomStreams(Globals::config.num_scenarios,
-			Globals::config.search_depth);
-		lower_bound_->Init(streams);
-		upper_bound_->Init(streams);
-	}
 
-	root_ = ConstructTree(particles, streams, lower_bound_, upper_bound_,
-		model_, history_, Globals::config.time_per_move, &statistics_);
+		root_ = ConstructTree(particles, streams, lower_bound_, upper_bound_,
+			model_, history_, Globals::config.time_per_move, &statistics_);
+	}
+	if (cached_upper_bound != NULL) {
+		statistics_.num_bound_cache_lookups =
+			cached_upper_bound->cache()->lookups();
+		statistics_.num_bound_cache_hits = cached_upper_bound->cache()->hits();
+	}
 	logi << "[DESPOT::Search] Time for tree construction: "
 		<< (get_time_second() - start) << "s" << endl;
 
+	ValuedAction astar = OptimalAction(root_);
+	if (TreeExport::enabled())
+		TreeExport::Export("DESPOT", root_, SearchTrace::speculative());
+	RecordObservations(astar.action);
+	// LookaheadUpperBound precomputes on its streams, which cannot be shifted
+	if (ReusesTree() && ub == NULL)
+		RetainSubtrees(astar.action);
+
 	start = get_time_second();
 	root_->Free(*model_);
 	logi << "[DESPOT::Search] Time for freeing particles in search tree: "
 		<< (get_time_second() - start) << "s" << endl;
 
-	ValuedAction astar = OptimalAction(root_);
 	start = get_time_second();
 	delete root_;
 
@@ -274,6 +427,11 @@ ValuedAction DESPOT::Search() {
 	logi << "[DESPOT::Search] Search statistics:" << endl << statistics_
 		<< endl;
 
+	if (SearchTrace::enabled()) {
+		SearchTrace::Decision("DESPOT", astar, statistics_,
+			get_time_second() - search_start);
+	}
+
 	return astar;
 }
 
@@ -439,8 +597,8 @@ VNode* DESPOT::Prune(VNode* vnode, ACT_TYPE& pruned_action, double& pruned_value
 QNode* DESPOT::Prune(QNode* qnode, double& pruned_value) {
 	QNode* pruned_q = new QNode((VNode*) NULL, qnode->edge());
 	pruned_value = qnode->step_reward - Globals::config.pruning_constant;
-	map<OBS_TYPE, VNode*>& children = qnode->children();
-	for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+	ObsChildren& children = qnode->children();
+	for (ObsChildren::iterator it = children.begin();
 		it != children.end(); it++) {
 		ACT_TYPE astar;
 		double nu;
@@ -496,15 +654,15 @@ double DESPOT::WEU(VNode* vnode, double xi) {
 VNode* DESPOT::SelectBestWEUNode(QNode* qnode) {
 	double weustar = Globals::NEG_INFTY;
 	VNode* vstar = NULL;
-	map<OBS_TYPE, VNode*>& children = qnode->children();
-	for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+	ObsChildren& children = qnode->children();
+	for (ObsChildren::iterator it = children.begin();
 		it != children.end(); it++) {
 		VNode* vnode = it->second;
 
 		double weu = WEU(vnode);
 		if (weu >= weustar) {
 			weustar = weu;
-			vstar = vnode->vstar;
+			vstar = vnode;
 		}
 	}
 	return vstar;
@@ -559,8 +717,8 @@ void DESPOT::Update(QNode* qnode) {
 	double utility_upper = qnode->step_reward
 		+ Globals::config.pruning_constant;
 
-	map<OBS_TYPE, VNode*>& children = qnode->children();
-	for (map<OBS_TYPE, VNode*>::iterator it = children.begin();
+	ObsChildren& children = qnode->children();
+	for (ObsChildren::iterator it = children.begin();
 		it != children.end(); it++) {
 		VNode* vnode = it->second;
 
@@ -586,6 +744,11 @@ void DESPOT::Backup(VNode* vnode) {
 	while (true) {
 		logd << " Iter " << iter << " " << vnode << endl;
 
+		if (vnode->other_parents().size() > 0) {
+			BackupShared(vnode);
+			break;
+		}
+
 		Update(vnode);
 
 		QNode* parentq = vnode->parent();
@@ -603,6 +766,139 @@ void DESPOT::Backup(VNode* vnode) {
 	logd << "* Backup complete!" << endl;
 }
 
+/**
+ * Backs up the bounds of a node shared by several parents along all paths to
+ * the root. Nodes are updated one depth at a time, so that each ancestor is
+ * updated once, after all of its updated descendants.
+ */
+void DESPOT::BackupShared(VNode* vnode) {
+	vector<VNode*> vnodes(1, vnode);
+	vector<QNode*> qnodes;
+	while (vnodes.size() > 0) {
+		qnodes.clear();
+		for (int i = 0; i < vnodes.size(); i++) {
+			VNode* cur = vnodes[i];
+			Update(cur);
+
+			if (cur->parent() != NULL) {
+				qnodes.push_back(cur->parent());
+			}
+			qnodes.insert(qnodes.end(), cur->other_parents().begin(),
+				cur->other_parents().end());
+		}
+		sort(qnodes.begin(), qnodes.end());
+		qnodes.erase(unique(qnodes.begin(), qnodes.end()), qnodes.end());
+
+		vnodes.clear();
+		for (int i = 0; i < qnodes.size(); i++) {
+			Update(qnodes[i]);
+			vnodes.push_back(qnodes[i]->parent());
+		}
+		sort(vnodes.begin(), vnodes.end());
+		vnodes.erase(unique(vnodes.begin(), vnodes.end()), vnodes.end());
+	}
+}
+
+/**
+ * Deletes the subtrees below descendants of vnode whose bounds have closed,
+ * freeing their particles back to the model. Such nodes are flagged as
+ * recycled so that Trial never expands them again, and as they keep their
+ * bounds, backups are unaffected. Returns the number of belief nodes deleted.
+ */
+int DESPOT::RecycleClosedSubtrees(VNode* vnode, const DSPOMDP* model) {
+	int num_recycled = 0;
+	for (ACT_TYPE action = 0; action < vnode->children().size(); action++) {
+		ObsChildren& children = vnode->Child(action)->children();
+		for (ObsChildren::iterator it = children.begin();
+			it != children.end(); it++) {
+			VNode* child = it->second;
+			if (child->IsLeaf())
+				continue;
+
+			if (child->upper_bound() - child->lower_bound() > 1e-6) {
+				num_recycled += RecycleClosedSubtrees(child, model);
+				continue;
+			}
+
+			num_recycled += Collapse(child, model);
+			child->recycled(true);
+		}
+	}
+	return num_recycled;
+}
+
+/**
+ * Collapses the expanded descendants of vnode that are off the actions with
+ * the best upper bound, and if keep_best_action is false, also those below
+ * such an action other than the child with the largest WEU, leaving only the
+ * path the next trial follows. Returns the number of belief nodes deleted.
+ */
+int DESPOT::CollapseSubtrees(VNode* vnode, const DSPOMDP* model,
+	bool keep_best_action) {
+	if (vnode->IsLeaf())
+		return 0;
+
+	QNode* qstar = SelectBestUpperBoundNode(vnode);
+	VNode* next = SelectBestWEUNode(qstar);
+
+	int num_collapsed = 0;
+	for (ACT_TYPE action = 0; action < vnode->children().size(); action++) {
+		QNode* qnode = vnode->Child(action);
+		ObsChildren& children = qnode->children();
+		for (ObsChildren::iterator it = children.begin();
+			it != children.end(); it++) {
+			VNode* child = it->second;
+			if (child->IsLeaf() || !child->IsChildOf(qnode))
+				continue;
+
+			if (qnode == qstar && (keep_best_action || child == next)) {
+				num_collapsed += CollapseSubtrees(child, model,
+					keep_best_action);
+			} else {
+				num_collapsed += Collapse(child, model);
+			}
+		}
+	}
+	return num_collapsed;
+}
+
+/**
+ * Turns vnode back into a leaf that keeps its particles and bounds, freeing
+ * the particles of its descendants. Returns the number of belief nodes
+ * deleted.
+ */
+int DESPOT::Collapse(VNode* vnode, const DSPOMDP* model) {
+	int num_collapsed = vnode->Size() - 1;
+	vector<QNode*>& qnodes = vnode->children();
+	for (ACT_TYPE a = 0; a < qnodes.size(); a++) {
+		ObsChildren& children = qnodes[a]->children();
+		for (ObsChildren::iterator it = children.begin();
+			it != children.end(); it++) {
+			it->second->Free(*model);
+		}
+		delete qnodes[a];
+	}
+	qnodes.clear();
+	return num_collapsed;
+}
+
+/**
+ * Returns the number of particles held by the belief nodes of the tree rooted
+ * at vnode.
+ */
+int DESPOT::NumTreeParticles(VNode* vnode) {
+	int num_particles = vnode->particles().size();
+	for (ACT_TYPE a = 0; a < vnode->children().size(); a++) {
+		ObsChildren& children = vnode->Child(a)->children();
+		for (ObsChildren::iterator it = children.begin();
+			it != children.end(); it++) {
+			if (it->second->IsChildOf(vnode->Child(a)))
+				num_particles += NumTreeParticles(it->second);
+		}
+	}
+	return num_particles;
+}
+
 VNode* DESPOT::FindBlocker(VNode* vnode) {
 	VNode* cur = vnode;
 	int count = 1;
@@ -621,29 +917,92 @@ VNode* DESPOT::FindBlocker(VNode* vnode) {
 	return cur;
 }
 
-void DESPOT::Expand(VNode* vnode,
+/**
+ * Expands vnode and returns the number of particles of the belief nodes it
+ * adds to the tree, counted before --replay-particles frees them.
+ */
+int DESPOT::Expand(VNode* vnode,
 	ScenarioLowerBound* lower_bound, ScenarioUpperBound* upper_bound,
 	const DSPOMDP* model, RandomStreams& streams,
-	History& history) {
+	History& history, TranspositionTable* transpositions) {
+	bool replay = Globals::config.replay_particles && vnode->parent() != NULL;
+	if (replay) {
+		vnode->particles(ReplayParticles(vnode, model, streams));
+	}
+
 	vector<QNode*>& children = vnode->children();
+	children.reserve(model->NumActions());
+	int num_particles = 0;
 	logd << "- Expanding vnode " << vnode << endl;
 	for (ACT_TYPE action = 0; action < model->NumActions(); action++) {
 		logd << " Action " << action << endl;
 		QNode* qnode = new QNode(vnode, action);
 		children.push_back(qnode);
 
-		Expand(qnode, lower_bound, upper_bound, model, streams, history);
+		num_particles += Expand(qnode, lower_bound, upper_bound, model,
+			streams, history, transpositions);
+	}
+
+	if (replay) {
+		vnode->FreeParticles(*model);
 	}
 	logd << "* Expansion complete!" << endl;
+	return num_particles;
+}
+
+/**
+ * Regenerates the particles of a node whose particles were freed by stepping
+ * copies of the root particles along the path to the node, using the same
+ * random numbers as during expansion, and keeping those that produce the
+ * observations on the path.
+ */
+vector<State*> DESPOT::ReplayParticles(VNode* vnode, const DSPOMDP* model,
+	const RandomStreams& streams) {
+	vector<VNode*> path;
+	VNode* root = vnode;
+	while (root->parent() != NULL) {
+		path.push_back(root);
+		root = root->parent()->parent();
+	}
+
+	vector<State*> particles;
+	for (int i = 0; i < root->particles().size(); i++) {
+		particles.push_back(model->Copy(root->particles()[i]));
+	}
+
+	vector<State*> next;
+	for (int i = path.size() - 1; i >= 0; i--) {
+		QNode* qnode = path[i]->parent();
+		int depth = qnode->parent()->depth();
+
+		next.clear();
+		for (int j = 0; j < particles.size(); j++) {
+			State* particle = particles[j];
+			double reward;
+			OBS_TYPE obs;
+			bool terminal = model->Step(*particle,
+				streams.Entry(particle->scenario_id, depth), qnode->edge(),
+				reward, obs);
+
+			if (!terminal && obs == path[i]->edge()) {
+				next.push_back(particle);
+			} else {
+				model->Free(particle);
+			}
+		}
+		particles.swap(next);
+	}
+
+	return particles;
 }
 
-void DESPOT::Expand(QNode* qnode, ScenarioLowerBound* lb,
+int DESPOT::Expand(QNode* qnode, ScenarioLowerBound* lb,
 	ScenarioUpperBound* ub, const DSPOMDP* model,
 	RandomStreams& streams,
-	History& history) {
+	History& history, TranspositionTable* transpositions) {
 	VNode* parent = qnode->parent();
 	streams.position(parent->depth());
-	map<OBS_TYPE, VNode*>& children = qnode->children();
+	ObsChildren& children = qnode->children();
 
 	const vector<State*>& particles = parent->particles();
 
@@ -680,20 +1039,49 @@ void DESPOT::Expand(QNode* qnode, ScenarioLowerBound* lb,
 
 	double lower_bound = step_reward;
 	double upper_bound = step_reward;
+	int num_particles = 0;
 
 	// Create new belief nodes
+	children.reserve(partitions.size());
 	for (map<OBS_TYPE, vector<State*> >::iterator it = partitions.begin();
 		it != partitions.end(); it++) {
 		OBS_TYPE obs = it->first;
+
+		uint64_t key = 0;
+		if (transpositions != NULL) {
+			key = transpositions->Key(it->second, parent->depth() + 1);
+			VNode* vnode = transpositions->Find(key, it->second);
+			if (vnode != NULL) {
+				logd << " Sharing node " << vnode << " for obs " << obs << endl;
+				for (int i = 0; i < it->second.size(); i++) {
+					model->Free(it->second[i]);
+				}
+				vnode->AddParent(qnode);
+				children[obs] = vnode;
+
+				lower_bound += vnode->lower_bound();
+				upper_bound += vnode->upper_bound();
+				continue;
+			}
+		}
+
 		logd << " Creating node for obs " << obs << endl;
 		VNode* vnode = new VNode(partitions[obs], parent->depth() + 1,
 			qnode, obs);
 		logd << " New node created!" << endl;
 		children[obs] = vnode;
+		num_particles += vnode->particles().size();
+		if (transpositions != NULL) {
+			transpositions->Insert(key, vnode);
+		}
 
 		history.Add(qnode->edge(), obs);
 		InitBounds(vnode, lb, ub, streams, history);
 		history.RemoveLast();
+
+		if (Globals::config.replay_particles) {
+			vnode->FreeParticles(*model);
+		}
 		logd << " New node's bounds: (" << vnode->lower_bound() << ", "
 			<< vnode->upper_bound() << ")" << endl;
 
@@ -707,6 +1095,7 @@ void DESPOT::Expand(QNode* qnode, ScenarioLowerBound* lb,
 	qnode->utility_upper_bound = upper_bound + Globals::config.pruning_constant;
 
 	qnode->default_value = lower_bound; // for debugging
+	return num_particles;
 }
 
 ValuedAction DESPOT::Evaluate(VNode* root, vector<State*>& particles,
@@ -747,7 +1136,7 @@ ValuedAction DESPOT::Evaluate(VNode* root, vector<State*>& particles,
 
 				if (cur != NULL && !cur->IsLeaf()) {
 					QNode* qnode = cur->Child(action);
-					map<OBS_TYPE, VNode*>& vnodes = qnode->children();
+					ObsChildren& vnodes = qnode->children();
 					cur = vnodes.find(obs) != vnodes.end() ? vnodes[obs] : NULL;
 				}
 			} else {
@@ -772,6 +1161,8 @@ void DESPOT::belief(Belief* b) {
 	logi << "[DESPOT::belief] Start: Set initial belief." << endl;
 	belief_ = b;
 	history_.Truncate(0);
+	observations_.clear();
+	DiscardSubtrees();
 
 	//lower_bound_->belief(b); // needed for POMCPScenarioLowerBound
 	logi << "[DESPOT::belief] End: Set initial belief." << endl;
@@ -782,6 +1173,19 @@ void DESPOT::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs) {
 
 	belief_->Update(action, obs);
 	history_.Add(action, obs);
+	observations_.clear();
+
+	// Keep the subtree of the received observation for the next search
+	VNode* reused_root = NULL;
+	for (int i = 0; i < retained_.size(); i++) {
+		if (action == retained_action_ && retained_[i].obs == obs) {
+			reused_root = retained_[i].root;
+			retained_.erase(retained_.begin() + i);
+			break;
+		}
+	}
+	DiscardSubtrees();
+	reused_root_ = reused_root;
 
 	//lower_bound_->belief(belief_);
 
@@ -790,4 +1194,223 @@ void DESPOT::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs) {
 		<< " in " << (get_time_second() - start) << "s" << endl;
 }
 
+void DESPOT::RecordObservations(ACT_TYPE action) {
+	observations_action_ = action;
+	observations_.clear();
+	if (action < 0 || action >= root_->children().size()
+		|| root_->Weight() <= 0)
+		return;
+
+	ObsChildren& children = root_->Child(action)->children();
+	for (ObsChildren::iterator it = children.begin(); it != children.end();
+		it++) {
+		observations_.push_back(make_pair(it->first,
+			it->second->Weight() / root_->Weight()));
+	}
+	SortObservations(observations_);
+}
+
+void DESPOT::PredictObservations(ACT_TYPE action,
+	vector<pair<OBS_TYPE, double> >& obss) {
+	if (action == observations_action_ && !observations_.empty())
+		obss = observations_;
+	else
+		Solver::PredictObservations(action, obss);
+}
+
+/**
+ * A DESPOT tree is rebuilt by every search, so searching from another belief
+ * only needs the belief and history to be swapped in and out. The
+ * observations recorded by the search belong to the speculation.
+ */
+bool DESPOT::Speculate(ACT_TYPE action, OBS_TYPE obs,
+	Speculation& speculation) {
+	// Retained subtrees are refined instead
+	if (ReusesTree())
+		return false;
+
+	Belief* belief = belief_->MakeCopy();
+	if (belief == NULL)
+		return false;
+	belief->Update(action, obs);
+
+	Belief* current = belief_;
+	ACT_TYPE observations_action = observations_action_;
+	vector<pair<OBS_TYPE, double> > observations;
+	observations.swap(observations_);
+
+	belief_ = belief;
+	history_.Add(action, obs);
+	SearchTrace::speculative(true);
+	speculation.next_action = Search().action;
+	SearchTrace::speculative(false);
+	history_.RemoveLast();
+	belief_ = current;
+
+	speculation.action = action;
+	speculation.obs = obs;
+	speculation.belief = belief;
+	speculation.observations.swap(observations_);
+	observations_.swap(observations);
+	observations_action_ = observations_action;
+	return true;
+}
+
+void DESPOT::Commit(Speculation& speculation) {
+	Solver::Commit(speculation);
+	observations_.swap(speculation.observations);
+	observations_action_ = speculation.next_action;
+}
+
+bool DESPOT::ReusesTree() {
+	return Globals::config.reuse_tree;
+}
+
+/**
+ * Subtrees with too few particles to stand for the belief after their
+ * observation (a quarter of the scenarios) are not kept.
+ */
+void DESPOT::RetainSubtrees(ACT_TYPE action) {
+	DiscardSubtrees();
+	if (action < 0 || action >= root_->children().size())
+		return;
+
+	ObsChildren& children = root_->Child(action)->children();
+	for (ObsChildren::iterator it = children.begin(); it != children.end();
+		it++) {
+		VNode* vnode = it->second;
+		if (vnode->particles().size() * 4 < Globals::config.num_scenarios)
+			continue;
+
+		RetainedSubtree subtree = { it->first, vnode->Weight() / root_->Weight(),
+			vnode };
+		retained_.push_back(subtree);
+	}
+	if (retained_.empty())
+		return;
+
+	for (int i = 0; i < retained_.size(); i++) {
+		VNode* vnode = retained_[i].root;
+		children.erase(retained_[i].obs);
+		vnode->parent(NULL);
+		Rebase(vnode, 1.0 / (Globals::Discount() * vnode->Weight()),
+			1.0 / vnode->Weight());
+	}
+	retained_action_ = action;
+
+	streams_->Shift();
+	lower_bound_->Init(*streams_);
+	upper_bound_->Init(*streams_);
+}
+
+void DESPOT::DiscardSubtrees() {
+	for (int i = 0; i < retained_.size(); i++) {
+		retained_[i].root->Free(*model_);
+		delete retained_[i].root;
+	}
+	retained_.clear();
+	retained_action_ = -1;
+
+	if (reused_root_ != NULL) {
+		reused_root_->Free(*model_);
+		delete reused_root_;
+		reused_root_ = NULL;
+	}
+
+	delete restored_streams_;
+	restored_streams_ = NULL;
+}
+
+bool DESPOT::Save(CheckpointWriter& writer) const {
+	if (!Solver::Save(writer))
+		return false;
+
+	writer.WriteValue((int) (reused_root_ != NULL));
+	if (reused_root_ != NULL) {
+		writer.WriteStreams(
+			restored_streams_ != NULL ? *restored_streams_ : *streams_);
+		writer.WriteTree(reused_root_);
+	}
+	return writer.ok();
+}
+
+bool DESPOT::Restore(CheckpointReader& reader) {
+	DiscardSubtrees();
+
+	int has_root;
+	if (!Solver::Restore(reader) || !reader.ReadValue(has_root))
+		return false;
+	if (!has_root)
+		return true;
+
+	restored_streams_ = new RandomStreams(0, 0);
+	if (!reader.ReadStreams(*restored_streams_)
+		|| (reused_root_ = reader.ReadTree()) == NULL) {
+		DiscardSubtrees();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Moves a subtree one step up: depths decrease by one, and values and
+ * weights are scaled so that the subtree's particles have a total weight of
+ * one and its values are discounted from its root. Values are linear in the
+ * weights, so the bounds stay valid.
+ */
+void DESPOT::Rebase(VNode* vnode, double value_scale, double weight_scale) {
+	vnode->depth(vnode->depth() - 1);
+	vnode->weight(vnode->Weight() * weight_scale);
+	const vector<State*>& particles = vnode->particles();
+	for (int i = 0; i < particles.size(); i++)
+		particles[i]->weight *= weight_scale;
+
+	vnode->lower_bound(vnode->lower_bound() * value_scale);
+	vnode->upper_bound(vnode->upper_bound() * value_scale);
+	vnode->utility_upper_bound *= value_scale;
+	ValuedAction move = vnode->default_move();
+	move.value *= value_scale;
+	vnode->default_move(move);
+
+	for (ACT_TYPE a = 0; a < vnode->children().size(); a++) {
+		QNode* qnode = vnode->Child(a);
+		qnode->lower_bound(qnode->lower_bound() * value_scale);
+		qnode->upper_bound(qnode->upper_bound() * value_scale);
+		qnode->utility_upper_bound *= value_scale;
+		qnode->step_reward *= value_scale;
+		qnode->default_value *= value_scale;
+
+		ObsChildren& children = qnode->children();
+		for (ObsChildren::iterator it = children.begin();
+			it != children.end(); it++)
+			Rebase(it->second, value_scale, weight_scale);
+	}
+}
+
+/**
+ * Runs one trial in the retained subtree with the largest gap weighted by
+ * the probability of its observation.
+ */
+bool DESPOT::Refine() {
+	int best = -1;
+	double best_gap = 1e-6;
+	for (int i = 0; i < retained_.size(); i++) {
+		double gap = retained_[i].weight * Gap(retained_[i].root);
+		if (gap > best_gap) {
+			best = i;
+			best_gap = gap;
+		}
+	}
+	if (best < 0)
+		return false;
+
+	VNode* root = retained_[best].root;
+	history_.Add(retained_action_, retained_[best].obs);
+	VNode* leaf = Trial(root, *streams_, lower_bound_, upper_bound_, model_,
+		history_);
+	Backup(leaf);
+	history_.RemoveLast();
+	return true;
+}
+
 } // namespace despot
@@ -1,5 +1,8 @@
 #include <despot/solver/pomcp.h>
+#include <despot/core/search_trace.h>
+#include <despot/core/tree_export.h>
 #include <despot/util/logging.h>
+#include <pthread.h>
 
 using namespace std;
 
@@ -10,7 +13,8 @@ namespace despot {
  * =============================================================================*/
 
 POMCPPrior::POMCPPrior(const DSPOMDP* model) :
-	model_(model) {
+	model_(model),
+	random_(&Random::RANDOM) {
 	exploration_constant_ = (model->GetMaxReward()
 		- model->GetBestAction().value);
 }
@@ -30,12 +34,12 @@ ACT_TYPE POMCPPrior::GetAction(const State& state) {
 	ComputePreference(state);
 
 	if (preferred_actions_.size() != 0)
-		return Random::RANDOM.NextElement(preferred_actions_);
+		return random_->NextElement(preferred_actions_);
 
 	if (legal_actions_.size() != 0)
-		return Random::RANDOM.NextElement(legal_actions_);
+		return random_->NextElement(legal_actions_);
 
-	return Random::RANDOM.NextInt(model_->NumActions());
+	return random_->NextInt(model_->NumActions());
 }
 
 /* =============================================================================
@@ -58,16 +62,206 @@ void UniformPOMCPPrior::ComputePreference(const State& state) {
 
 POMCP::POMCP(const DSPOMDP* model, POMCPPrior* prior, Belief* belief) :
 	Solver(model, belief),
-	root_(NULL) {
+	root_(NULL),
+	pool_(NULL) {
 	reuse_ = false;
 	prior_ = prior;
 	assert(prior_ != NULL);
 }
 
+static void StopPool(SimulationPool* pool);
+
+POMCP::~POMCP() {
+	StopPool(pool_);
+}
+
 void POMCP::reuse(bool r) {
 	reuse_ = r;
 }
 
+void POMCP::thread_priors(const vector<POMCPPrior*>& priors) {
+	// Threads are bound to their prior
+	StopPool(pool_);
+	pool_ = NULL;
+
+	thread_priors_ = priors;
+	thread_randoms_.resize(priors.size());
+	for (int i = 0; i < priors.size(); i++) {
+		priors[i]->exploration_constant(prior_->exploration_constant());
+		priors[i]->history(prior_->history());
+		priors[i]->random(&thread_randoms_[i]);
+	}
+}
+
+/* Shared state of the threads of one batch of parallel simulations */
+struct SimulationBatch {
+	VNode* root;
+	const DSPOMDP* model;
+	vector<State*>* particles;
+	int max_sims; // Simulations still allowed, or -1 if the search is timed
+	double deadline;
+	volatile int next; // Index of the next particle to simulate
+	volatile int done;
+};
+
+struct SimulationThread {
+	SimulationPool* pool;
+	POMCPPrior* prior;
+	pthread_t thread;
+};
+
+/* Threads running the parallel simulations of a POMCP solver, kept across
+ * batches and searches. The main thread posts each batch under the mutex and
+ * waits until all threads are done with it. */
+struct SimulationPool {
+	vector<SimulationThread> threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t batch_cond; // Signaled when a batch is posted or the pool stops
+	pthread_cond_t done_cond; // Signaled when the last thread is done with a batch
+	SimulationBatch* batch;
+	int num_batches; // Batches posted so far
+	int num_running; // Threads not yet done with the current batch
+	bool stopping;
+};
+
+static void RunSimulations(SimulationBatch* batch, POMCPPrior* prior) {
+	int num_particles = batch->particles->size();
+
+	while (!batch->done) {
+		int i = __sync_fetch_and_add(&batch->next, 1);
+		if (i >= num_particles
+			|| (batch->max_sims >= 0 && i >= batch->max_sims))
+			break;
+
+		POMCP::ParallelSimulate((*batch->particles)[i], batch->root,
+			batch->model, prior);
+
+		if (batch->max_sims < 0 && get_time_second() >= batch->deadline)
+			batch->done = 1;
+	}
+}
+
+static void* RunSimulationThread(void* arg) {
+	SimulationThread* thread = (SimulationThread*) arg;
+	SimulationPool* pool = thread->pool;
+	int num_batches = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (pool->num_batches == num_batches && !pool->stopping)
+			pthread_cond_wait(&pool->batch_cond, &pool->mutex);
+		if (pool->stopping)
+			break;
+
+		num_batches = pool->num_batches;
+		SimulationBatch* batch = pool->batch;
+		pthread_mutex_unlock(&pool->mutex);
+
+		RunSimulations(batch, thread->prior);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->num_running == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static SimulationPool* StartPool(const vector<POMCPPrior*>& priors) {
+	SimulationPool* pool = new SimulationPool();
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->batch_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	pool->batch = NULL;
+	pool->num_batches = 0;
+	pool->num_running = 0;
+	pool->stopping = false;
+
+	pool->threads.resize(priors.size());
+	for (int t = 0; t < priors.size(); t++) {
+		pool->threads[t].pool = pool;
+		pool->threads[t].prior = priors[t];
+		pthread_create(&pool->threads[t].thread, NULL, RunSimulationThread,
+			&pool->threads[t]);
+	}
+	return pool;
+}
+
+// Runs a batch on all the threads of the pool and returns once they are done
+static void RunBatch(SimulationPool* pool, SimulationBatch* batch) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->batch = batch;
+	pool->num_running = pool->threads.size();
+	pool->num_batches++;
+	pthread_cond_broadcast(&pool->batch_cond);
+	while (pool->num_running > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void StopPool(SimulationPool* pool) {
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->batch_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for (int t = 0; t < pool->threads.size(); t++)
+		pthread_join(pool->threads[t].thread, NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->batch_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	delete pool;
+}
+
+int POMCP::SimulateParallel(double timeout) {
+	int num_threads = thread_priors_.size();
+	// Threads are seeded from the main generator so that seeded runs differ
+	// only by thread scheduling
+	for (int t = 0; t < num_threads; t++)
+		thread_randoms_[t] = Random(Random::RANDOM.NextUnsigned());
+
+	if (pool_ == NULL)
+		pool_ = StartPool(thread_priors_);
+
+	// Simulations run concurrently, so the time budget is wall-clock time
+	double deadline = get_time_second() + timeout;
+	int num_sims = 0;
+	while (true) {
+		vector<State*> particles = belief_->Sample(1000);
+
+		SimulationBatch batch;
+		batch.root = root_;
+		batch.model = model_;
+		batch.particles = &particles;
+		batch.max_sims = Globals::config.max_trials > 0 ?
+			Globals::config.max_trials - num_sims : -1;
+		batch.deadline = deadline;
+		batch.next = 0;
+		batch.done = 0;
+		RunBatch(pool_, &batch);
+
+		int num_done = min((int) batch.next, (int) particles.size());
+		if (batch.max_sims >= 0)
+			num_done = min(num_done, batch.max_sims);
+		num_sims += num_done;
+		logd << "[POMCP::SimulateParallel] " << num_sims << " simulations done"
+			<< endl;
+
+		for (int i = 0; i < particles.size(); i++) {
+			model_->Free(particles[i]);
+		}
+
+		if (batch.max_sims >= 0 ? num_sims >= Globals::config.max_trials :
+			get_time_second() >= deadline)
+			break;
+	}
+
+	return num_sims;
+}
+
 ValuedAction POMCP::Search(double timeout) {
 	double start_cpu = clock(), start_real = get_time_second();
 
@@ -78,9 +272,9 @@ ValuedAction POMCP::Search(double timeout) {
 	}
 
 	int hist_size = history_.Size();
-	bool done = false;
-	int num_sims = 0;
-	while (true) {
+	bool done = thread_priors_.size() > 1;
+	int num_sims = done ? SimulateParallel(timeout) : 0;
+	while (!done) {
 		vector<State*> particles = belief_->Sample(1000);
 		for (int i = 0; i < particles.size(); i++) {
 			State* particle = particles[i];
@@ -92,7 +286,9 @@ ValuedAction POMCP::Search(double timeout) {
 			logd << "[POMCP::Search] " << num_sims << " simulations done" << endl;
 			history_.Truncate(hist_size);
 
-			if ((clock() - start_cpu) / CLOCKS_PER_SEC >= timeout) {
+			if (Globals::config.max_trials > 0 ?
+				num_sims >= Globals::config.max_trials :
+				(clock() - start_cpu) / CLOCKS_PER_SEC >= timeout) {
 				done = true;
 				break;
 			}
@@ -101,12 +297,11 @@ ValuedAction POMCP::Search(double timeout) {
 		for (int i = 0; i < particles.size(); i++) {
 			model_->Free(particles[i]);
 		}
-
-		if (done)
-			break;
 	}
 
 	ValuedAction astar = OptimalAction(root_);
+	if (TreeExport::enabled())
+		TreeExport::Export("POMCP", root_);
 
 	logi << "[POMCP::Search] Search statistics" << endl
 		<< "OptimalAction = " << astar << endl 
@@ -122,6 +317,16 @@ ValuedAction POMCP::Search(double timeout) {
 		}
 	}
 
+	if (SearchTrace::enabled()) {
+		SearchStatistics statistics;
+		statistics.time_search = (clock() - start_cpu) / CLOCKS_PER_SEC;
+		statistics.num_trials = num_sims;
+		statistics.num_tree_nodes = root_->Size();
+		statistics.num_particles_after_search = model_->NumActiveParticles();
+		SearchTrace::Decision("POMCP", astar, statistics,
+			get_time_second() - start_real);
+	}
+
 	// delete root_;
 	return astar;
 }
@@ -134,6 +339,8 @@ void POMCP::belief(Belief* b) {
 	belief_ = b;
 	history_.Truncate(0);
   prior_->PopAll();
+	for (int t = 0; t < thread_priors_.size(); t++)
+		thread_priors_[t]->PopAll();
 	delete root_;
 	root_ = NULL;
 }
@@ -156,6 +363,8 @@ void POMCP::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs) {
 	}
 
 	prior_->Add(action, obs);
+	for (int t = 0; t < thread_priors_.size(); t++)
+		thread_priors_[t]->Add(action, obs);
 	history_.Add(action, obs);
 	belief_->Update(action, obs);
 
@@ -164,11 +373,46 @@ void POMCP::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs) {
 		<< " in " << (get_time_second() - start) << "s" << endl;
 }
 
+/* Precomputed factors of the UCB exploration bonus for small visit counts */
+class ExplorationTerms {
+private:
+	enum {
+		SIZE = 4096
+	};
+
+	double sqrt_log_count_[SIZE]; // sqrt(log(n + 1))
+	double inv_sqrt_count_[SIZE]; // 1 / sqrt(n)
+
+public:
+	ExplorationTerms() {
+		inv_sqrt_count_[0] = Globals::POS_INFTY;
+		for (int n = 0; n < SIZE; n++) {
+			sqrt_log_count_[n] = sqrt(log(n + 1.0));
+			if (n > 0)
+				inv_sqrt_count_[n] = 1.0 / sqrt((double) n);
+		}
+	}
+
+	inline double SqrtLogCount(int n) const {
+		return n < SIZE ? sqrt_log_count_[n] : sqrt(log(n + 1.0));
+	}
+
+	inline double InvSqrtCount(int n) const {
+		return n < SIZE ? inv_sqrt_count_[n] : 1.0 / sqrt((double) n);
+	}
+};
+
+static const ExplorationTerms EXPLORATION_TERMS;
+
 ACT_TYPE POMCP::UpperBoundAction(const VNode* vnode, double explore_constant) {
 	const vector<QNode*>& qnodes = vnode->children();
 	double best_ub = Globals::NEG_INFTY;
 	ACT_TYPE best_action = -1;
 
+	// explore_constant * sqrt(log(N + 1) / n) as a product of two table lookups
+	double bonus = explore_constant
+		* EXPLORATION_TERMS.SqrtLogCount(vnode->count());
+
 	/*
 	 int total = 0;
 	 for (ACT_TYPE action = 0; action < qnodes.size(); action ++) {
@@ -179,12 +423,22 @@ ACT_TYPE POMCP::UpperBoundAction(const VNode* vnode, double explore_constant) {
 	 */
 
 	for (ACT_TYPE action = 0; action < qnodes.size(); action++) {
-		if (qnodes[action]->count() == 0)
+		const QNode* qnode = qnodes[action];
+		int count = qnode->count();
+		int virtual_loss = qnode->virtual_loss();
+		if (count + virtual_loss == 0)
 			return action;
 
-		double ub = qnodes[action]->value()
-			+ explore_constant
-				* sqrt(log(vnode->count() + 1) / qnodes[action]->count());
+		double value = qnode->value();
+		if (virtual_loss > 0) {
+			// Count each parallel simulation still running through the action as
+			// a visit that scored explore_constant below the mean, so that
+			// concurrent simulations spread over the actions
+			value -= explore_constant * virtual_loss / (count + virtual_loss);
+			count += virtual_loss;
+		}
+
+		double ub = value + bonus * EXPLORATION_TERMS.InvSqrtCount(count);
 
 		if (ub > best_ub) {
 			best_ub = ub;
@@ -216,6 +470,32 @@ int POMCP::Count(const VNode* vnode) {
 	return count;
 }
 
+bool POMCP::Save(CheckpointWriter& writer) const {
+	if (!Solver::Save(writer))
+		return false;
+
+	writer.WriteValue((int) (root_ != NULL));
+	if (root_ != NULL)
+		writer.WriteTree(root_);
+	return writer.ok();
+}
+
+bool POMCP::Restore(CheckpointReader& reader) {
+	int has_root;
+	if (!Solver::Restore(reader) || !reader.ReadValue(has_root))
+		return false;
+
+	delete root_;
+	root_ = has_root ? reader.ReadTree() : NULL;
+	if (has_root && root_ == NULL)
+		return false;
+
+	prior_->history(history_);
+	for (int t = 0; t < thread_priors_.size(); t++)
+		thread_priors_[t]->history(history_);
+	return true;
+}
+
 VNode* POMCP::CreateVNode(int depth, const State* state, POMCPPrior* prior,
 	const DSPOMDP* model) {
 	VNode* vnode = new VNode(0, 0.0, depth);
@@ -283,7 +563,7 @@ double POMCP::Simulate(State* particle, RandomStreams& streams, VNode* vnode,
 	if (!terminal) {
 		prior->Add(action, obs);
 		streams.Advance();
-		map<OBS_TYPE, VNode*>& vnodes = qnode->children();
+		ObsChildren& vnodes = qnode->children();
 		if (vnodes[obs] != NULL) {
 			reward += Globals::Discount()
 				* Simulate(particle, streams, vnodes[obs], model, prior);
@@ -316,12 +596,13 @@ double POMCP::Simulate(State* particle, VNode* vnode, const DSPOMDP* model,
 
 	double reward;
 	OBS_TYPE obs;
-	bool terminal = model->Step(*particle, action, reward, obs);
+	bool terminal = model->Step(*particle, prior->random().NextDouble(), action,
+		reward, obs);
 
 	QNode* qnode = vnode->Child(action);
 	if (!terminal) {
 		prior->Add(action, obs);
-		map<OBS_TYPE, VNode*>& vnodes = qnode->children();
+		ObsChildren& vnodes = qnode->children();
 		if (vnodes[obs] != NULL) {
 			reward += Globals::Discount()
 				* Simulate(particle, vnodes[obs], model, prior);
@@ -341,52 +622,142 @@ double POMCP::Simulate(State* particle, VNode* vnode, const DSPOMDP* model,
 }
 
 // static
-double POMCP::Rollout(State* particle, RandomStreams& streams, int depth,
+double POMCP::ParallelSimulate(State* particle, VNode* vnode,
 	const DSPOMDP* model, POMCPPrior* prior) {
-	if (streams.Exhausted()) {
+	assert(vnode != NULL);
+	if (vnode->depth() >= Globals::config.search_depth)
 		return 0;
-	}
 
-	ACT_TYPE action = prior->GetAction(*particle);
+	double explore_constant = prior->exploration_constant();
 
-	logd << *particle << endl;
-	logd << "depth = " << depth << "; action = " << action << endl;
+	ACT_TYPE action = UpperBoundAction(vnode, explore_constant);
+	QNode* qnode = vnode->Child(action);
+	qnode->AddVirtualLoss(1);
 
 	double reward;
 	OBS_TYPE obs;
-	bool terminal = model->Step(*particle, streams.Entry(particle->scenario_id),
-		action, reward, obs);
+	bool terminal = model->Step(*particle, prior->random().NextDouble(), action,
+		reward, obs);
+
 	if (!terminal) {
 		prior->Add(action, obs);
-		streams.Advance();
-		reward += Globals::Discount()
-			* Rollout(particle, streams, depth + 1, model, prior);
-		streams.Back();
+
+		qnode->LockChildren();
+		ObsChildren::iterator it = qnode->children().find(obs);
+		VNode* child = (it != qnode->children().end()) ? it->second : NULL;
+		qnode->UnlockChildren();
+
+		if (child != NULL) {
+			reward += Globals::Discount()
+				* ParallelSimulate(particle, child, model, prior);
+		} else { // Rollout and add the node, unless another thread just added it
+			child = CreateVNode(vnode->depth() + 1, particle, prior, model);
+			qnode->LockChildren();
+			VNode*& slot = qnode->children()[obs];
+			bool added = (slot == NULL);
+			if (added)
+				slot = child;
+			qnode->UnlockChildren();
+			if (!added)
+				delete child;
+
+			reward += Globals::Discount()
+				* Rollout(particle, vnode->depth() + 1, model, prior);
+		}
 		prior->PopLast();
 	}
 
+	qnode->AtomicAdd(reward);
+	qnode->AddVirtualLoss(-1);
+	vnode->AtomicAdd(reward);
+
 	return reward;
 }
 
+// Bound on the magnitude of the discounted reward a rollout can still
+// collect, per unit of the current discount, from the reward range of the
+// model. Infinite, so that rollouts are never cut off, if the model does not
+// give its minimum reward, and zero if rollouts are not cut off.
+static double RolloutTailBound(const DSPOMDP* model) {
+	if (Globals::config.rollout_tolerance <= 0 || Globals::Discount() >= 1)
+		return 0;
+	return max(fabs(model->GetMaxReward()), fabs(model->GetMinReward()))
+		/ (1 - Globals::Discount());
+}
+
+// static
+double POMCP::Rollout(State* particle, RandomStreams& streams, int depth,
+	const DSPOMDP* model, POMCPPrior* prior) {
+	// Entries are read at an offset from the current position, which is left
+	// untouched
+	int position = streams.position();
+	int num_steps = min(streams.Length() - position,
+		Globals::config.max_policy_sim_len);
+	double tail_bound = RolloutTailBound(model);
+
+	double value = 0, discount = 1;
+	int num_added = 0;
+	for (int step = 0; step < num_steps; step++) {
+		if (discount * tail_bound < Globals::config.rollout_tolerance)
+			break;
+
+		ACT_TYPE action = prior->GetAction(*particle);
+
+		logd << *particle << endl;
+		logd << "depth = " << depth + step << "; action = " << action << endl;
+
+		double reward;
+		OBS_TYPE obs;
+		bool terminal = model->Step(*particle,
+			streams.Entry(particle->scenario_id, position + step), action,
+			reward, obs);
+		value += discount * reward;
+		discount *= Globals::Discount();
+
+		if (terminal)
+			break;
+		prior->Add(action, obs);
+		num_added++;
+	}
+
+	for (int i = 0; i < num_added; i++)
+		prior->PopLast();
+
+	return value;
+}
+
 // static
 double POMCP::Rollout(State* particle, int depth, const DSPOMDP* model,
 	POMCPPrior* prior) {
-	if (depth >= Globals::config.search_depth) {
-		return 0;
-	}
+	int num_steps = min(Globals::config.search_depth - depth,
+		Globals::config.max_policy_sim_len);
+	double tail_bound = RolloutTailBound(model);
+
+	double value = 0, discount = 1;
+	int num_added = 0;
+	for (int step = 0; step < num_steps; step++) {
+		if (discount * tail_bound < Globals::config.rollout_tolerance)
+			break;
 
-	ACT_TYPE action = prior->GetAction(*particle);
+		ACT_TYPE action = prior->GetAction(*particle);
 
-	double reward;
-	OBS_TYPE obs;
-	bool terminal = model->Step(*particle, action, reward, obs);
-	if (!terminal) {
+		double reward;
+		OBS_TYPE obs;
+		bool terminal = model->Step(*particle, prior->random().NextDouble(),
+			action, reward, obs);
+		value += discount * reward;
+		discount *= Globals::Discount();
+
+		if (terminal)
+			break;
 		prior->Add(action, obs);
-		reward += Globals::Discount() * Rollout(particle, depth + 1, model, prior);
-		prior->PopLast();
+		num_added++;
 	}
 
-	return reward;
+	for (int i = 0; i < num_added; i++)
+		prior->PopLast();
+
+	return value;
 }
 
 ValuedAction POMCP::Evaluate(VNode* root, vector<State*>& particles,
@@ -425,7 +796,7 @@ ValuedAction POMCP::Evaluate(VNode* root, vector<State*>& particles,
 
 				if (cur != NULL) {
 					QNode* qnode = cur->Child(action);
-					map<OBS_TYPE, VNode*>& vnodes = qnode->children();
+					ObsChildren& vnodes = qnode->children();
 					cur = vnodes.find(obs) != vnodes.end() ? vnodes[obs] : NULL;
 				}
 			} else {
@@ -482,6 +853,8 @@ ValuedAction DPOMCP::Search(double timeout) {
 		<< root_->Size() << endl;
 
 	ValuedAction astar = OptimalAction(root_);
+	if (TreeExport::enabled())
+		TreeExport::Export("DPOMCP", root_);
 	if (astar.action == -1) {
 		for (ACT_TYPE action = 0; action < model_->NumActions(); action++) {
 			cout << "action " << action << ": " << root_->Child(action)->count()
@@ -489,7 +862,18 @@ ValuedAction DPOMCP::Search(double timeout) {
 		}
 	}
 
+	if (SearchTrace::enabled()) {
+		SearchStatistics statistics;
+		statistics.time_search = (clock() - start_cpu) / CLOCKS_PER_SEC;
+		statistics.num_trials = root_->count();
+		statistics.num_tree_nodes = root_->Size();
+		statistics.num_particles_after_search = model_->NumActiveParticles();
+		SearchTrace::Decision("DPOMCP", astar, statistics,
+			get_time_second() - start_real);
+	}
+
 	delete root_;
+	root_ = NULL;
 	return astar;
 }
 
@@ -515,7 +899,9 @@ VNode* DPOMCP::ConstructTree(vector<State*>& particles, RandomStreams& streams,
 		num_sims++;
 		model->Free(particle);
 
-		if ((clock() - start) / CLOCKS_PER_SEC >= timeout) {
+		if (Globals::config.max_trials > 0 ?
+			num_sims >= Globals::config.max_trials :
+			(clock() - start) / CLOCKS_PER_SEC >= timeout) {
 			break;
 		}
 	}
@@ -29,4 +29,28 @@ vector<double> Dirichlet::Next(vector<double> alpha) {
 	return x;
 }
 
+void Dirichlet::Next(const vector<double>& alpha, int count,
+	vector<double>& samples) {
+	int dim = alpha.size();
+	samples.resize(count * dim);
+	if (count == 0)
+		return;
+
+	vector<double> gammas(count);
+	for (int j = 0; j < dim; j++) {
+		Gamma::Next(alpha[j], 1, count, &gammas[0]);
+		for (int i = 0; i < count; i++)
+			samples[i * dim + j] = gammas[i];
+	}
+
+	for (int i = 0; i < count; i++) {
+		double* x = &samples[i * dim];
+		double sum = 0;
+		for (int j = 0; j < dim; j++)
+			sum += x[j];
+		for (int j = 0; j < dim; j++)
+			x[j] /= sum;
+	}
+}
+
 } // namespace despot
@@ -1,5 +1,8 @@
 #include <despot/util/floor.h>
-#include <queue>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <pthread.h>
 
 using namespace std;
 
@@ -40,53 +43,78 @@ bool Floor::Inside(int x, int y) const {
 		&& floor_[y][x] != INVALID;
 }
 
-vector<double> Floor::ComputeDistances(int source) {
-	vector<double> dist;
-	double** distMatrix = new double*[num_rows_];
-	for (int r = 0; r < num_rows_; r++) {
-		distMatrix[r] = new double[num_cols_];
-		for (int c = 0; c < num_cols_; c++)
-			distMatrix[r][c] = NumCells();
-	}
-	distMatrix[GetCell(source).y][GetCell(source).x] = 0.0;
-
-	queue<Coord> list;
-	list.push(GetCell(source));
-	while (!list.empty()) {
-		Coord cur = list.front();
-		list.pop();
-
-		for (int dir = 0; dir < 4; dir++) {
-			Coord next = cur + Compass::DIRECTIONS[dir];
-			if (GetIndex(next) != INVALID
-				&& distMatrix[next.y][next.x] > distMatrix[cur.y][cur.x] + 1) {
-				distMatrix[next.y][next.x] = distMatrix[cur.y][cur.x] + 1;
-				list.push(next);
+// Breadth-first searches from the sources in [begin, end)
+struct DistanceTask {
+	const Floor* floor;
+	const int* neighbors;
+	uint16_t* dist;
+	int begin, end;
+	pthread_t thread;
+};
+
+void* Floor::ComputeDistances(void* arg) {
+	DistanceTask* task = (DistanceTask*) arg;
+	int num_cells = task->floor->NumCells();
+	vector<int> queue(num_cells);
+
+	for (int source = task->begin; source < task->end; source++) {
+		uint16_t* row = task->dist + (long) source * num_cells;
+		for (int c = 0; c < num_cells; c++)
+			row[c] = num_cells;
+		row[source] = 0;
+
+		int head = 0, tail = 0;
+		queue[tail++] = source;
+		while (head < tail) {
+			int cur = queue[head++];
+			const int* next = task->neighbors + 4 * cur;
+			for (int dir = 0; dir < 4; dir++) {
+				if (next[dir] != INVALID && row[next[dir]] == num_cells) {
+					row[next[dir]] = row[cur] + 1;
+					queue[tail++] = next[dir];
+				}
 			}
 		}
 	}
+	return NULL;
+}
 
-	/*
-	 for (int r=0; r<num_rows_; r++) {
-	 for (int c=0; c<num_cols_; c++)
-	 cout << distMatrix[r][c] << " ";
-	 cout << endl;
-	 }
-	 cout << endl;
-	 */
-
-	for (int c = 0; c < NumCells(); c++)
-		dist.push_back(distMatrix[GetCell(c).y][GetCell(c).x]);
+void Floor::ComputeDistances(int num_threads) {
+	int num_cells = NumCells();
+	if (num_cells > 65535) {
+		cerr << "[Floor::ComputeDistances] " << num_cells
+			<< " cells do not fit 16-bit distances" << endl;
+		exit(1);
+	}
 
-	return dist;
-}
-void Floor::ComputeDistances() {
-	for (int c = 0; c < NumCells(); c++)
-		dist_.push_back(ComputeDistances(c));
-}
+	neighbors_.resize(4 * num_cells);
+	for (int c = 0; c < num_cells; c++)
+		for (int dir = 0; dir < 4; dir++)
+			neighbors_[4 * c + dir] = GetIndex(
+				GetCell(c) + Compass::DIRECTIONS[dir]);
+
+	dist_.resize((long) num_cells * num_cells);
+	if (num_cells == 0)
+		return;
+
+	num_threads = max(1, min(num_threads, num_cells));
+	vector<DistanceTask> tasks(num_threads);
+	for (int t = 0; t < num_threads; t++) {
+		tasks[t].floor = this;
+		tasks[t].neighbors = &neighbors_[0];
+		tasks[t].dist = &dist_[0];
+		tasks[t].begin = (long) num_cells * t / num_threads;
+		tasks[t].end = (long) num_cells * (t + 1) / num_threads;
+	}
 
-double Floor::Distance(int c1, int c2) const {
-	return dist_[c1][c2];
+	if (num_threads == 1) {
+		ComputeDistances(&tasks[0]);
+	} else {
+		for (int t = 0; t < num_threads; t++)
+			pthread_create(&tasks[t].thread, NULL, ComputeDistances, &tasks[t]);
+		for (int t = 0; t < num_threads; t++)
+			pthread_join(tasks[t].thread, NULL);
+	}
 }
 
 vector<int> Floor::ComputeShortestPath(int start, int end) const {
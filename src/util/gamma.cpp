@@ -1,4 +1,7 @@
 #include <despot/util/gamma.h>
+#include <vector>
+
+using namespace std;
 
 namespace despot {
 
@@ -44,4 +47,40 @@ double Gamma::Next(double k, double theta) {
 	}
 }
 
+void Gamma::Next(double k, double theta, int count, double* values) {
+	double d = (k < 1 ? k + 1 : k) - 1.0 / 3, c = 1 / sqrt(9 * d);
+	vector<double> x(count), u(count), v(count);
+
+	int filled = 0;
+	while (filled < count) {
+		int n = count - filled;
+		// Box-Muller, using both normals of each pair of uniforms
+		for (int i = 0; i < n; i += 2) {
+			double r = sqrt(-2 * log(Random::RANDOM.NextDouble()));
+			double angle = 2 * M_PI * Random::RANDOM.NextDouble();
+			x[i] = r * cos(angle);
+			if (i + 1 < n)
+				x[i + 1] = r * sin(angle);
+		}
+		for (int i = 0; i < n; i++)
+			u[i] = Random::RANDOM.NextDouble();
+
+		for (int i = 0; i < n; i++) {
+			double t = 1 + c * x[i];
+			v[i] = t * t * t;
+		}
+
+		for (int i = 0; i < n; i++) {
+			if (v[i] > 0
+				&& log(u[i]) < 0.5 * x[i] * x[i] + d - d * v[i] + d * log(v[i]))
+				values[filled++] = d * v[i] * theta;
+		}
+	}
+
+	if (k < 1) {
+		for (int i = 0; i < count; i++)
+			values[i] *= pow(Random::RANDOM.NextDouble(), 1 / k);
+	}
+}
+
 } // namespace despot
@@ -16,7 +16,7 @@ Random::Random(unsigned seed) :
 	seed_(seed) {
 }
 
-unsigned Random::seed() {
+unsigned Random::seed() const {
 	return seed_;
 }
 
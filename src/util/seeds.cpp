@@ -13,6 +13,14 @@ void Seeds::root_seed(unsigned value) {
 	seed_gen_ = Random(root_seed_);
 }
 
+unsigned Seeds::state() {
+	return seed_gen_.seed();
+}
+
+void Seeds::state(unsigned value) {
+	seed_gen_ = Random(value);
+}
+
 unsigned Seeds::Next() {
 	// return root_seed_ ^ (num_assigned_seeds_++);
 	return seed_gen_.NextUnsigned();
@@ -0,0 +1,180 @@
+/*
+ * Offline summarizer for traces written by despot::SearchTrace.
+ *
+ * Usage: despot_trace_summary <trace> [<baseline trace>]
+ *
+ * Prints, for every numeric field of the decision and trial records, the
+ * number of samples, mean and percentiles. If a baseline trace is given, the
+ * relative change of the mean and of the 90th percentile with respect to the
+ * baseline is printed as well, so that latency regressions stand out.
+ * Records of speculative searches are summarized in groups of their own.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+typedef map<string, vector<double> > Series; // field -> samples
+typedef map<string, Series> Summary; // record group -> fields
+
+/**
+ * Parses one flat JSON object of the form written by SearchTrace. Nested
+ * objects and arrays are not supported since the sink never writes them.
+ */
+static bool ParseRecord(const string& line, map<string, string>& fields) {
+	fields.clear();
+	size_t pos = line.find('{');
+	if (pos == string::npos)
+		return false;
+	pos++;
+
+	while (pos < line.size()) {
+		size_t key_start = line.find('"', pos);
+		if (key_start == string::npos)
+			break;
+		size_t key_end = line.find('"', key_start + 1);
+		if (key_end == string::npos)
+			return false;
+		string key = line.substr(key_start + 1, key_end - key_start - 1);
+
+		size_t colon = line.find(':', key_end);
+		if (colon == string::npos)
+			return false;
+		size_t value_start = colon + 1;
+		size_t value_end;
+		string value;
+		if (line[value_start] == '"') {
+			value_end = line.find('"', value_start + 1);
+			if (value_end == string::npos)
+				return false;
+			value = line.substr(value_start + 1, value_end - value_start - 1);
+			value_end++;
+		} else {
+			value_end = line.find_first_of(",}", value_start);
+			if (value_end == string::npos)
+				return false;
+			value = line.substr(value_start, value_end - value_start);
+		}
+		fields[key] = value;
+		pos = value_end;
+	}
+	return fields.size() > 0;
+}
+
+static bool Load(const char* file, Summary& summary) {
+	ifstream fin(file);
+	if (!fin.good()) {
+		cerr << "Cannot open trace " << file << endl;
+		return false;
+	}
+
+	string line;
+	map<string, string> fields;
+	int num_records = 0;
+	while (getline(fin, line)) {
+		if (!ParseRecord(line, fields))
+			continue;
+
+		string group = fields["type"];
+		if (fields.count("solver"))
+			group += "/" + fields["solver"];
+		if (fields["speculative"] == "true")
+			group += "/speculative";
+
+		Series& series = summary[group];
+		for (map<string, string>::iterator it = fields.begin();
+			it != fields.end(); it++) {
+			const string& key = it->first;
+			if (key == "type" || key == "solver" || key == "decision"
+				|| key == "trial" || key == "speculative"
+				|| it->second == "null")
+				continue;
+			char* end;
+			double value = strtod(it->second.c_str(), &end);
+			if (end != it->second.c_str())
+				series[key].push_back(value);
+		}
+		num_records++;
+	}
+	cout << "# " << file << ": " << num_records << " records" << endl;
+	return true;
+}
+
+static double Percentile(const vector<double>& sorted, double p) {
+	if (sorted.size() == 0)
+		return 0;
+	int index = (int) ceil(p * sorted.size()) - 1;
+	if (index < 0)
+		index = 0;
+	return sorted[index];
+}
+
+static double Mean(const vector<double>& samples) {
+	double sum = 0;
+	for (int i = 0; i < samples.size(); i++)
+		sum += samples[i];
+	return samples.size() > 0 ? sum / samples.size() : 0;
+}
+
+static void PrintChange(double value, double base) {
+	if (base == 0)
+		printf(" %9s", "-");
+	else
+		printf(" %+8.1f%%", 100.0 * (value - base) / fabs(base));
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2 || argc > 3) {
+		cerr << "Usage: " << argv[0] << " <trace> [<baseline trace>]" << endl;
+		return 1;
+	}
+
+	Summary summary, baseline;
+	if (!Load(argv[1], summary))
+		return 1;
+	bool compare = (argc == 3);
+	if (compare && !Load(argv[2], baseline))
+		return 1;
+
+	for (Summary::iterator group = summary.begin(); group != summary.end();
+		group++) {
+		printf("\n[%s]\n", group->first.c_str());
+		printf("%-28s %8s %12s %12s %12s %12s %12s %12s", "field", "n", "mean",
+			"p50", "p90", "p99", "min", "max");
+		if (compare)
+			printf(" %9s %9s", "d(mean)", "d(p90)");
+		printf("\n");
+
+		for (Series::iterator it = group->second.begin();
+			it != group->second.end(); it++) {
+			vector<double> sorted = it->second;
+			sort(sorted.begin(), sorted.end());
+			double mean = Mean(sorted), p90 = Percentile(sorted, 0.9);
+			printf("%-28s %8d %12.6g %12.6g %12.6g %12.6g %12.6g %12.6g",
+				it->first.c_str(), (int) sorted.size(), mean,
+				Percentile(sorted, 0.5), p90, Percentile(sorted, 0.99),
+				sorted.front(), sorted.back());
+
+			if (compare) {
+				vector<double> base = baseline[group->first][it->first];
+				sort(base.begin(), base.end());
+				if (base.size() > 0) {
+					PrintChange(mean, Mean(base));
+					PrintChange(p90, Percentile(base, 0.9));
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	return 0;
+}
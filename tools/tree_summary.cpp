@@ -0,0 +1,196 @@
+/*
+ * Offline summarizer for search trees written by despot::TreeExport.
+ *
+ * Usage: despot_tree_summary <export> [<decision>]
+ *
+ * Prints, for each depth of the trees in the export (or of the tree of the
+ * given decision only), the number of belief nodes, how many of them were
+ * expanded, the branching factor over actions and observations of the
+ * expanded nodes, the mean number of visits and the distribution of the gap
+ * between the upper and lower bounds of the belief nodes. Trees of
+ * speculative searches are summarized apart from those of decisions.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <despot/core/tree_export.h>
+
+using namespace std;
+using namespace despot;
+
+// Nodes read from the file at once
+static const int CHUNK_SIZE = 4096;
+
+struct DepthSummary {
+	long num_nodes;
+	long num_expanded;
+	long num_actions; // Children of the expanded belief nodes
+	long num_expanded_actions;
+	long num_observations; // Children of the expanded action nodes
+	double visits;
+	vector<double> gaps;
+
+	DepthSummary() :
+		num_nodes(0),
+		num_expanded(0),
+		num_actions(0),
+		num_expanded_actions(0),
+		num_observations(0),
+		visits(0) {
+	}
+};
+
+static void Add(const TreeExportNode& node, vector<DepthSummary>& depths) {
+	if (node.depth < 0)
+		return;
+	if (node.depth >= depths.size())
+		depths.resize(node.depth + 1);
+
+	DepthSummary& summary = depths[node.depth];
+	if (node.type == TreeExportNode::ACTION_NODE) {
+		if (node.num_children > 0) {
+			summary.num_expanded_actions++;
+			summary.num_observations += node.num_children;
+		}
+		return;
+	}
+
+	summary.num_nodes++;
+	summary.visits += node.count;
+	if (node.num_children > 0) {
+		summary.num_expanded++;
+		summary.num_actions += node.num_children;
+	}
+	double gap = node.upper_bound - node.lower_bound;
+	if (gap == gap && fabs(gap) != HUGE_VAL && fabs(gap) < 1e100)
+		summary.gaps.push_back(gap);
+}
+
+static double Percentile(const vector<double>& sorted, double p) {
+	if (sorted.size() == 0)
+		return 0;
+	int index = (int) ceil(p * sorted.size()) - 1;
+	if (index < 0)
+		index = 0;
+	return sorted[index];
+}
+
+static double Mean(const vector<double>& samples) {
+	double sum = 0;
+	for (int i = 0; i < samples.size(); i++)
+		sum += samples[i];
+	return samples.size() > 0 ? sum / samples.size() : 0;
+}
+
+static double Ratio(double num, double den) {
+	return den > 0 ? num / den : 0;
+}
+
+// Trees of one kind, decisions or speculative searches
+struct TreeGroup {
+	vector<DepthSummary> depths;
+	map<string, int> num_trees; // solver -> number of trees
+	int num_read;
+	int max_nodes;
+	long total_nodes;
+
+	TreeGroup() :
+		num_read(0),
+		max_nodes(0),
+		total_nodes(0) {
+	}
+};
+
+static void Print(const char* name, TreeGroup& group) {
+	cout << "# " << name << ": " << group.num_read << " trees";
+	for (map<string, int>::iterator it = group.num_trees.begin();
+		it != group.num_trees.end(); it++)
+		cout << (it == group.num_trees.begin() ? " (" : ", ") << it->second
+			<< " " << it->first;
+	cout << (group.num_trees.empty() ? "" : ")") << ", nodes per tree: mean "
+		<< Ratio(group.total_nodes, group.num_read) << ", max "
+		<< group.max_nodes << endl;
+
+	printf("%5s %10s %10s %9s %9s %10s %12s %12s %12s %12s\n", "depth",
+		"nodes", "expanded", "actions", "obs", "visits", "gap mean",
+		"gap p50", "gap p90", "gap max");
+	for (int d = 0; d < group.depths.size(); d++) {
+		DepthSummary& summary = group.depths[d];
+		if (summary.num_nodes == 0)
+			continue;
+		sort(summary.gaps.begin(), summary.gaps.end());
+		printf("%5d %10ld %10ld %9.3f %9.3f %10.1f %12.6g %12.6g %12.6g %12.6g\n",
+			d, summary.num_nodes, summary.num_expanded,
+			Ratio(summary.num_actions, summary.num_expanded),
+			Ratio(summary.num_observations, summary.num_expanded_actions),
+			Ratio(summary.visits, summary.num_nodes), Mean(summary.gaps),
+			Percentile(summary.gaps, 0.5), Percentile(summary.gaps, 0.9),
+			summary.gaps.empty() ? 0 : summary.gaps.back());
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2 || argc > 3) {
+		cerr << "Usage: " << argv[0] << " <export> [<decision>]" << endl;
+		return 1;
+	}
+
+	FILE* in = fopen(argv[1], "rb");
+	char magic[8];
+	if (in == NULL || fread(magic, 1, 8, in) != 8
+		|| memcmp(magic, "DESPOTTE", 8) != 0) {
+		cerr << "Cannot read tree export " << argv[1] << endl;
+		return 1;
+	}
+	int only = argc == 3 ? atoi(argv[2]) : -1;
+
+	TreeGroup decisions, speculations;
+	vector<TreeExportNode> chunk(CHUNK_SIZE);
+	TreeExportHeader header;
+	while (fread(&header, sizeof(TreeExportHeader), 1, in) == 1) {
+		header.solver[sizeof(header.solver) - 1] = '\0';
+		bool selected = only < 0 || header.decision == only;
+		if (!selected) {
+			fseek(in, (long) header.num_nodes * sizeof(TreeExportNode),
+				SEEK_CUR);
+			continue;
+		}
+
+		TreeGroup& group = header.speculative ? speculations : decisions;
+		for (int left = header.num_nodes; left > 0;) {
+			int size = min(left, CHUNK_SIZE);
+			if (fread(&chunk[0], sizeof(TreeExportNode), size, in) != size) {
+				cerr << "Truncated tree of decision " << header.decision
+					<< endl;
+				left = 0;
+				break;
+			}
+			for (int i = 0; i < size; i++)
+				Add(chunk[i], group.depths);
+			left -= size;
+		}
+
+		group.num_trees[header.solver]++;
+		group.num_read++;
+		group.total_nodes += header.num_nodes;
+		group.max_nodes = max(group.max_nodes, header.num_nodes);
+	}
+	fclose(in);
+
+	cout << "# " << argv[1] << endl;
+	Print("decisions", decisions);
+	if (speculations.num_read > 0) {
+		cout << endl;
+		Print("speculative searches", speculations);
+	}
+
+	return 0;
+}